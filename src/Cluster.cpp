@@ -4,16 +4,19 @@
 #include "Config.h"
 #include "Scene/Scene.h"
 #include "Log/Log.h"
+#include "Util/ThreadPool.h"
 #include "Renderer/ForwardRenderer.h"
 #include "Renderer/DeferredRenderer.h"
 #include "Renderer/ClusteredRenderer.h"
 #include <bx/file.h>
 #include <bx/string.h>
+#include <bx/timer.h>
 #include <bimg/bimg.h>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/component_wise.hpp>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <algorithm>
+#include <limits>
 #include <random>
 
 Cluster::Cluster() :
@@ -21,7 +24,8 @@ Cluster::Cluster() :
     callbacks(*this),
     config(std::make_unique<Config>()),
     ui(std::make_unique<ClusterUI>(*this)),
-    scene(std::make_unique<Scene>())
+    scene(std::make_unique<Scene>()),
+    threads(std::make_unique<ThreadPool>())
 {
 }
 
@@ -89,17 +93,100 @@ void Cluster::initialize(int _argc, char* _argv[])
 
     // renderer has already been created in onReset
     renderer->setTonemappingMode(config->tonemappingMode);
+    renderer->setOcclusionCullingMode(config->occlusionCulling);
+    renderer->setGpuCulling(config->gpuCulling);
+    renderer->setLod(config->lod);
+    renderer->setMultithreadedSubmission(config->multithreadedSubmission);
     renderer->setMultipleScattering(config->multipleScattering);
     ui->initialize();
 
     Scene::init();
 
-    if(!scene->load(config->sceneFile))
+    if(config->benchmarkLoad)
+        benchmarkLoad(config->sceneFile);
+
+    if(!loadScene(config->sceneFile))
     {
         Log->error("Loading scene model failed");
         close();
         return;
     }
+}
+
+bool Cluster::loadScene(const char* file)
+{
+    configureScene();
+
+    if(config->asyncLoad)
+    {
+        // update finishes the load, a scene cache gets loaded right away
+        scene->loadAsync(file);
+        if(!scene->loading())
+            onSceneLoaded();
+        return true;
+    }
+
+    if(!scene->load(file))
+        return false;
+    onSceneLoaded();
+    return true;
+}
+
+void Cluster::configureScene()
+{
+    scene->mergeBuffers = config->mergeBuffers;
+    scene->quantizeVertices = config->quantizeVertices;
+    scene->generateLods = config->generateLods;
+    scene->instanceMeshes = config->instanceMeshes;
+    scene->textureArrays = config->textureArrays;
+    scene->compressTextures = config->compressTextures;
+    scene->highQualityCompression = config->bc7Textures;
+    scene->streamTextures = config->streamTextures;
+    scene->nativeGltf = config->nativeGltf;
+    scene->useCache = config->sceneCache;
+    scene->threads = threads.get();
+}
+
+void Cluster::benchmarkLoad(const char* file)
+{
+    // both paths import the file, the scene cache would skip that
+    // alternating runs, the best of each path counts so the first run's page cache misses and
+    // compressed texture copies don't end up on one side
+    constexpr int RUNS = 3;
+    double best[2] = { std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+    configureScene();
+    scene->useCache = false;
+    for(int run = 0; run < RUNS; run++)
+    {
+        for(int native = 0; native < 2; native++)
+        {
+            scene->nativeGltf = native != 0;
+            const int64_t start = bx::getHPCounter();
+            const bool loaded = scene->load(file);
+            const double ms = double(bx::getHPCounter() - start) * 1000.0 / double(bx::getHPFrequency());
+            scene->clear();
+            if(!loaded)
+            {
+                Log->error("Load benchmark failed");
+                return;
+            }
+            best[native] = std::min(best[native], ms);
+        }
+    }
+    Log->info("Load benchmark of {}: {:.0f} ms with glTF loader, {:.0f} ms with assimp ({} runs each)",
+              file,
+              best[1],
+              best[0],
+              RUNS);
+}
+
+void Cluster::onSceneLoaded()
+{
+    if(!scene->loaded)
+    {
+        Log->error("Loading scene model failed");
+        return;
+    }
 
     // Sponza debug camera + lights
     if(!config->customScene)
@@ -181,6 +268,14 @@ void Cluster::update(float dt)
 {
     const float t = (float)glfwGetTime();
 
+    // create whatever the background load finished since the last frame
+    if(scene->loading())
+    {
+        scene->update();
+        if(!scene->loading())
+            onSceneLoaded();
+    }
+
     float velocity = scene->diagonal / 5.0f; // m/s
     if(isKeyDown(GLFW_KEY_W))
         scene->camera.move(scene->camera.forward() * velocity * dt);
@@ -200,6 +295,8 @@ void Cluster::update(float dt)
     scene->pointLights.update();
 
     renderer->render(dt);
+    // the demand of this frame picks the texture levels of the next ones
+    scene->updateStreaming(renderer->textureDemand, uint64_t(config->textureBudget) * 1024 * 1024);
     ui->update(dt);
 }
 
@@ -283,13 +380,13 @@ void Cluster::setRenderPath(RenderPath path)
     switch(path)
     {
         case RenderPath::Forward:
-            renderer = std::make_unique<ForwardRenderer>(scene.get());
+            renderer = std::make_unique<ForwardRenderer>(scene.get(), threads.get());
             break;
         case RenderPath::Deferred:
-            renderer = std::make_unique<DeferredRenderer>(scene.get());
+            renderer = std::make_unique<DeferredRenderer>(scene.get(), threads.get());
             break;
         case RenderPath::Clustered:
-            renderer = std::make_unique<ClusteredRenderer>(scene.get());
+            renderer = std::make_unique<ClusteredRenderer>(scene.get(), threads.get());
             break;
         default:
             assert(false);
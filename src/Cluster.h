@@ -10,6 +10,7 @@ class ClusterUI;
 class Config;
 class Scene;
 class Renderer;
+class ThreadPool;
 
 class Cluster : public bigg::Application
 {
@@ -45,10 +46,21 @@ public:
     };
     void setRenderPath(RenderPath path);
 
+    // load a scene with the current config settings, replaces the current scene
+    // returns false if a blocking load failed, asynchronous loads report errors when they're done
+    bool loadScene(const char* file);
+
     void generateLights(unsigned int count);
     void moveLights(float t, float dt);
 
 private:
+    // copy the scene options from the config
+    void configureScene();
+    // debug camera and lights once a scene is loaded
+    void onSceneLoaded();
+    // log the time of blocking loads with GltfLoader and assimp, leaves the scene empty
+    void benchmarkLoad(const char* file);
+
     class BgfxCallbacks : public bgfx::CallbackI
     {
     public:
@@ -93,4 +105,7 @@ private:
     std::unique_ptr<Scene> scene;
 
     std::unique_ptr<Renderer> renderer;
+
+    // shared by the renderer and scene loading
+    std::unique_ptr<ThreadPool> threads;
 };
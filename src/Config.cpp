@@ -1,6 +1,8 @@
 #include "Config.h"
 
 #include <bx/commandline.h>
+#include <algorithm>
+#include <cstdlib>
 #include "Renderer/Renderer.h"
 
 Config::Config() :
@@ -9,12 +11,29 @@ Config::Config() :
     renderer(bgfx::RendererType::Count), // default renderer, chosen by platform
     renderPath(Cluster::RenderPath::Clustered),
     tonemappingMode(Renderer::TonemappingMode::ACES),
+    occlusionCulling(Renderer::OcclusionCullingMode::QUERIES),
+    gpuCulling(false),
+    lod(true),
+    multithreadedSubmission(false),
     multipleScattering(true),
     whiteFurnace(false),
     profile(true),
     vsync(false),
     sceneFile("assets/models/Sponza/Sponza.gltf"),
     customScene(false),
+    mergeBuffers(true),
+    quantizeVertices(true),
+    generateLods(true),
+    instanceMeshes(false),
+    textureArrays(false),
+    compressTextures(true),
+    bc7Textures(false),
+    streamTextures(true),
+    textureBudget(512),
+    nativeGltf(true),
+    benchmarkLoad(false),
+    sceneCache(true),
+    asyncLoad(true),
     lights(1),
     maxLights(3000),
     movingLights(false),
@@ -58,4 +77,34 @@ void Config::readArgv(int argc, char* argv[])
         sceneFile = scene;
         customScene = true;
     }
+
+    if(cmdLine.hasArg("separate-buffers"))
+        mergeBuffers = false;
+    if(cmdLine.hasArg("float-vertices"))
+        quantizeVertices = false;
+    if(cmdLine.hasArg("no-lods"))
+        generateLods = false;
+    if(cmdLine.hasArg("instancing"))
+        instanceMeshes = true;
+    if(cmdLine.hasArg("texture-arrays"))
+        textureArrays = true;
+    if(cmdLine.hasArg("uncompressed-textures"))
+        compressTextures = false;
+    if(cmdLine.hasArg("bc7"))
+        bc7Textures = true;
+    if(cmdLine.hasArg("no-texture-streaming"))
+        streamTextures = false;
+    const char* budget = cmdLine.findOption("texture-budget");
+    if(budget)
+        textureBudget = std::max(std::atoi(budget), 1);
+    if(cmdLine.hasArg("assimp-gltf"))
+        nativeGltf = false;
+    if(cmdLine.hasArg("benchmark-load"))
+        benchmarkLoad = true;
+    if(cmdLine.hasArg("no-scene-cache"))
+        sceneCache = false;
+    if(cmdLine.hasArg("blocking-load"))
+        asyncLoad = false;
+    if(cmdLine.hasArg("mt-submit"))
+        multithreadedSubmission = true;
 }
@@ -23,6 +23,10 @@ public:
     bgfx::RendererType::Enum renderer; // *
     Cluster::RenderPath renderPath;
     Renderer::TonemappingMode tonemappingMode;
+    Renderer::OcclusionCullingMode occlusionCulling;
+    bool gpuCulling;
+    bool lod;
+    bool multithreadedSubmission;
 
     bool multipleScattering;
     bool whiteFurnace;
@@ -34,6 +38,19 @@ public:
 
     const char* sceneFile; // gltf file to load *
     bool customScene;      // not the standard Sponza scene, don't place debug lights/camera *
+    bool mergeBuffers;     // one vertex and index buffer for all meshes *
+    bool quantizeVertices; // compressed vertex format *
+    bool generateLods;     // simplified chunks for the renderer's LOD selection *
+    bool instanceMeshes;   // keep the node graph's mesh instances instead of duplicating them *
+    bool textureArrays;    // pack same-sized material textures into texture arrays *
+    bool compressTextures; // block compress material textures and keep compressed copies next to them *
+    bool bc7Textures;      // BC7 for color and data textures, slow to compress *
+    bool streamTextures;   // start textures at a small mip and load finer levels as they're needed *
+    int textureBudget;     // GPU memory for streamed textures in MB
+    bool nativeGltf;       // read glTF files without assimp when possible *
+    bool benchmarkLoad;    // time loading the scene with and without assimp on startup *
+    bool sceneCache;       // load from and write a binary cache next to the scene file *
+    bool asyncLoad;        // load scenes in the background while rendering *
     int lights;
     int maxLights; // *
     bool movingLights;
@@ -61,15 +61,18 @@ void ClusterShader::setUniforms(const Scene* scene, uint16_t screenWidth, uint16
     bgfx::setUniform(zNearFarVecUniform, zNearFarVec);
 }
 
-void ClusterShader::bindBuffers(bool lightingPass) const
+void ClusterShader::bindBuffers(bool lightingPass, bgfx::Encoder* encoder) const
 {
+    if(!encoder)
+        encoder = bgfx::begin();
+
     // binding ReadWrite in the fragment shader doesn't work with D3D11/12
     bgfx::Access::Enum access = lightingPass ? bgfx::Access::Read : bgfx::Access::ReadWrite;
     if(!lightingPass)
     {
-        bgfx::setBuffer(Samplers::CLUSTERS_CLUSTERS, clustersBuffer, access);
-        bgfx::setBuffer(Samplers::CLUSTERS_ATOMICINDEX, atomicIndexBuffer, access);
+        encoder->setBuffer(Samplers::CLUSTERS_CLUSTERS, clustersBuffer, access);
+        encoder->setBuffer(Samplers::CLUSTERS_ATOMICINDEX, atomicIndexBuffer, access);
     }
-    bgfx::setBuffer(Samplers::CLUSTERS_LIGHTINDICES, lightIndicesBuffer, access);
-    bgfx::setBuffer(Samplers::CLUSTERS_LIGHTGRID, lightGridBuffer, access);
+    encoder->setBuffer(Samplers::CLUSTERS_LIGHTINDICES, lightIndicesBuffer, access);
+    encoder->setBuffer(Samplers::CLUSTERS_LIGHTGRID, lightGridBuffer, access);
 }
@@ -13,7 +13,8 @@ public:
     void shutdown();
 
     void setUniforms(const Scene* scene, uint16_t screenWidth, uint16_t screenHeight) const;
-    void bindBuffers(bool lightingPass = true) const;
+    // encoder = nullptr binds on the main thread's encoder
+    void bindBuffers(bool lightingPass = true, bgfx::Encoder* encoder = nullptr) const;
 
     static constexpr uint32_t CLUSTERS_X = 16;
     static constexpr uint32_t CLUSTERS_Y = 8;
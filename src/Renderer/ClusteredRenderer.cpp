@@ -6,7 +6,7 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/ext/matrix_relational.hpp>
 
-ClusteredRenderer::ClusteredRenderer(const Scene* scene) : Renderer(scene) { }
+ClusteredRenderer::ClusteredRenderer(const Scene* scene, ThreadPool* threads) : Renderer(scene, threads) { }
 
 bool ClusteredRenderer::supported()
 {
@@ -23,7 +23,7 @@ void ClusteredRenderer::onInitialize()
     // OpenGL backend: uniforms must be created before loading shaders
     clusters.initialize();
 
-    char csName[128], vsName[128], fsName[128];
+    char csName[128];
 
     bx::snprintf(csName, BX_COUNTOF(csName), "%s%s", shaderDir(), "cs_clustered_clusterbuilding.bin");
     clusterBuildingComputeProgram = bgfx::createProgram(bigg::loadShader(csName), true);
@@ -34,12 +34,12 @@ void ClusteredRenderer::onInitialize()
     bx::snprintf(csName, BX_COUNTOF(csName), "%s%s", shaderDir(), "cs_clustered_lightculling.bin");
     lightCullingComputeProgram = bgfx::createProgram(bigg::loadShader(csName), true);
 
-    bx::snprintf(vsName, BX_COUNTOF(vsName), "%s%s", shaderDir(), "vs_clustered.bin");
-    bx::snprintf(fsName, BX_COUNTOF(fsName), "%s%s", shaderDir(), "fs_clustered.bin");
-    lightingProgram = bigg::loadProgram(vsName, fsName);
+    lightingProgram = loadSceneProgram("vs_clustered", "fs_clustered", true, true);
+    lightingInstancedProgram = loadSceneProgram("vs_instanced", "fs_clustered");
 
-    bx::snprintf(fsName, BX_COUNTOF(fsName), "%s%s", shaderDir(), "fs_clustered_debug_vis.bin");
-    debugVisProgram = bigg::loadProgram(vsName, fsName);
+    // debug visualization doesn't sample material textures
+    debugVisProgram = loadSceneProgram("vs_clustered", "fs_clustered_debug_vis", false, true);
+    debugVisInstancedProgram = loadSceneProgram("vs_instanced", "fs_clustered_debug_vis", false);
 }
 
 void ClusteredRenderer::onRender(float dt)
@@ -48,7 +48,9 @@ void ClusteredRenderer::onRender(float dt)
     {
         vClusterBuilding = 0,
         vLightCulling,
-        vLighting
+        vLighting,
+        vDepthPyramid, // build depth pyramid from opaque depth
+        vTransparent
     };
 
     bgfx::setViewName(vClusterBuilding, "Cluster building pass (compute)");
@@ -64,6 +66,11 @@ void ClusteredRenderer::onRender(float dt)
     bgfx::setViewFrameBuffer(vLighting, frameBuffer);
     bgfx::touch(vLighting);
 
+    bgfx::setViewName(vTransparent, "Clustered lighting pass (transparent)");
+    bgfx::setViewClear(vTransparent, BGFX_CLEAR_NONE);
+    bgfx::setViewRect(vTransparent, 0, 0, width, height);
+    bgfx::setViewFrameBuffer(vTransparent, frameBuffer);
+
     if(!scene->loaded)
         return;
 
@@ -74,6 +81,7 @@ void ClusteredRenderer::onRender(float dt)
     // light culling needs u_view to transform lights to eye space
     setViewProjection(vLightCulling);
     setViewProjection(vLighting);
+    setViewProjection(vTransparent);
 
     // cluster building
 
@@ -118,27 +126,22 @@ void ClusteredRenderer::onRender(float dt)
     // lighting
 
     bool debugVis = variables["DEBUG_VIS"] == "true";
-    bgfx::ProgramHandle program = debugVis ? debugVisProgram : lightingProgram;
+    const SceneProgram& program = debugVis ? debugVisProgram : lightingProgram;
+    const SceneProgram& instancedProgram = debugVis ? debugVisInstancedProgram : lightingInstancedProgram;
 
     uint64_t state = BGFX_STATE_DEFAULT & ~BGFX_STATE_CULL_MASK;
 
-    pbr.bindAlbedoLUT();
-    lights.bindLights(scene);
-    clusters.bindBuffers(true /*lightingPass*/); // read access, only light grid and indices
+    PassBindings bindings = [this](bgfx::Encoder* encoder) {
+        pbr.bindAlbedoLUT(false, encoder);
+        lights.bindLights(scene, encoder);
+        clusters.bindBuffers(true /*lightingPass*/, encoder); // read access, only light grid and indices
+    };
 
-    for(const Mesh& mesh : scene->meshes)
-    {
-        glm::mat4 model = glm::identity<glm::mat4>();
-        bgfx::setTransform(glm::value_ptr(model));
-        setNormalMatrix(model);
-        bgfx::setVertexBuffer(0, mesh.vertexBuffer);
-        bgfx::setIndexBuffer(mesh.indexBuffer);
-        const Material& mat = scene->materials[mesh.material];
-        uint64_t materialState = pbr.bindMaterial(mat);
-        bgfx::setState(state | materialState);
-        // preserve buffer bindings between submit calls
-        bgfx::submit(vLighting, program, 0, ~BGFX_DISCARD_BINDINGS);
-    }
+    // preserves buffer bindings between submit calls
+    submitDraws(vLighting, DrawList::Opaque, program, instancedProgram, state, bindings);
+    submitOcclusionQueries(vLighting);
+    buildDepthPyramid(vDepthPyramid, bgfx::getTexture(frameBuffer, 1));
+    submitDraws(vTransparent, DrawList::Transparent, program, instancedProgram, state, bindings);
 
     bgfx::discard(BGFX_DISCARD_ALL);
 }
@@ -150,9 +153,10 @@ void ClusteredRenderer::onShutdown()
     bgfx::destroy(clusterBuildingComputeProgram);
     bgfx::destroy(resetCounterComputeProgram);
     bgfx::destroy(lightCullingComputeProgram);
-    bgfx::destroy(lightingProgram);
-    bgfx::destroy(debugVisProgram);
+    destroy(lightingProgram);
+    destroy(debugVisProgram);
+    destroy(lightingInstancedProgram);
+    destroy(debugVisInstancedProgram);
 
-    clusterBuildingComputeProgram = resetCounterComputeProgram = lightCullingComputeProgram = lightingProgram =
-        debugVisProgram = BGFX_INVALID_HANDLE;
+    clusterBuildingComputeProgram = resetCounterComputeProgram = lightCullingComputeProgram = BGFX_INVALID_HANDLE;
 }
@@ -6,7 +6,7 @@
 class ClusteredRenderer : public Renderer
 {
 public:
-    ClusteredRenderer(const Scene* scene);
+    ClusteredRenderer(const Scene* scene, ThreadPool* threads);
 
     static bool supported();
 
@@ -20,8 +20,10 @@ private:
     bgfx::ProgramHandle clusterBuildingComputeProgram = BGFX_INVALID_HANDLE;
     bgfx::ProgramHandle resetCounterComputeProgram = BGFX_INVALID_HANDLE;
     bgfx::ProgramHandle lightCullingComputeProgram = BGFX_INVALID_HANDLE;
-    bgfx::ProgramHandle lightingProgram = BGFX_INVALID_HANDLE;
-    bgfx::ProgramHandle debugVisProgram = BGFX_INVALID_HANDLE;
+    SceneProgram lightingProgram;
+    SceneProgram debugVisProgram;
+    SceneProgram lightingInstancedProgram;
+    SceneProgram debugVisInstancedProgram;
 
     ClusterShader clusters;
 };
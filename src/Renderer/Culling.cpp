@@ -0,0 +1,87 @@
+#include "Culling.h"
+
+#include "Scene/Bounds.h"
+#include <bx/simd_t.h>
+#include <glm/geometric.hpp>
+#include <glm/common.hpp>
+
+// Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix
+// http://www.cs.otago.ca/postgrads/gribb/planes.pdf
+Frustum::Frustum(const glm::mat4& viewProj, bool homogeneousDepth)
+{
+    // glm is column major, we need the rows
+    glm::mat4 m = glm::transpose(viewProj);
+
+    planes[Left] = m[3] + m[0];
+    planes[Right] = m[3] - m[0];
+    planes[Bottom] = m[3] + m[1];
+    planes[Top] = m[3] - m[1];
+    planes[Near] = homogeneousDepth ? m[3] + m[2] : m[2];
+    planes[Far] = m[3] - m[2];
+
+    // normalize so distances can be compared to radii
+    for(glm::vec4& plane : planes)
+    {
+        plane /= glm::length(glm::vec3(plane));
+    }
+}
+
+uint32_t Frustum::cull(const BoundsSoA& bounds, uint8_t* visible) const
+{
+    using namespace bx;
+
+    // broadcast plane coefficients once
+    simd128_t px[Count], py[Count], pz[Count], pw[Count];
+    simd128_t ax[Count], ay[Count], az[Count];
+    for(size_t i = 0; i < Count; i++)
+    {
+        px[i] = simd_splat<simd128_t>(planes[i].x);
+        py[i] = simd_splat<simd128_t>(planes[i].y);
+        pz[i] = simd_splat<simd128_t>(planes[i].z);
+        pw[i] = simd_splat<simd128_t>(planes[i].w);
+        ax[i] = simd_splat<simd128_t>(glm::abs(planes[i].x));
+        ay[i] = simd_splat<simd128_t>(glm::abs(planes[i].y));
+        az[i] = simd_splat<simd128_t>(glm::abs(planes[i].z));
+    }
+
+    uint32_t culled = 0;
+    const BoundsSoA::Block* blocks = bounds.data();
+
+    for(size_t b = 0; b < bounds.blockCount(); b++)
+    {
+        const BoundsSoA::Block& block = blocks[b];
+        const simd128_t cx = simd_ld<simd128_t>(block.centerX);
+        const simd128_t cy = simd_ld<simd128_t>(block.centerY);
+        const simd128_t cz = simd_ld<simd128_t>(block.centerZ);
+        const simd128_t ex = simd_ld<simd128_t>(block.extentX);
+        const simd128_t ey = simd_ld<simd128_t>(block.extentY);
+        const simd128_t ez = simd_ld<simd128_t>(block.extentZ);
+        const simd128_t r = simd_ld<simd128_t>(block.radius);
+
+        simd128_t outside = simd_zero<simd128_t>();
+        for(size_t i = 0; i < Count; i++)
+        {
+            // signed distance of the center
+            const simd128_t dist = simd_madd(px[i], cx, simd_madd(py[i], cy, simd_madd(pz[i], cz, pw[i])));
+            // AABB extents projected onto the plane normal
+            const simd128_t boxRadius = simd_madd(ax[i], ex, simd_madd(ay[i], ey, simd_mul(az[i], ez)));
+            // whichever volume is tighter for this plane
+            const simd128_t reach = simd_min(boxRadius, r);
+            outside = simd_or(outside, simd_cmplt(dist, simd_neg(reach)));
+        }
+
+        alignas(16) uint32_t mask[BoundsSoA::LANES];
+        simd_st(mask, outside);
+
+        size_t first = b * BoundsSoA::LANES;
+        size_t lanes = bx::min(BoundsSoA::LANES, bounds.size() - first);
+        for(size_t lane = 0; lane < lanes; lane++)
+        {
+            bool isVisible = mask[lane] == 0;
+            visible[first + lane] = isVisible ? 1 : 0;
+            culled += isVisible ? 0 : 1;
+        }
+    }
+
+    return culled;
+}
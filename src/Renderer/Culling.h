@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glm/matrix.hpp>
+#include <glm/vec4.hpp>
+
+class BoundsSoA;
+
+// view frustum as 6 normalized planes pointing inwards
+// a point p is inside if dot(plane.xyz, p) + plane.w >= 0 for all planes
+class Frustum
+{
+public:
+    enum Plane
+    {
+        Left = 0,
+        Right,
+        Bottom,
+        Top,
+        Near,
+        Far,
+
+        Count
+    };
+
+    // extract planes from a (view-)projection matrix
+    // homogeneousDepth as in bgfx::Caps, decides between [-1, 1] and [0, 1] clip space depth
+    Frustum(const glm::mat4& viewProj, bool homogeneousDepth);
+
+    // test world space bounding volumes against the frustum, 4 at a time
+    // a volume is visible if both its AABB and its sphere intersect every plane
+    // writes 0 (culled) or 1 (visible) per volume and returns the number of culled volumes
+    uint32_t cull(const BoundsSoA& bounds, uint8_t* visible) const;
+
+    glm::vec4 planes[Count];
+};
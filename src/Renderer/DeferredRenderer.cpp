@@ -10,8 +10,8 @@
 constexpr bgfx::TextureFormat::Enum
     DeferredRenderer::gBufferAttachmentFormats[DeferredRenderer::GBufferAttachment::Count - 1];
 
-DeferredRenderer::DeferredRenderer(const Scene* scene) :
-    Renderer(scene),
+DeferredRenderer::DeferredRenderer(const Scene* scene, ThreadPool* threads) :
+    Renderer(scene, threads),
     gBufferTextures { { BGFX_INVALID_HANDLE, "Diffuse + roughness" },
                       { BGFX_INVALID_HANDLE, "Normal" },
                       { BGFX_INVALID_HANDLE, "F0 + metallic" },
@@ -82,9 +82,7 @@ void DeferredRenderer::onInitialize()
 
     char vsName[128], fsName[128];
 
-    bx::snprintf(vsName, BX_COUNTOF(vsName), "%s%s", shaderDir(), "vs_deferred_geometry.bin");
-    bx::snprintf(fsName, BX_COUNTOF(fsName), "%s%s", shaderDir(), "fs_deferred_geometry.bin");
-    geometryProgram = bigg::loadProgram(vsName, fsName);
+    geometryProgram = loadSceneProgram("vs_deferred_geometry", "fs_deferred_geometry", true, true);
 
     bx::snprintf(vsName, BX_COUNTOF(vsName), "%s%s", shaderDir(), "vs_deferred_fullscreen.bin");
     bx::snprintf(fsName, BX_COUNTOF(fsName), "%s%s", shaderDir(), "fs_deferred_fullscreen.bin");
@@ -94,9 +92,9 @@ void DeferredRenderer::onInitialize()
     bx::snprintf(fsName, BX_COUNTOF(fsName), "%s%s", shaderDir(), "fs_deferred_pointlight.bin");
     pointLightProgram = bigg::loadProgram(vsName, fsName);
 
-    bx::snprintf(vsName, BX_COUNTOF(vsName), "%s%s", shaderDir(), "vs_forward.bin");
-    bx::snprintf(fsName, BX_COUNTOF(fsName), "%s%s", shaderDir(), "fs_forward.bin");
-    transparencyProgram = bigg::loadProgram(vsName, fsName);
+    transparencyProgram = loadSceneProgram("vs_forward", "fs_forward");
+    transparencyInstancedProgram = loadSceneProgram("vs_instanced", "fs_forward");
+    geometryInstancedProgram = loadSceneProgram("vs_deferred_geometry_instanced", "fs_deferred_geometry");
 }
 
 void DeferredRenderer::onReset()
@@ -137,7 +135,8 @@ void DeferredRenderer::onRender(float dt)
         vGeometry = 0,    // write G-Buffer
         vFullscreenLight, // write ambient + emissive to output buffer
         vLight,           // render lights to output buffer
-        vTransparent      // forward pass for transparency
+        vTransparent,     // forward pass for transparency
+        vDepthPyramid     // build depth pyramid from G-Buffer depth
     };
 
     const uint32_t BLACK = 0x000000FF;
@@ -178,22 +177,9 @@ void DeferredRenderer::onRender(float dt)
 
     const uint64_t state = BGFX_STATE_DEFAULT & ~BGFX_STATE_CULL_MASK;
 
-    for(const Mesh& mesh : scene->meshes)
-    {
-        const Material& mat = scene->materials[mesh.material];
-        // transparent materials are rendered in a separate forward pass (view vTransparent)
-        if(!mat.blend)
-        {
-            glm::mat4 model = glm::identity<glm::mat4>();
-            bgfx::setTransform(glm::value_ptr(model));
-            setNormalMatrix(model);
-            bgfx::setVertexBuffer(0, mesh.vertexBuffer);
-            bgfx::setIndexBuffer(mesh.indexBuffer);
-            uint64_t materialState = pbr.bindMaterial(mat);
-            bgfx::setState(state | materialState);
-            bgfx::submit(vGeometry, geometryProgram);
-        }
-    }
+    // transparent materials are rendered in a separate forward pass (view vTransparent)
+    submitDraws(vGeometry, DrawList::Opaque, geometryProgram, geometryInstancedProgram, state);
+    submitOcclusionQueries(vGeometry);
 
     // copy G-Buffer depth attachment to depth texture for sampling in the light pass
     // we can't attach it to the frame buffer and read it in the shader (unprojecting world position) at the same time
@@ -256,31 +242,31 @@ void DeferredRenderer::onRender(float dt)
 
     // transparent
 
-    for(const Mesh& mesh : scene->meshes)
-    {
-        const Material& mat = scene->materials[mesh.material];
-        if(mat.blend)
-        {
-            glm::mat4 model = glm::identity<glm::mat4>();
-            bgfx::setTransform(glm::value_ptr(model));
-            setNormalMatrix(model);
-            bgfx::setVertexBuffer(0, mesh.vertexBuffer);
-            bgfx::setIndexBuffer(mesh.indexBuffer);
-            uint64_t materialState = pbr.bindMaterial(mat);
-            bgfx::setState(state | materialState);
-            bgfx::submit(vTransparent, transparencyProgram, 0, ~BGFX_DISCARD_BINDINGS);
-        }
-    }
+    PassBindings bindings = [this](bgfx::Encoder* encoder) {
+        pbr.bindAlbedoLUT(false, encoder);
+        lights.bindLights(scene, encoder);
+    };
+    submitDraws(vTransparent,
+                DrawList::Transparent,
+                transparencyProgram,
+                transparencyInstancedProgram,
+                state,
+                bindings);
+
+    // G-Buffer depth only contains opaque geometry
+    buildDepthPyramid(vDepthPyramid, bgfx::getTexture(gBuffer, GBufferAttachment::Depth));
 
     bgfx::discard(BGFX_DISCARD_ALL);
 }
 
 void DeferredRenderer::onShutdown()
 {
-    bgfx::destroy(geometryProgram);
+    destroy(geometryProgram);
     bgfx::destroy(pointLightProgram);
     bgfx::destroy(fullscreenProgram);
-    bgfx::destroy(transparencyProgram);
+    destroy(transparencyProgram);
+    destroy(geometryInstancedProgram);
+    destroy(transparencyInstancedProgram);
     for(bgfx::UniformHandle& handle : gBufferSamplers)
     {
         bgfx::destroy(handle);
@@ -295,7 +281,7 @@ void DeferredRenderer::onShutdown()
     if(bgfx::isValid(accumFrameBuffer))
         bgfx::destroy(accumFrameBuffer);
 
-    geometryProgram = fullscreenProgram = pointLightProgram = transparencyProgram = BGFX_INVALID_HANDLE;
+    fullscreenProgram = pointLightProgram = BGFX_INVALID_HANDLE;
     lightIndexVecUniform = BGFX_INVALID_HANDLE;
     pointLightVertexBuffer = BGFX_INVALID_HANDLE;
     pointLightIndexBuffer = BGFX_INVALID_HANDLE;
@@ -5,7 +5,7 @@
 class DeferredRenderer : public Renderer
 {
 public:
-    DeferredRenderer(const Scene* scene);
+    DeferredRenderer(const Scene* scene, ThreadPool* threads);
 
     static bool supported();
 
@@ -68,10 +68,12 @@ private:
 
     bgfx::UniformHandle lightIndexVecUniform = BGFX_INVALID_HANDLE;
 
-    bgfx::ProgramHandle geometryProgram = BGFX_INVALID_HANDLE;
+    SceneProgram geometryProgram;
     bgfx::ProgramHandle fullscreenProgram = BGFX_INVALID_HANDLE;
     bgfx::ProgramHandle pointLightProgram = BGFX_INVALID_HANDLE;
-    bgfx::ProgramHandle transparencyProgram = BGFX_INVALID_HANDLE;
+    SceneProgram transparencyProgram;
+    SceneProgram geometryInstancedProgram;
+    SceneProgram transparencyInstancedProgram;
 
     static bgfx::FrameBufferHandle createGBuffer();
     void bindGBuffer();
@@ -0,0 +1,250 @@
+#include "DepthPyramid.h"
+
+#include "Renderer/Renderer.h"
+#include "Renderer/Samplers.h"
+#include "Scene/Scene.h"
+#include <bigg.hpp>
+#include <bx/string.h>
+#include <glm/common.hpp>
+#include <glm/vector_relational.hpp>
+#include <limits>
+
+// keep in sync with hiz.sh
+static constexpr uint16_t HIZ_THREADS = 8;
+
+bool DepthPyramid::supported()
+{
+    const bgfx::Caps* caps = bgfx::getCaps();
+    const uint16_t imageFlags = BGFX_CAPS_FORMAT_TEXTURE_IMAGE_READ | BGFX_CAPS_FORMAT_TEXTURE_IMAGE_WRITE;
+    return (caps->supported & BGFX_CAPS_COMPUTE) != 0 && (caps->supported & BGFX_CAPS_TEXTURE_BLIT) != 0 &&
+           (caps->supported & BGFX_CAPS_TEXTURE_READ_BACK) != 0 && (caps->formats[FORMAT] & imageFlags) == imageFlags;
+}
+
+void DepthPyramid::initialize()
+{
+    depthSampler = bgfx::createUniform("s_texDepth", bgfx::UniformType::Sampler);
+    sizeVecUniform = bgfx::createUniform("u_hizSizeVec", bgfx::UniformType::Vec4);
+
+    char csName[128];
+    bx::snprintf(csName, BX_COUNTOF(csName), "%s%s", Renderer::shaderDir(), "cs_hiz_depth.bin");
+    depthProgram = bgfx::createProgram(bigg::loadShader(csName), true);
+    bx::snprintf(csName, BX_COUNTOF(csName), "%s%s", Renderer::shaderDir(), "cs_hiz_downsample.bin");
+    downsampleProgram = bgfx::createProgram(bigg::loadShader(csName), true);
+
+    readData.resize(READBACK_SIZE * READBACK_SIZE * 2);
+}
+
+void DepthPyramid::shutdown()
+{
+    bgfx::destroy(depthProgram);
+    bgfx::destroy(downsampleProgram);
+    bgfx::destroy(depthSampler);
+    bgfx::destroy(sizeVecUniform);
+    if(bgfx::isValid(texture))
+        bgfx::destroy(texture);
+    if(bgfx::isValid(readTexture))
+        bgfx::destroy(readTexture);
+
+    depthProgram = downsampleProgram = BGFX_INVALID_HANDLE;
+    depthSampler = sizeVecUniform = BGFX_INVALID_HANDLE;
+    texture = readTexture = BGFX_INVALID_HANDLE;
+
+    invalidate();
+}
+
+void DepthPyramid::reset(uint16_t width, uint16_t height)
+{
+    if(bgfx::isValid(texture))
+        bgfx::destroy(texture);
+    if(bgfx::isValid(readTexture))
+        bgfx::destroy(readTexture);
+
+    depthWidth = width;
+    depthHeight = height;
+    this->width = bx::max<uint16_t>(width / 2, 1);
+    this->height = bx::max<uint16_t>(height / 2, 1);
+
+    // full mip chain, same as bgfx calculates it
+    levels = 1;
+    while((this->width >> levels) > 0 || (this->height >> levels) > 0)
+        levels++;
+
+    const uint64_t samplerFlags = BGFX_SAMPLER_MIN_POINT | BGFX_SAMPLER_MAG_POINT | BGFX_SAMPLER_MIP_POINT |
+                                  BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP;
+
+    texture =
+        bgfx::createTexture2D(this->width, this->height, true, 1, FORMAT, BGFX_TEXTURE_COMPUTE_WRITE | samplerFlags);
+    bgfx::setName(texture, "Depth pyramid");
+
+    // first level that fits into the read back size
+    readLevel = 0;
+    while(readLevel + 1 < levels && (bx::max(this->width, this->height) >> readLevel) > READBACK_SIZE)
+        readLevel++;
+    readWidth = bx::max<uint16_t>(this->width >> readLevel, 1);
+    readHeight = bx::max<uint16_t>(this->height >> readLevel, 1);
+
+    readTexture = bgfx::createTexture2D(
+        readWidth, readHeight, false, 1, FORMAT, BGFX_TEXTURE_BLIT_DST | BGFX_TEXTURE_READ_BACK | samplerFlags);
+
+    invalidate();
+}
+
+void DepthPyramid::invalidate()
+{
+    // a read might still be in flight, its result is ignored
+    // readData is big enough for any size so that's safe
+    readPending = false;
+    built = false;
+    cpuDepth.clear();
+    cpuWidth = cpuHeight = 0;
+}
+
+void DepthPyramid::build(bgfx::ViewId buildView,
+                         bgfx::ViewId readView,
+                         bgfx::TextureHandle depth,
+                         const glm::mat4& viewProj)
+{
+    frame++;
+
+    if(readPending && (frame - readFrame) >= READBACK_LATENCY)
+    {
+        cpuDepth.assign(readData.begin(), readData.begin() + readWidth * readHeight * 2);
+        cpuWidth = readWidth;
+        cpuHeight = readHeight;
+        cpuViewProj = readViewProj;
+        readPending = false;
+    }
+
+    bgfx::setViewName(buildView, "Depth pyramid (compute)");
+    bgfx::setViewName(readView, "Depth pyramid read back");
+
+    uint16_t inWidth = depthWidth, inHeight = depthHeight;
+    for(uint8_t level = 0; level < levels; level++)
+    {
+        uint16_t outWidth = bx::max<uint16_t>(width >> level, 1);
+        uint16_t outHeight = bx::max<uint16_t>(height >> level, 1);
+
+        if(level == 0)
+            bgfx::setTexture(Samplers::HIZ_INPUT, depthSampler, depth);
+        else
+            bgfx::setImage(Samplers::HIZ_INPUT, texture, level - 1, bgfx::Access::Read, FORMAT);
+        bgfx::setImage(Samplers::HIZ_OUTPUT, texture, level, bgfx::Access::Write, FORMAT);
+
+        float sizeVec[4] = { (float)inWidth, (float)inHeight, (float)outWidth, (float)outHeight };
+        bgfx::setUniform(sizeVecUniform, sizeVec);
+
+        bgfx::dispatch(buildView,
+                       level == 0 ? depthProgram : downsampleProgram,
+                       (outWidth + HIZ_THREADS - 1) / HIZ_THREADS,
+                       (outHeight + HIZ_THREADS - 1) / HIZ_THREADS,
+                       1);
+
+        inWidth = outWidth;
+        inHeight = outHeight;
+    }
+
+    built = true;
+    this->viewProj = viewProj;
+
+    // only one read in flight, the pyramid itself is rebuilt every frame
+    if(!readPending)
+    {
+        bgfx::blit(readView, readTexture, 0, 0, 0, 0, texture, readLevel, 0, 0, 0, readWidth, readHeight, 1);
+        bgfx::readTexture(readTexture, readData.data());
+        bgfx::touch(readView);
+        readPending = true;
+        readFrame = frame;
+        readViewProj = viewProj;
+    }
+}
+
+uint32_t DepthPyramid::cull(const Scene* scene, uint8_t* visibility) const
+{
+    if(cpuDepth.empty())
+        return 0;
+
+    const bgfx::Caps* caps = bgfx::getCaps();
+
+    uint32_t culled = 0;
+    for(size_t i = 0; i < scene->chunks.size(); i++)
+    {
+        if(!visibility[i])
+            continue;
+
+        // screen space bounds of the box corners
+        const AABB& aabb = scene->chunks[i].aabb;
+        glm::vec3 ndcMin = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 ndcMax = glm::vec3(-std::numeric_limits<float>::max());
+        bool crossesNearPlane = false;
+        for(int corner = 0; corner < 8; corner++)
+        {
+            glm::vec4 pos = { (corner & 1) ? aabb.max.x : aabb.min.x,
+                              (corner & 2) ? aabb.max.y : aabb.min.y,
+                              (corner & 4) ? aabb.max.z : aabb.min.z,
+                              1.0f };
+            glm::vec4 clip = cpuViewProj * pos;
+            if(clip.w <= std::numeric_limits<float>::epsilon())
+            {
+                crossesNearPlane = true;
+                break;
+            }
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            ndcMin = glm::min(ndcMin, ndc);
+            ndcMax = glm::max(ndcMax, ndc);
+        }
+
+        // no depth information for boxes behind or outside of the old view
+        if(crossesNearPlane || glm::any(glm::lessThan(glm::vec2(ndcMin), glm::vec2(-1.0f))) ||
+           glm::any(glm::greaterThan(glm::vec2(ndcMax), glm::vec2(1.0f))))
+            continue;
+
+        // nearest depth of the box in [0, 1]
+        float nearest = caps->homogeneousDepth ? ndcMin.z * 0.5f + 0.5f : ndcMin.z;
+
+        // texel rectangle covered by the box
+        glm::vec2 uvMin = glm::vec2(ndcMin) * 0.5f + 0.5f;
+        glm::vec2 uvMax = glm::vec2(ndcMax) * 0.5f + 0.5f;
+        if(!caps->originBottomLeft)
+        {
+            // texture rows start at the top
+            float top = 1.0f - uvMax.y;
+            uvMax.y = 1.0f - uvMin.y;
+            uvMin.y = top;
+        }
+        // go through the depth buffer pixels, uv * level size can miss the texel containing the box edge
+        // a texel covers 2x2 texels of the level below and the last row and column also cover the remainder
+        // so the pixel shifted by the level and clamped to the level size is the texel containing it
+        const int shift = readLevel + 1;
+        auto texel = [shift](float uv, int depthSize, int levelSize) {
+            int pixel = glm::clamp(int(uv * depthSize), 0, depthSize - 1);
+            return glm::min(pixel >> shift, levelSize - 1);
+        };
+        int x0 = texel(uvMin.x, depthWidth, cpuWidth);
+        int x1 = texel(uvMax.x, depthWidth, cpuWidth);
+        int y0 = texel(uvMin.y, depthHeight, cpuHeight);
+        int y1 = texel(uvMax.y, depthHeight, cpuHeight);
+
+        // occluded if it's behind the farthest depth in all covered texels
+        bool occluded = true;
+        for(int y = y0; y <= y1 && occluded; y++)
+        {
+            for(int x = x0; x <= x1; x++)
+            {
+                float maxDepth = cpuDepth[(y * cpuWidth + x) * 2 + 1];
+                if(nearest <= maxDepth)
+                {
+                    occluded = false;
+                    break;
+                }
+            }
+        }
+
+        if(occluded)
+        {
+            visibility[i] = 0;
+            culled++;
+        }
+    }
+
+    return culled;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <bgfx/bgfx.h>
+#include <glm/matrix.hpp>
+#include <vector>
+
+class Scene;
+
+// hierarchical min/max depth buffer (Hi-Z) for occlusion culling
+// built with compute shaders from a frame's depth buffer, level 0 is half the depth buffer size
+// a coarse level is read back and chunk bounding boxes are tested against it on the CPU,
+// projected with the matrix of the frame the depth came from
+class DepthPyramid
+{
+public:
+    static bool supported();
+
+    void initialize();
+    void shutdown();
+
+    // recreate the pyramid for a new depth buffer size
+    void reset(uint16_t width, uint16_t height);
+    // drop the last read back, e.g. after it wasn't built for a while
+    void invalidate();
+
+    // build the pyramid from a depth texture rendered with viewProj
+    // buildView runs the compute passes, readView blits the read back level and has to come after buildView
+    void build(bgfx::ViewId buildView, bgfx::ViewId readView, bgfx::TextureHandle depth, const glm::mat4& viewProj);
+
+    // remove chunks whose bounding box is behind the read back depth
+    // returns the number of culled chunks
+    uint32_t cull(const Scene* scene, uint8_t* visibility) const;
+
+    // full pyramid, R = min depth, G = max depth
+    bgfx::TextureHandle texture = BGFX_INVALID_HANDLE;
+
+    // texture contents, only valid after the first build since the last invalidate
+    bool valid() const
+    {
+        return built;
+    }
+    // view projection matrix of the last build
+    const glm::mat4& builtViewProj() const
+    {
+        return viewProj;
+    }
+    // level 0 size
+    uint16_t getWidth() const
+    {
+        return width;
+    }
+    uint16_t getHeight() const
+    {
+        return height;
+    }
+    uint8_t getLevels() const
+    {
+        return levels;
+    }
+    // size of the depth buffer it's built from
+    uint16_t getDepthWidth() const
+    {
+        return depthWidth;
+    }
+    uint16_t getDepthHeight() const
+    {
+        return depthHeight;
+    }
+
+private:
+    static constexpr bgfx::TextureFormat::Enum FORMAT = bgfx::TextureFormat::RG32F;
+
+    // largest dimension of the read back level
+    static constexpr uint16_t READBACK_SIZE = 128;
+    // bgfx::readTexture results are ready after 2 calls to bgfx::frame
+    static constexpr uint32_t READBACK_LATENCY = 2;
+
+    uint16_t depthWidth = 0;
+    uint16_t depthHeight = 0;
+
+    uint16_t width = 0; // level 0
+    uint16_t height = 0;
+    uint8_t levels = 0;
+
+    // read back level
+    uint8_t readLevel = 0;
+    uint16_t readWidth = 0;
+    uint16_t readHeight = 0;
+    bgfx::TextureHandle readTexture = BGFX_INVALID_HANDLE;
+
+    // written by bgfx, sized for READBACK_SIZE so it never gets reallocated while a read is in flight
+    std::vector<float> readData;
+    bool readPending = false;
+    uint32_t readFrame = 0;
+    glm::mat4 readViewProj = glm::mat4(1.0f);
+
+    // latest complete read back
+    std::vector<float> cpuDepth;
+    uint16_t cpuWidth = 0;
+    uint16_t cpuHeight = 0;
+    glm::mat4 cpuViewProj = glm::mat4(1.0f);
+
+    uint32_t frame = 0;
+
+    bool built = false;
+    glm::mat4 viewProj = glm::mat4(1.0f);
+
+    bgfx::ProgramHandle depthProgram = BGFX_INVALID_HANDLE;
+    bgfx::ProgramHandle downsampleProgram = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle depthSampler = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle sizeVecUniform = BGFX_INVALID_HANDLE;
+};
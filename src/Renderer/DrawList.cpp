@@ -0,0 +1,111 @@
+#include "DrawList.h"
+
+#include "Scene/Scene.h"
+#include "Renderer/PBRShader.h"
+#include <bx/sort.h>
+#include <glm/common.hpp>
+#include <cassert>
+
+void DrawList::build(const Scene* scene)
+{
+    assert(scene != nullptr);
+
+    clear();
+
+    draws.reserve(scene->chunks.size());
+    for(uint32_t i = 0; i < scene->chunks.size(); i++)
+    {
+        const MeshChunk& chunk = scene->chunks[i];
+        const Mesh& mesh = scene->meshes[chunk.mesh];
+        const Material& mat = scene->materials[mesh.material];
+        Draw draw;
+        draw.chunk = i;
+        draw.mesh = chunk.mesh;
+        draw.material = mesh.material;
+        draw.pass = mat.blend ? Transparent : Opaque;
+        draw.program = 0;
+        draw.center = chunk.aabb.center();
+        draw.vertexBuffer = mesh.vertexBuffer;
+        draw.indexBuffer = mesh.indexBuffer;
+        draw.firstIndex = mesh.firstIndex;
+        draw.state = PBRShader::materialState(mat);
+        draws.push_back(draw);
+    }
+
+    staticKeys.resize(draws.size());
+    for(size_t i = 0; i < draws.size(); i++)
+    {
+        const Draw& draw = draws[i];
+        uint64_t materialShift = draw.pass == Opaque ? HIGH_SHIFT : LOW_SHIFT;
+        staticKeys[i] = (uint64_t(draw.pass) << PASS_SHIFT) | ((draw.program & PROGRAM_MASK) << PROGRAM_SHIFT) |
+                        ((draw.material & MATERIAL_MASK) << materialShift);
+    }
+
+    keys.resize(draws.size());
+    tempKeys.resize(draws.size());
+    order.resize(draws.size());
+    tempOrder.resize(draws.size());
+
+    // pass offsets don't change with depth
+    for(const Draw& draw : draws)
+    {
+        passOffsets[draw.pass + 1]++;
+    }
+    for(size_t pass = 0; pass < Pass::Count; pass++)
+    {
+        passOffsets[pass + 1] += passOffsets[pass];
+    }
+
+    isBuilt = true;
+}
+
+void DrawList::clear()
+{
+    draws.clear();
+    staticKeys.clear();
+    keys.clear();
+    tempKeys.clear();
+    order.clear();
+    tempOrder.clear();
+    for(uint32_t& offset : passOffsets)
+    {
+        offset = 0;
+    }
+    isBuilt = false;
+}
+
+void DrawList::sort(const Camera& camera)
+{
+    if(draws.empty())
+        return;
+
+    // view space depth along the camera's forward vector
+    // quantized linearly between near and far plane
+    const glm::vec3 camPos = camera.position();
+    const glm::vec3 forward = camera.forward();
+    const float scale = float(DEPTH_MASK) / (camera.zFar - camera.zNear);
+
+    for(uint32_t i = 0; i < draws.size(); i++)
+    {
+        const Draw& draw = draws[i];
+        float depth = glm::dot(draw.center - camPos, forward) - camera.zNear;
+        uint64_t bucket = uint64_t(glm::clamp(depth * scale, 0.0f, float(DEPTH_MASK)));
+        if(draw.pass == Opaque)
+            keys[i] = staticKeys[i] | (bucket << LOW_SHIFT);
+        else
+            keys[i] = staticKeys[i] | ((DEPTH_MASK - bucket) << HIGH_SHIFT);
+        order[i] = i;
+    }
+
+    bx::radixSort(keys.data(), tempKeys.data(), order.data(), tempOrder.data(), uint32_t(keys.size()));
+}
+
+const uint32_t* DrawList::begin(Pass pass) const
+{
+    return order.data() + passOffsets[pass];
+}
+
+const uint32_t* DrawList::end(Pass pass) const
+{
+    return order.data() + passOffsets[pass + 1];
+}
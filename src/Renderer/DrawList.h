@@ -0,0 +1,83 @@
+#pragma once
+
+#include <bgfx/bgfx.h>
+#include <glm/vec3.hpp>
+#include <vector>
+
+class Scene;
+struct Camera;
+
+// list of mesh chunk draw calls with 64-bit sort keys
+// rebuilt whenever the scene's geometry changes, only the depth part of the keys changes per frame
+// submitting in key order groups draws by program and material so redundant state changes can be skipped
+// draws also carry their buffers and material state so submitting them doesn't need to look at the scene
+class DrawList
+{
+public:
+    enum Pass : uint8_t
+    {
+        Opaque = 0,
+        Transparent,
+
+        Count
+    };
+
+    struct Draw
+    {
+        uint32_t chunk;    // index into scene chunks
+        uint32_t mesh;     // index into scene meshes
+        uint32_t material; // index into scene materials
+        Pass pass;
+        uint8_t program;  // program variant within a pass, the renderer maps this to a program handle
+        glm::vec3 center; // sorting position
+
+        // prebaked submission data, the list is rebuilt when the scene changes
+        bgfx::VertexBufferHandle vertexBuffer;
+        bgfx::IndexBufferHandle indexBuffer;
+        uint32_t firstIndex; // start of the mesh in indexBuffer, chunk LOD ranges are relative to this
+        uint64_t state;      // material state bits
+    };
+
+    void build(const Scene* scene);
+    void clear();
+
+    bool built() const
+    {
+        return isBuilt;
+    }
+
+    // update depth buckets for the camera and radix sort the keys
+    void sort(const Camera& camera);
+
+    // sorted draw indices of a pass
+    const uint32_t* begin(Pass pass) const;
+    const uint32_t* end(Pass pass) const;
+
+    std::vector<Draw> draws;
+
+private:
+    // sort key layout, MSB to LSB:
+    // opaque:      pass (2) | program (8) | material (16) | depth (16) | unused (22)
+    // transparent: pass (2) | program (8) | inverted depth (16) | material (16) | unused (22)
+    // opaque draws are sorted by state first and roughly front-to-back within a material
+    // transparent draws have to be sorted back-to-front for blending, state only breaks ties
+    static constexpr uint32_t PASS_SHIFT = 62;
+    static constexpr uint32_t PROGRAM_SHIFT = 54;
+    static constexpr uint32_t HIGH_SHIFT = 38;
+    static constexpr uint32_t LOW_SHIFT = 22;
+
+    static constexpr uint64_t PROGRAM_MASK = 0xff;
+    static constexpr uint64_t MATERIAL_MASK = 0xffff;
+    static constexpr uint64_t DEPTH_MASK = 0xffff;
+
+    bool isBuilt = false;
+
+    // pass, program and material bits, set on build
+    std::vector<uint64_t> staticKeys;
+
+    // radix sort needs scratch buffers of the same size
+    std::vector<uint64_t> keys, tempKeys;
+    std::vector<uint32_t> order, tempOrder;
+
+    uint32_t passOffsets[Pass::Count + 1] = { 0 };
+};
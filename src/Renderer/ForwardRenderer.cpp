@@ -6,7 +6,7 @@
 #include <glm/matrix.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-ForwardRenderer::ForwardRenderer(const Scene* scene) : Renderer(scene) { }
+ForwardRenderer::ForwardRenderer(const Scene* scene, ThreadPool* threads) : Renderer(scene, threads) { }
 
 bool ForwardRenderer::supported()
 {
@@ -15,15 +15,18 @@ bool ForwardRenderer::supported()
 
 void ForwardRenderer::onInitialize()
 {
-    char vsName[128], fsName[128];
-    bx::snprintf(vsName, BX_COUNTOF(vsName), "%s%s", shaderDir(), "vs_forward.bin");
-    bx::snprintf(fsName, BX_COUNTOF(fsName), "%s%s", shaderDir(), "fs_forward.bin");
-    program = bigg::loadProgram(vsName, fsName);
+    program = loadSceneProgram("vs_forward", "fs_forward", true, true);
+    instancedProgram = loadSceneProgram("vs_instanced", "fs_forward");
 }
 
 void ForwardRenderer::onRender(float dt)
 {
-    bgfx::ViewId vDefault = 0;
+    enum : bgfx::ViewId
+    {
+        vDefault = 0,
+        vDepthPyramid, // build depth pyramid from opaque depth
+        vTransparent
+    };
 
     bgfx::setViewName(vDefault, "Forward render pass");
     bgfx::setViewClear(vDefault, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, clearColor, 1.0f, 0);
@@ -34,34 +37,35 @@ void ForwardRenderer::onRender(float dt)
     // this makes sure the clear happens
     bgfx::touch(vDefault);
 
+    bgfx::setViewName(vTransparent, "Forward render pass (transparent)");
+    bgfx::setViewClear(vTransparent, BGFX_CLEAR_NONE);
+    bgfx::setViewRect(vTransparent, 0, 0, width, height);
+    bgfx::setViewFrameBuffer(vTransparent, frameBuffer);
+
     if(!scene->loaded)
         return;
 
     setViewProjection(vDefault);
+    setViewProjection(vTransparent);
 
     uint64_t state = BGFX_STATE_DEFAULT & ~BGFX_STATE_CULL_MASK;
 
-    pbr.bindAlbedoLUT();
-    lights.bindLights(scene);
+    PassBindings bindings = [this](bgfx::Encoder* encoder) {
+        pbr.bindAlbedoLUT(false, encoder);
+        lights.bindLights(scene, encoder);
+    };
 
-    for(const Mesh& mesh : scene->meshes)
-    {
-        glm::mat4 model = glm::identity<glm::mat4>();
-        bgfx::setTransform(glm::value_ptr(model));
-        setNormalMatrix(model);
-        bgfx::setVertexBuffer(0, mesh.vertexBuffer);
-        bgfx::setIndexBuffer(mesh.indexBuffer);
-        const Material& mat = scene->materials[mesh.material];
-        uint64_t materialState = pbr.bindMaterial(mat);
-        bgfx::setState(state | materialState);
-        bgfx::submit(vDefault, program, 0, ~BGFX_DISCARD_BINDINGS);
-    }
+    // opaque first, transparent meshes back-to-front on top
+    submitDraws(vDefault, DrawList::Opaque, program, instancedProgram, state, bindings);
+    submitOcclusionQueries(vDefault);
+    buildDepthPyramid(vDepthPyramid, bgfx::getTexture(frameBuffer, 1));
+    submitDraws(vTransparent, DrawList::Transparent, program, instancedProgram, state, bindings);
 
     bgfx::discard(BGFX_DISCARD_ALL);
 }
 
 void ForwardRenderer::onShutdown()
 {
-    bgfx::destroy(program);
-    program = BGFX_INVALID_HANDLE;
+    destroy(program);
+    destroy(instancedProgram);
 }
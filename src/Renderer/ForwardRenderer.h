@@ -5,7 +5,7 @@
 class ForwardRenderer : public Renderer
 {
 public:
-    ForwardRenderer(const Scene* scene);
+    ForwardRenderer(const Scene* scene, ThreadPool* threads);
 
     static bool supported();
 
@@ -14,5 +14,6 @@ public:
     virtual void onShutdown() override;
 
 private:
-    bgfx::ProgramHandle program = BGFX_INVALID_HANDLE;
+    SceneProgram program;
+    SceneProgram instancedProgram;
 };
@@ -0,0 +1,218 @@
+#include "GpuCuller.h"
+
+#include "Renderer/Renderer.h"
+#include "Renderer/Culling.h"
+#include "Renderer/DepthPyramid.h"
+#include "Renderer/Samplers.h"
+#include "Scene/Scene.h"
+#include <bigg.hpp>
+#include <bx/string.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <limits>
+
+// keep in sync with cs_gpu_culling.sc
+static constexpr uint32_t GPU_CULLING_THREADS = 64;
+
+constexpr uint32_t GpuCuller::BATCH_SIZE;
+
+bgfx::VertexLayout GpuCuller::DrawData::layout;
+bgfx::VertexLayout GpuCuller::InstanceData::layout;
+
+bool GpuCuller::supported()
+{
+    const bgfx::Caps* caps = bgfx::getCaps();
+    return (caps->supported & BGFX_CAPS_COMPUTE) != 0 && (caps->supported & BGFX_CAPS_DRAW_INDIRECT) != 0;
+}
+
+void GpuCuller::initialize()
+{
+    DrawData::init();
+    InstanceData::init();
+
+    camPosVecUniform = bgfx::createUniform("u_cullCamPosVec", bgfx::UniformType::Vec4);
+    paramsVecUniform = bgfx::createUniform("u_cullParamsVec", bgfx::UniformType::Vec4);
+    batchVecUniform = bgfx::createUniform("u_cullBatchVec", bgfx::UniformType::Vec4);
+    hizVecUniform = bgfx::createUniform("u_cullHizVec", bgfx::UniformType::Vec4);
+    lodVecUniform = bgfx::createUniform("u_cullLodVec", bgfx::UniformType::Vec4);
+    frustumPlanesUniform = bgfx::createUniform("u_frustumPlanes", bgfx::UniformType::Vec4, Frustum::Count);
+    hizViewProjUniform = bgfx::createUniform("u_hizViewProj", bgfx::UniformType::Mat4);
+    hizSampler = bgfx::createUniform("s_hiz", bgfx::UniformType::Sampler);
+
+    char csName[128];
+    bx::snprintf(csName, BX_COUNTOF(csName), "%s%s", Renderer::shaderDir(), "cs_gpu_culling.bin");
+    cullingProgram = bgfx::createProgram(bigg::loadShader(csName), true);
+}
+
+void GpuCuller::shutdown()
+{
+    bgfx::destroy(cullingProgram);
+    bgfx::destroy(camPosVecUniform);
+    bgfx::destroy(paramsVecUniform);
+    bgfx::destroy(batchVecUniform);
+    bgfx::destroy(hizVecUniform);
+    bgfx::destroy(lodVecUniform);
+    bgfx::destroy(frustumPlanesUniform);
+    bgfx::destroy(hizViewProjUniform);
+    bgfx::destroy(hizSampler);
+    if(bgfx::isValid(drawBuffer))
+        bgfx::destroy(drawBuffer);
+    if(bgfx::isValid(lodBuffer))
+        bgfx::destroy(lodBuffer);
+    if(bgfx::isValid(instanceBuffer))
+        bgfx::destroy(instanceBuffer);
+    for(bgfx::IndirectBufferHandle buffer : indirectBuffers)
+    {
+        bgfx::destroy(buffer);
+    }
+
+    cullingProgram = BGFX_INVALID_HANDLE;
+    camPosVecUniform = paramsVecUniform = batchVecUniform = hizVecUniform = lodVecUniform = BGFX_INVALID_HANDLE;
+    frustumPlanesUniform = hizViewProjUniform = hizSampler = BGFX_INVALID_HANDLE;
+    drawBuffer = BGFX_INVALID_HANDLE;
+    lodBuffer = BGFX_INVALID_HANDLE;
+    instanceBuffer = BGFX_INVALID_HANDLE;
+    indirectBuffers.clear();
+    drawCount = 0;
+}
+
+void GpuCuller::reset(const Scene* scene)
+{
+    if(bgfx::isValid(drawBuffer))
+        bgfx::destroy(drawBuffer);
+    if(bgfx::isValid(lodBuffer))
+        bgfx::destroy(lodBuffer);
+    if(bgfx::isValid(instanceBuffer))
+        bgfx::destroy(instanceBuffer);
+    for(bgfx::IndirectBufferHandle buffer : indirectBuffers)
+    {
+        bgfx::destroy(buffer);
+    }
+    drawBuffer = BGFX_INVALID_HANDLE;
+    lodBuffer = BGFX_INVALID_HANDLE;
+    instanceBuffer = BGFX_INVALID_HANDLE;
+    indirectBuffers.clear();
+
+    drawCount = uint32_t(scene->chunks.size());
+    if(drawCount == 0)
+        return;
+
+    const bgfx::Memory* mem = bgfx::alloc(drawCount * sizeof(DrawData));
+    DrawData* draws = (DrawData*)mem->data;
+    const bgfx::Memory* lodMem = bgfx::alloc(drawCount * MeshChunk::MAX_LODS * 2 * sizeof(uint32_t));
+    uint32_t* lodRanges = (uint32_t*)lodMem->data;
+    const bgfx::Memory* instanceMem = bgfx::alloc(drawCount * sizeof(InstanceData));
+    InstanceData* instances = (InstanceData*)instanceMem->data;
+    for(uint32_t i = 0; i < drawCount; i++)
+    {
+        const MeshChunk& chunk = scene->chunks[i];
+        const glm::vec3 extents = chunk.aabb.extents();
+        DrawData& draw = draws[i];
+
+        draw.centerRadius[0] = chunk.sphere.center.x;
+        draw.centerRadius[1] = chunk.sphere.center.y;
+        draw.centerRadius[2] = chunk.sphere.center.z;
+        draw.centerRadius[3] = chunk.sphere.radius;
+        draw.extentsCutoff[0] = extents.x;
+        draw.extentsCutoff[1] = extents.y;
+        draw.extentsCutoff[2] = extents.z;
+        draw.extentsCutoff[3] = chunk.cone.cutoff;
+        draw.axisMaterial[0] = chunk.cone.axis.x;
+        draw.axisMaterial[1] = chunk.cone.axis.y;
+        draw.axisMaterial[2] = chunk.cone.axis.z;
+        draw.axisMaterial[3] = float(scene->meshes[chunk.mesh].material);
+        instances[i].material[0] = draw.axisMaterial[3];
+        instances[i].material[1] = instances[i].material[2] = instances[i].material[3] = 0.0f;
+        uint32_t* ranges = lodRanges + i * MeshChunk::MAX_LODS * 2;
+        for(uint32_t lod = 0; lod < MeshChunk::MAX_LODS; lod++)
+        {
+            if(lod < chunk.numLods)
+            {
+                ranges[lod * 2 + 0] = scene->meshes[chunk.mesh].firstIndex + chunk.lods[lod].firstIndex;
+                ranges[lod * 2 + 1] = chunk.lods[lod].numIndices;
+                draw.lodErrors[lod] = chunk.lods[lod].error;
+            }
+            else
+            {
+                ranges[lod * 2 + 0] = ranges[lod * 2 + 1] = 0;
+                draw.lodErrors[lod] = std::numeric_limits<float>::infinity();
+            }
+        }
+    }
+
+    drawBuffer = bgfx::createVertexBuffer(mem, DrawData::layout, BGFX_BUFFER_COMPUTE_READ);
+    bgfx::setName(drawBuffer, "GPU culling draw data");
+    // uvec4 in the shader, see ClusterShader
+    lodBuffer = bgfx::createIndexBuffer(lodMem,
+                                        BGFX_BUFFER_COMPUTE_READ | BGFX_BUFFER_INDEX32 |
+                                            BGFX_BUFFER_COMPUTE_FORMAT_32X4 | BGFX_BUFFER_COMPUTE_TYPE_UINT);
+    bgfx::setName(lodBuffer, "GPU culling LOD ranges");
+    instanceBuffer = bgfx::createVertexBuffer(instanceMem, InstanceData::layout);
+    bgfx::setName(instanceBuffer, "GPU culling instance data");
+    for(uint32_t first = 0; first < drawCount; first += BATCH_SIZE)
+    {
+        indirectBuffers.push_back(bgfx::createIndirectBuffer(std::min(drawCount - first, BATCH_SIZE)));
+    }
+}
+
+void GpuCuller::dispatch(bgfx::ViewId view,
+                         const Scene* scene,
+                         const glm::mat4& viewProj,
+                         const DepthPyramid* depthPyramid,
+                         float lodPixelScale,
+                         float lodMaxError) const
+{
+    if(drawCount == 0)
+        return;
+
+    const bgfx::Caps* caps = bgfx::getCaps();
+    const bool hiz = depthPyramid != nullptr && depthPyramid->valid();
+
+    Frustum frustum(viewProj, caps->homogeneousDepth);
+    bgfx::setUniform(frustumPlanesUniform, frustum.planes, Frustum::Count);
+
+    glm::vec4 camPos = glm::vec4(scene->camera.position(), 1.0f);
+    bgfx::setUniform(camPosVecUniform, glm::value_ptr(camPos));
+
+    float paramsVec[4] = { 0.0f,
+                           hiz ? 1.0f : 0.0f,
+                           caps->homogeneousDepth ? 1.0f : 0.0f,
+                           caps->originBottomLeft ? 1.0f : 0.0f };
+    bgfx::setUniform(paramsVecUniform, paramsVec);
+
+    float lodVec[4] = { lodPixelScale, lodMaxError, scene->camera.zNear, 0.0f };
+    bgfx::setUniform(lodVecUniform, lodVec);
+
+    if(hiz)
+    {
+        float hizVec[4] = { (float)depthPyramid->getDepthWidth(),
+                            (float)depthPyramid->getDepthHeight(),
+                            (float)depthPyramid->getLevels(),
+                            0.0f };
+        bgfx::setUniform(hizVecUniform, hizVec);
+        bgfx::setUniform(hizViewProjUniform, glm::value_ptr(depthPyramid->builtViewProj()));
+    }
+
+    // one dispatch per indirect buffer, the draw data is shared
+    for(uint32_t batch = 0; batch < indirectBuffers.size(); batch++)
+    {
+        const uint32_t first = batch * BATCH_SIZE;
+        const uint32_t count = std::min(drawCount - first, BATCH_SIZE);
+        float batchVec[4] = { (float)first, (float)count, 0.0f, 0.0f };
+        bgfx::setUniform(batchVecUniform, batchVec);
+
+        // uniforms keep their value, bindings are discarded after each dispatch
+        if(hiz)
+            bgfx::setTexture(Samplers::GPU_CULLING_HIZ, hizSampler, depthPyramid->texture);
+        bgfx::setBuffer(Samplers::GPU_CULLING_DRAWS, drawBuffer, bgfx::Access::Read);
+        bgfx::setBuffer(Samplers::GPU_CULLING_LODS, lodBuffer, bgfx::Access::Read);
+        bgfx::setBuffer(Samplers::GPU_CULLING_INDIRECT, indirectBuffers[batch], bgfx::Access::Write);
+        bgfx::dispatch(view, cullingProgram, (count + GPU_CULLING_THREADS - 1) / GPU_CULLING_THREADS, 1, 1);
+    }
+}
+
+void GpuCuller::setInstanceData(uint32_t batch) const
+{
+    const uint32_t first = batch * BATCH_SIZE;
+    bgfx::setInstanceDataBuffer(instanceBuffer, first, std::min(drawCount - first, BATCH_SIZE));
+}
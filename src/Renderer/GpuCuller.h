@@ -0,0 +1,102 @@
+#pragma once
+
+#include <bgfx/bgfx.h>
+#include "Scene/Mesh.h"
+#include <glm/matrix.hpp>
+#include <vector>
+
+class Scene;
+class DepthPyramid;
+
+// GPU-driven culling
+// per chunk bounds and index ranges live in a GPU buffer, a compute pass culls them against the frustum,
+// their normal cones and optionally a depth pyramid from a previous frame
+// the result is an indirect buffer with one indexed draw command per chunk, culled chunks have 0 instances
+// the CPU only submits one indirect draw per mesh (or run of meshes with merged buffers and compatible materials),
+// no matter how many chunks it has
+class GpuCuller
+{
+public:
+    static bool supported();
+
+    void initialize();
+    void shutdown();
+
+    // upload the draw data and create one indirect command per scene chunk
+    void reset(const Scene* scene);
+
+    // cull all chunks and write the indirect buffer
+    // dispatches in view, bgfx runs a view's compute calls before its draw calls
+    // depthPyramid can be nullptr, otherwise its last build is used for occlusion culling
+    // lodPixelScale converts object space error / distance to pixels, 0 always draws the full resolution chunks
+    // the shader has no state between frames so there's no LOD hysteresis
+    void dispatch(bgfx::ViewId view,
+                  const Scene* scene,
+                  const glm::mat4& viewProj,
+                  const DepthPyramid* depthPyramid,
+                  float lodPixelScale,
+                  float lodMaxError) const;
+
+    // bgfx takes 16-bit indirect command offsets and counts
+    static constexpr uint32_t BATCH_SIZE = UINT16_MAX;
+
+    // indirect draw commands in scene chunk order, split into buffers of BATCH_SIZE commands
+    // chunk i is command i % BATCH_SIZE in indirectBuffers[i / BATCH_SIZE]
+    // a mesh's chunks are in [mesh.firstChunk, mesh.firstChunk + mesh.numChunks)
+    std::vector<bgfx::IndirectBufferHandle> indirectBuffers;
+
+    // binds the instance data of an indirect buffer's commands, i_data0.x = material index
+    // commands start at their own instance so draws of different materials can share a submit
+    void setInstanceData(uint32_t batch) const;
+
+private:
+    // keep in sync with cs_gpu_culling.sc
+    struct DrawData
+    {
+        float centerRadius[4];
+        float extentsCutoff[4];
+        float axisMaterial[4];
+        // missing levels have an infinite error
+        float lodErrors[MeshChunk::MAX_LODS];
+
+        static void init()
+        {
+            layout.begin()
+                .add(bgfx::Attrib::TexCoord0, 4, bgfx::AttribType::Float)
+                .add(bgfx::Attrib::TexCoord1, 4, bgfx::AttribType::Float)
+                .add(bgfx::Attrib::TexCoord2, 4, bgfx::AttribType::Float)
+                .add(bgfx::Attrib::TexCoord3, 4, bgfx::AttribType::Float)
+                .end();
+        }
+        static bgfx::VertexLayout layout;
+    };
+
+    struct InstanceData
+    {
+        float material[4];
+
+        static void init()
+        {
+            layout.begin().add(bgfx::Attrib::TexCoord7, 4, bgfx::AttribType::Float).end();
+        }
+        static bgfx::VertexLayout layout;
+    };
+
+    uint32_t drawCount = 0;
+    bgfx::VertexBufferHandle drawBuffer = BGFX_INVALID_HANDLE;
+    // first index, number of indices for each LOD of each draw
+    // uint buffer, merged index buffers can exceed float precision
+    bgfx::IndexBufferHandle lodBuffer = BGFX_INVALID_HANDLE;
+    // one entry per chunk
+    bgfx::VertexBufferHandle instanceBuffer = BGFX_INVALID_HANDLE;
+
+    bgfx::ProgramHandle cullingProgram = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle camPosVecUniform = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle paramsVecUniform = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle batchVecUniform = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle hizVecUniform = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle lodVecUniform = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle frustumPlanesUniform = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle hizViewProjUniform = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle hizSampler = BGFX_INVALID_HANDLE;
+};
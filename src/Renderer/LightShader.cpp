@@ -19,17 +19,19 @@ void LightShader::shutdown()
     lightCountVecUniform = ambientLightIrradianceUniform = BGFX_INVALID_HANDLE;
 }
 
-void LightShader::bindLights(const Scene* scene) const
+void LightShader::bindLights(const Scene* scene, bgfx::Encoder* encoder) const
 {
     assert(scene != nullptr);
+    if(!encoder)
+        encoder = bgfx::begin();
 
     // a 32-bit IEEE 754 float can represent all integers up to 2^24 (~16.7 million) correctly
     // should be enough for this use case (comparison in for loop)
     float lightCountVec[4] = { (float)scene->pointLights.lights.size() };
-    bgfx::setUniform(lightCountVecUniform, lightCountVec);
+    encoder->setUniform(lightCountVecUniform, lightCountVec);
 
     glm::vec4 ambientLightIrradiance(scene->ambientLight.irradiance, 1.0f);
-    bgfx::setUniform(ambientLightIrradianceUniform, glm::value_ptr(ambientLightIrradiance));
+    encoder->setUniform(ambientLightIrradianceUniform, glm::value_ptr(ambientLightIrradiance));
 
-    bgfx::setBuffer(Samplers::LIGHTS_POINTLIGHTS, scene->pointLights.buffer, bgfx::Access::Read);
+    encoder->setBuffer(Samplers::LIGHTS_POINTLIGHTS, scene->pointLights.buffer, bgfx::Access::Read);
 }
@@ -10,7 +10,8 @@ public:
     void initialize();
     void shutdown();
 
-    void bindLights(const Scene* scene) const;
+    // encoder = nullptr binds on the main thread's encoder
+    void bindLights(const Scene* scene, bgfx::Encoder* encoder = nullptr) const;
 
 private:
     bgfx::UniformHandle lightCountVecUniform = BGFX_INVALID_HANDLE;
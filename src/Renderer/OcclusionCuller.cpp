@@ -0,0 +1,193 @@
+#include "OcclusionCuller.h"
+
+#include "Renderer/Renderer.h"
+#include "Scene/Scene.h"
+#include <bigg.hpp>
+#include <bx/string.h>
+#include <glm/common.hpp>
+#include <glm/vector_relational.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+
+constexpr uint32_t OcclusionCuller::MAX_QUERIES;
+constexpr uint32_t OcclusionCuller::NO_SLOT;
+
+bool OcclusionCuller::supported()
+{
+    return (bgfx::getCaps()->supported & BGFX_CAPS_OCCLUSION_QUERY) != 0;
+}
+
+void OcclusionCuller::initialize()
+{
+    layout.begin().add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float).end();
+
+    // unit cube, scaled to the chunk bounds
+    constexpr float LEFT = -1.0f, RIGHT = 1.0f, BOTTOM = -1.0f, TOP = 1.0f, FRONT = -1.0f, BACK = 1.0f;
+    const float vertices[8][3] = {
+        { LEFT, BOTTOM, FRONT }, { RIGHT, BOTTOM, FRONT }, { LEFT, TOP, FRONT }, { RIGHT, TOP, FRONT },
+        { LEFT, BOTTOM, BACK },  { RIGHT, BOTTOM, BACK },  { LEFT, TOP, BACK },  { RIGHT, TOP, BACK },
+    };
+    const uint16_t indices[6 * 6] = {
+        // CCW
+        0, 1, 3, 3, 2, 0, // front
+        5, 4, 6, 6, 7, 5, // back
+        4, 0, 2, 2, 6, 4, // left
+        1, 5, 7, 7, 3, 1, // right
+        2, 3, 7, 7, 6, 2, // top
+        4, 5, 1, 1, 0, 4  // bottom
+    };
+
+    boxVertexBuffer = bgfx::createVertexBuffer(bgfx::copy(&vertices, sizeof(vertices)), layout);
+    boxIndexBuffer = bgfx::createIndexBuffer(bgfx::copy(&indices, sizeof(indices)));
+
+    char vsName[128], fsName[128];
+    bx::snprintf(vsName, BX_COUNTOF(vsName), "%s%s", Renderer::shaderDir(), "vs_occlusion.bin");
+    bx::snprintf(fsName, BX_COUNTOF(fsName), "%s%s", Renderer::shaderDir(), "fs_occlusion.bin");
+    program = bigg::loadProgram(vsName, fsName);
+
+    // bgfx can run out before MAX_QUERIES
+    for(uint32_t i = 0; i < MAX_QUERIES; i++)
+    {
+        bgfx::OcclusionQueryHandle handle = bgfx::createOcclusionQuery();
+        if(!bgfx::isValid(handle))
+            break;
+        pool.push_back(handle);
+    }
+    for(uint32_t slot = uint32_t(pool.size()); slot > 0; slot--)
+    {
+        freeSlots.push_back(slot - 1);
+    }
+}
+
+void OcclusionCuller::shutdown()
+{
+    reset(nullptr);
+    for(bgfx::OcclusionQueryHandle handle : pool)
+    {
+        bgfx::destroy(handle);
+    }
+    pool.clear();
+    freeSlots.clear();
+
+    bgfx::destroy(program);
+    bgfx::destroy(boxVertexBuffer);
+    bgfx::destroy(boxIndexBuffer);
+
+    program = BGFX_INVALID_HANDLE;
+    boxVertexBuffer = BGFX_INVALID_HANDLE;
+    boxIndexBuffer = BGFX_INVALID_HANDLE;
+}
+
+void OcclusionCuller::reset(const Scene* scene)
+{
+    // rebuilds while the scene is loading keep the query results
+    const size_t chunks = scene ? scene->chunks.size() : 0;
+    if(chunks == queries.size())
+        return;
+
+    // chunk indices might refer to different chunks now
+    for(Query& query : queries)
+    {
+        release(query);
+    }
+    queries.assign(chunks, Query());
+    pending.clear();
+    nextWaiting = 0;
+}
+
+uint32_t OcclusionCuller::cull(const Scene* scene, const glm::vec3& camPos, uint8_t* visibility)
+{
+    frame++;
+    pending.clear();
+    waiting.clear();
+
+    // a chunk outside the frustum can't be queried, its slot might return an old result once it's back
+    for(uint32_t i = 0; i < queries.size(); i++)
+    {
+        if(!visibility[i])
+            release(queries[i]);
+        else if(queries[i].slot == NO_SLOT)
+            waiting.push_back(i);
+    }
+    // visible chunks are drawn anyway and give up their slot first
+    size_t handOver = waiting.size() > freeSlots.size() ? waiting.size() - freeSlots.size() : 0;
+
+    uint32_t culled = 0;
+    const glm::vec3 margin = glm::vec3(scene->camera.zNear);
+    for(uint32_t i = 0; i < queries.size(); i++)
+    {
+        Query& query = queries[i];
+        if(query.slot == NO_SLOT)
+            continue;
+
+        // results arrive with a few frames of latency
+        if(frame - query.since < RESULT_LATENCY)
+        {
+            pending.push_back(i);
+            continue;
+        }
+
+        // the box is clipped by the near plane if the camera is inside
+        const MeshChunk& chunk = scene->chunks[i];
+        const bool inside = glm::all(glm::greaterThanEqual(camPos, chunk.aabb.min - margin)) &&
+                            glm::all(glm::lessThanEqual(camPos, chunk.aabb.max + margin));
+
+        if(!inside && bgfx::getResult(pool[query.slot]) == bgfx::OcclusionQueryResult::Invisible)
+        {
+            visibility[i] = 0;
+            culled++;
+            pending.push_back(i);
+        }
+        else if(handOver > 0)
+        {
+            release(query);
+            handOver--;
+        }
+        else
+            pending.push_back(i);
+    }
+
+    // start after the last chunk that got a slot so every chunk gets a turn when there are too few
+    auto first = std::lower_bound(waiting.begin(), waiting.end(), nextWaiting);
+    std::rotate(waiting.begin(), first, waiting.end());
+    for(size_t w = 0; w < waiting.size() && !freeSlots.empty(); w++)
+    {
+        Query& query = queries[waiting[w]];
+        query.slot = freeSlots.back();
+        query.since = frame;
+        freeSlots.pop_back();
+        pending.push_back(waiting[w]);
+        nextWaiting = waiting[w] + 1;
+    }
+
+    return culled;
+}
+
+void OcclusionCuller::submitQueries(bgfx::ViewId view, const Scene* scene)
+{
+    // grow the boxes a little so surfaces lying exactly on a box face don't fail the depth test
+    const float margin = scene->diagonal * 0.001f;
+
+    for(uint32_t i : pending)
+    {
+        const MeshChunk& chunk = scene->chunks[i];
+        glm::mat4 translate = glm::translate(glm::identity<glm::mat4>(), chunk.aabb.center());
+        glm::mat4 scale = glm::scale(glm::identity<glm::mat4>(), chunk.aabb.extents() + margin);
+        glm::mat4 model = translate * scale;
+        bgfx::setTransform(glm::value_ptr(model));
+        bgfx::setVertexBuffer(0, boxVertexBuffer);
+        bgfx::setIndexBuffer(boxIndexBuffer);
+        // depth test only, render both sides
+        bgfx::setState(BGFX_STATE_DEPTH_TEST_LEQUAL);
+        // keep bindings for the draws following the queries
+        bgfx::submit(view, program, pool[queries[i].slot], 0, ~BGFX_DISCARD_BINDINGS);
+    }
+}
+
+void OcclusionCuller::release(Query& query)
+{
+    if(query.slot != NO_SLOT)
+        freeSlots.push_back(query.slot);
+    query.slot = NO_SLOT;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <bgfx/bgfx.h>
+#include <glm/vec3.hpp>
+#include <vector>
+
+class Scene;
+
+// temporal occlusion culling with hardware occlusion queries
+// the bounding boxes of all chunks inside the view frustum are rendered as queries against the depth buffer
+// chunks whose query returned no visible samples in the previous frame are skipped,
+// their boxes are still rendered every frame so they show up again once they are uncovered
+// queries come from a fixed pool, chunks inside the view frustum get one while they stay inside
+// hidden chunks keep theirs, visible chunks hand theirs over to chunks waiting for one
+class OcclusionCuller
+{
+public:
+    static bool supported();
+
+    void initialize();
+    void shutdown();
+
+    // resize the per chunk state if the scene's chunk count changed, this drops all query results
+    void reset(const Scene* scene);
+
+    // remove chunks that were hidden last frame
+    // visibility must contain the frustum culling results, also decides which chunks get queried this frame
+    // returns the number of culled chunks
+    uint32_t cull(const Scene* scene, const glm::vec3& camPos, uint8_t* visibility);
+
+    // render the queried bounding boxes
+    // call this after the opaque geometry has been submitted to the same view
+    void submitQueries(bgfx::ViewId view, const Scene* scene);
+
+private:
+    struct Query
+    {
+        uint32_t slot = NO_SLOT; // index into pool
+        uint32_t since = 0;      // frame the chunk got its slot
+    };
+
+    // frames until a query result can be trusted
+    static constexpr uint32_t RESULT_LATENCY = 2;
+    // keep in sync with BGFX_CONFIG_MAX_OCCLUSION_QUERIES in 3rdparty/CMakeLists.txt
+    static constexpr uint32_t MAX_QUERIES = 1024;
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+    void release(Query& query);
+
+    std::vector<bgfx::OcclusionQueryHandle> pool;
+    std::vector<uint32_t> freeSlots; // unused indices into pool
+    std::vector<Query> queries;      // per chunk
+    std::vector<uint32_t> pending;   // chunk indices to query this frame
+    std::vector<uint32_t> waiting;   // chunk indices inside the frustum without a slot
+    uint32_t nextWaiting = 0;        // first chunk to get a slot, rotates so every chunk gets a turn
+    uint32_t frame = 0;
+
+    bgfx::VertexLayout layout;
+    bgfx::VertexBufferHandle boxVertexBuffer = BGFX_INVALID_HANDLE;
+    bgfx::IndexBufferHandle boxIndexBuffer = BGFX_INVALID_HANDLE;
+    bgfx::ProgramHandle program = BGFX_INVALID_HANDLE;
+};
@@ -9,13 +9,13 @@
 #include <bx/file.h>
 #include <glm/gtc/type_ptr.hpp>
 
+bgfx::VertexLayout PBRShader::MaterialData::layout;
+
 void PBRShader::initialize()
 {
-    baseColorFactorUniform = bgfx::createUniform("u_baseColorFactor", bgfx::UniformType::Vec4);
-    metallicRoughnessNormalOcclusionFactorUniform =
-        bgfx::createUniform("u_metallicRoughnessNormalOcclusionFactor", bgfx::UniformType::Vec4);
-    emissiveFactorUniform = bgfx::createUniform("u_emissiveFactorVec", bgfx::UniformType::Vec4);
-    hasTexturesUniform = bgfx::createUniform("u_hasTextures", bgfx::UniformType::Vec4);
+    MaterialData::init();
+
+    materialIndexVecUniform = bgfx::createUniform("u_materialIndexVec", bgfx::UniformType::Vec4);
     multipleScatteringUniform = bgfx::createUniform("u_multipleScatteringVec", bgfx::UniformType::Vec4);
     albedoLUTSampler = bgfx::createUniform("s_texAlbedoLUT", bgfx::UniformType::Sampler);
     baseColorSampler = bgfx::createUniform("s_texBaseColor", bgfx::UniformType::Sampler);
@@ -25,6 +25,9 @@ void PBRShader::initialize()
     emissiveSampler = bgfx::createUniform("s_texEmissive", bgfx::UniformType::Sampler);
 
     defaultTexture = bgfx::createTexture2D(1, 1, false, 1, bgfx::TextureFormat::RGBA8);
+    // bgfx only creates an array texture for more than one layer
+    if(bgfx::getCaps()->supported & BGFX_CAPS_TEXTURE_2D_ARRAY)
+        defaultArrayTexture = bgfx::createTexture2D(1, 1, false, 2, bgfx::TextureFormat::RGBA8);
     albedoLUTTexture = bgfx::createTexture2D(ALBEDO_LUT_SIZE,
                                              ALBEDO_LUT_SIZE,
                                              false,
@@ -39,10 +42,7 @@ void PBRShader::initialize()
 
 void PBRShader::shutdown()
 {
-    bgfx::destroy(baseColorFactorUniform);
-    bgfx::destroy(metallicRoughnessNormalOcclusionFactorUniform);
-    bgfx::destroy(emissiveFactorUniform);
-    bgfx::destroy(hasTexturesUniform);
+    bgfx::destroy(materialIndexVecUniform);
     bgfx::destroy(multipleScatteringUniform);
     bgfx::destroy(albedoLUTSampler);
     bgfx::destroy(baseColorSampler);
@@ -52,12 +52,16 @@ void PBRShader::shutdown()
     bgfx::destroy(emissiveSampler);
     bgfx::destroy(albedoLUTTexture);
     bgfx::destroy(defaultTexture);
+    if(bgfx::isValid(defaultArrayTexture))
+        bgfx::destroy(defaultArrayTexture);
     bgfx::destroy(albedoLUTProgram);
+    if(bgfx::isValid(materialBuffer))
+        bgfx::destroy(materialBuffer);
 
-    baseColorFactorUniform = metallicRoughnessNormalOcclusionFactorUniform = emissiveFactorUniform =
-        hasTexturesUniform = multipleScatteringUniform = albedoLUTSampler = baseColorSampler =
-            metallicRoughnessSampler = normalSampler = occlusionSampler = emissiveSampler = BGFX_INVALID_HANDLE;
-    albedoLUTTexture = defaultTexture = BGFX_INVALID_HANDLE;
+    materialIndexVecUniform = multipleScatteringUniform = albedoLUTSampler = baseColorSampler =
+        metallicRoughnessSampler = normalSampler = occlusionSampler = emissiveSampler = BGFX_INVALID_HANDLE;
+    materialBuffer = BGFX_INVALID_HANDLE;
+    albedoLUTTexture = defaultTexture = defaultArrayTexture = BGFX_INVALID_HANDLE;
     albedoLUTProgram = BGFX_INVALID_HANDLE;
 }
 
@@ -67,41 +71,135 @@ void PBRShader::generateAlbedoLUT()
     bgfx::dispatch(0, albedoLUTProgram, ALBEDO_LUT_SIZE / ALBEDO_LUT_THREADS, ALBEDO_LUT_SIZE / ALBEDO_LUT_THREADS, 1);
 }
 
-uint64_t PBRShader::bindMaterial(const Material& material)
+void PBRShader::uploadMaterials(const std::vector<Material>& materials)
 {
-    float factorValues[4] = {
-        material.metallicFactor, material.roughnessFactor, material.normalScale, material.occlusionStrength
-    };
-    bgfx::setUniform(baseColorFactorUniform, glm::value_ptr(material.baseColorFactor));
-    bgfx::setUniform(metallicRoughnessNormalOcclusionFactorUniform, factorValues);
-    glm::vec4 emissiveFactor = glm::vec4(material.emissiveFactor, 0.0f);
-    bgfx::setUniform(emissiveFactorUniform, glm::value_ptr(emissiveFactor));
-
-    float hasTexturesValues[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
-
-    auto setTextureOrDefault = [&](uint8_t stage, bgfx::UniformHandle uniform, bgfx::TextureHandle texture) -> bool {
-        bool valid = bgfx::isValid(texture);
-        if(!valid)
-            texture = defaultTexture;
-        bgfx::setTexture(stage, uniform, texture);
-        return valid;
+    if(bgfx::isValid(materialBuffer))
+        bgfx::destroy(materialBuffer);
+    materialBuffer = BGFX_INVALID_HANDLE;
+    if(materials.empty())
+        return;
+
+    const bgfx::Memory* mem = bgfx::alloc(uint32_t(materials.size() * sizeof(MaterialData)));
+    MaterialData* data = (MaterialData*)mem->data;
+    for(size_t m = 0; m < materials.size(); m++)
+    {
+        const Material& material = materials[m];
+        MaterialData& entry = data[m];
+
+        for(int i = 0; i < 4; i++)
+        {
+            entry.baseColorFactor[i] = material.baseColorFactor[i];
+        }
+        entry.metallicRoughnessNormalOcclusionFactor[0] = material.metallicFactor;
+        entry.metallicRoughnessNormalOcclusionFactor[1] = material.roughnessFactor;
+        entry.metallicRoughnessNormalOcclusionFactor[2] = material.normalScale;
+        entry.metallicRoughnessNormalOcclusionFactor[3] = material.occlusionStrength;
+        entry.emissiveFactor[0] = material.emissiveFactor.x;
+        entry.emissiveFactor[1] = material.emissiveFactor.y;
+        entry.emissiveFactor[2] = material.emissiveFactor.z;
+        entry.emissiveFactor[3] = material.emissiveLayer;
+        entry.textureLayers[0] = material.baseColorLayer;
+        entry.textureLayers[1] = material.metallicRoughnessLayer;
+        entry.textureLayers[2] = material.normalLayer;
+        entry.textureLayers[3] = material.occlusionLayer;
+
+        // same order as the samplers in bindMaterial
+        const bgfx::TextureHandle textures[] = { material.baseColorTexture,
+                                                 material.metallicRoughnessTexture,
+                                                 material.normalTexture,
+                                                 material.occlusionTexture,
+                                                 material.emissiveTexture };
+        uint32_t hasTexturesMask = 0;
+        for(uint32_t i = 0; i < BX_COUNTOF(textures); i++)
+        {
+            hasTexturesMask |= (bgfx::isValid(textures[i]) ? 1 : 0) << i;
+        }
+        entry.hasTextures[0] = static_cast<float>(hasTexturesMask);
+        entry.hasTextures[1] = entry.hasTextures[2] = entry.hasTextures[3] = 0.0f;
+    }
+
+    materialBuffer = bgfx::createVertexBuffer(mem, MaterialData::layout, BGFX_BUFFER_COMPUTE_READ);
+    bgfx::setName(materialBuffer, "Material table");
+}
+
+PBRShader::MaterialBinding PBRShader::bakeMaterial(const Material& material, uint32_t index) const
+{
+    MaterialBinding binding;
+
+    // a 32-bit float represents all integers up to 2^24 exactly
+    binding.index[0] = float(index);
+    binding.index[1] = binding.index[2] = binding.index[3] = 0.0f;
+
+    // same order as the samplers in bindMaterial
+    const bgfx::TextureHandle textures[] = { material.baseColorTexture,
+                                             material.metallicRoughnessTexture,
+                                             material.normalTexture,
+                                             material.occlusionTexture,
+                                             material.emissiveTexture };
+    const bgfx::TextureHandle fallback = material.textureArrays ? defaultArrayTexture : defaultTexture;
+    for(uint32_t i = 0; i < BX_COUNTOF(textures); i++)
+    {
+        binding.textures[i] = bgfx::isValid(textures[i]) ? textures[i] : fallback;
+    }
+
+    binding.state = materialState(material);
+    binding.textureArrays = material.textureArrays;
+    return binding;
+}
+
+uint64_t PBRShader::bindMaterial(const MaterialBinding& binding, bgfx::Encoder* encoder, BindingCache* cache)
+{
+    if(!encoder)
+        encoder = bgfx::begin();
+
+    encoder->setUniform(materialIndexVecUniform, binding.index);
+
+    // same order as the textures in MaterialBinding
+    const uint8_t stages[] = { Samplers::PBR_BASECOLOR,
+                               Samplers::PBR_METALROUGHNESS,
+                               Samplers::PBR_NORMAL,
+                               Samplers::PBR_OCCLUSION,
+                               Samplers::PBR_EMISSIVE };
+    const bgfx::UniformHandle samplers[] = {
+        baseColorSampler, metallicRoughnessSampler, normalSampler, occlusionSampler, emissiveSampler
     };
+    for(uint32_t i = 0; i < BX_COUNTOF(stages); i++)
+    {
+        // many materials share textures (default texture, packed occlusion/metallic/roughness)
+        if(cache)
+        {
+            if(cache->textures[i].idx == binding.textures[i].idx)
+                continue;
+            cache->textures[i] = binding.textures[i];
+        }
+        encoder->setTexture(stages[i], samplers[i], binding.textures[i]);
+    }
 
-    const uint32_t hasTexturesMask = 0
-        | ((setTextureOrDefault(Samplers::PBR_BASECOLOR, baseColorSampler, material.baseColorTexture) ? 1 : 0) << 0)
-        | ((setTextureOrDefault(Samplers::PBR_METALROUGHNESS, metallicRoughnessSampler, material.metallicRoughnessTexture) ? 1 : 0) << 1)
-        | ((setTextureOrDefault(Samplers::PBR_NORMAL, normalSampler, material.normalTexture) ? 1 : 0) << 2)
-        | ((setTextureOrDefault(Samplers::PBR_OCCLUSION, occlusionSampler, material.occlusionTexture) ? 1 : 0) << 3)
-        | ((setTextureOrDefault(Samplers::PBR_EMISSIVE, emissiveSampler, material.emissiveTexture) ? 1 : 0) << 4);
-    hasTexturesValues[0] = static_cast<float>(hasTexturesMask);
+    return binding.state;
+}
 
-    bgfx::setUniform(hasTexturesUniform, hasTexturesValues);
+void PBRShader::bindMaterialTable(bgfx::Encoder* encoder)
+{
+    if(!encoder)
+        encoder = bgfx::begin();
+
+    if(bgfx::isValid(materialBuffer))
+        encoder->setBuffer(Samplers::PBR_MATERIALS, materialBuffer, bgfx::Access::Read);
+}
+
+void PBRShader::bindMultipleScattering(bgfx::Encoder* encoder)
+{
+    if(!encoder)
+        encoder = bgfx::begin();
 
     float multipleScatteringValues[4] = {
         multipleScatteringEnabled ? 1.0f : 0.0f, whiteFurnaceEnabled ? WHITE_FURNACE_RADIANCE : 0.0f, 0.0f, 0.0f
     };
-    bgfx::setUniform(multipleScatteringUniform, multipleScatteringValues);
+    encoder->setUniform(multipleScatteringUniform, multipleScatteringValues);
+}
 
+uint64_t PBRShader::materialState(const Material& material)
+{
     uint64_t state = 0;
     if(material.blend)
         state |= BGFX_STATE_BLEND_ALPHA;
@@ -110,10 +208,13 @@ uint64_t PBRShader::bindMaterial(const Material& material)
     return state;
 }
 
-void PBRShader::bindAlbedoLUT(bool compute)
+void PBRShader::bindAlbedoLUT(bool compute, bgfx::Encoder* encoder)
 {
+    if(!encoder)
+        encoder = bgfx::begin();
+
     if(compute)
-        bgfx::setImage(Samplers::PBR_ALBEDO_LUT, albedoLUTTexture, 0, bgfx::Access::Write);
+        encoder->setImage(Samplers::PBR_ALBEDO_LUT, albedoLUTTexture, 0, bgfx::Access::Write);
     else
-        bgfx::setTexture(Samplers::PBR_ALBEDO_LUT, albedoLUTSampler, albedoLUTTexture);
+        encoder->setTexture(Samplers::PBR_ALBEDO_LUT, albedoLUTSampler, albedoLUTTexture);
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <bgfx/bgfx.h>
+#include <vector>
 
 struct Material;
 
@@ -12,8 +13,43 @@ public:
 
     void generateAlbedoLUT();
 
-    uint64_t bindMaterial(const Material& material);
-    void bindAlbedoLUT(bool compute = false);
+    // material factors of all materials in one GPU buffer, uploaded once after loading
+    // draws only set the index into it
+    void uploadMaterials(const std::vector<Material>& materials);
+
+    // material index, textures and state resolved once after loading
+    struct MaterialBinding
+    {
+        float index[4];                  // x = index into the material table
+        bgfx::TextureHandle textures[5]; // default texture if the material has none
+        uint64_t state;                  // materialState
+        bool textureArrays;              // Material::textureArrays, draw with the texture array program variant
+    };
+
+    // index is the material's position in the vector passed to uploadMaterials
+    // missing textures of materials with texture arrays use a default texture array so the program's samplers match
+    MaterialBinding bakeMaterial(const Material& material, uint32_t index) const;
+
+    // textures bound on an encoder, lets bindMaterial skip unchanged samplers
+    // only valid as long as the encoder's bindings aren't discarded
+    struct BindingCache
+    {
+        bgfx::TextureHandle textures[5] = {
+            BGFX_INVALID_HANDLE, BGFX_INVALID_HANDLE, BGFX_INVALID_HANDLE, BGFX_INVALID_HANDLE, BGFX_INVALID_HANDLE
+        };
+    };
+
+    // only sets the material index and textures, call bindMaterialTable and bindMultipleScattering once per pass
+    // encoder = nullptr binds on the main thread's encoder
+    uint64_t bindMaterial(const MaterialBinding& binding,
+                          bgfx::Encoder* encoder = nullptr,
+                          BindingCache* cache = nullptr);
+    void bindMaterialTable(bgfx::Encoder* encoder = nullptr);
+    void bindMultipleScattering(bgfx::Encoder* encoder = nullptr);
+    void bindAlbedoLUT(bool compute = false, bgfx::Encoder* encoder = nullptr);
+
+    // render state bits required by a material (blending, culling)
+    static uint64_t materialState(const Material& material);
 
     static constexpr float WHITE_FURNACE_RADIANCE = 1.0f;
 
@@ -24,10 +60,31 @@ private:
     static constexpr uint16_t ALBEDO_LUT_SIZE = 32;
     static constexpr uint16_t ALBEDO_LUT_THREADS = 32;
 
-    bgfx::UniformHandle baseColorFactorUniform = BGFX_INVALID_HANDLE;
-    bgfx::UniformHandle metallicRoughnessNormalOcclusionFactorUniform = BGFX_INVALID_HANDLE;
-    bgfx::UniformHandle emissiveFactorUniform = BGFX_INVALID_HANDLE;
-    bgfx::UniformHandle hasTexturesUniform = BGFX_INVALID_HANDLE;
+    // keep in sync with pbr.sh
+    struct MaterialData
+    {
+        float baseColorFactor[4];
+        float metallicRoughnessNormalOcclusionFactor[4];
+        float emissiveFactor[4]; // w = emissive texture layer
+        float hasTextures[4];    // x = bit mask in sampler order
+        float textureLayers[4];  // base color, metallic/roughness, normal, occlusion texture layer
+
+        static void init()
+        {
+            layout.begin()
+                .add(bgfx::Attrib::TexCoord0, 4, bgfx::AttribType::Float)
+                .add(bgfx::Attrib::TexCoord1, 4, bgfx::AttribType::Float)
+                .add(bgfx::Attrib::TexCoord2, 4, bgfx::AttribType::Float)
+                .add(bgfx::Attrib::TexCoord3, 4, bgfx::AttribType::Float)
+                .add(bgfx::Attrib::TexCoord4, 4, bgfx::AttribType::Float)
+                .end();
+        }
+        static bgfx::VertexLayout layout;
+    };
+
+    bgfx::VertexBufferHandle materialBuffer = BGFX_INVALID_HANDLE;
+
+    bgfx::UniformHandle materialIndexVecUniform = BGFX_INVALID_HANDLE;
     bgfx::UniformHandle multipleScatteringUniform = BGFX_INVALID_HANDLE;
     bgfx::UniformHandle albedoLUTSampler = BGFX_INVALID_HANDLE;
     bgfx::UniformHandle baseColorSampler = BGFX_INVALID_HANDLE;
@@ -38,6 +95,7 @@ private:
 
     bgfx::TextureHandle albedoLUTTexture = BGFX_INVALID_HANDLE;
     bgfx::TextureHandle defaultTexture = BGFX_INVALID_HANDLE;
+    bgfx::TextureHandle defaultArrayTexture = BGFX_INVALID_HANDLE;
 
     bgfx::ProgramHandle albedoLUTProgram = BGFX_INVALID_HANDLE;
 };
@@ -1,20 +1,26 @@
 #include "Renderer.h"
 
+#include "Renderer/Culling.h"
 #include "Scene/Scene.h"
+#include "Util/ThreadPool.h"
 #include <bigg.hpp>
 #include <bx/macros.h>
 #include <bx/string.h>
 #include <bx/math.h>
+#include <bx/timer.h>
 #include <glm/common.hpp>
 #include <glm/gtx/component_wise.hpp>
 #include <glm/gtc/color_space.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/trigonometric.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/matrix_operation.hpp>
+#include <algorithm>
+#include <limits>
 
 bgfx::VertexLayout Renderer::PosVertex::layout;
 
-Renderer::Renderer(const Scene* scene) : scene(scene) { }
+Renderer::Renderer(const Scene* scene, ThreadPool* threads) : scene(scene), threads(threads) { }
 
 void Renderer::initialize()
 {
@@ -23,6 +29,8 @@ void Renderer::initialize()
     blitSampler = bgfx::createUniform("s_texColor", bgfx::UniformType::Sampler);
     camPosUniform = bgfx::createUniform("u_camPos", bgfx::UniformType::Vec4);
     normalMatrixUniform = bgfx::createUniform("u_normalMatrix", bgfx::UniformType::Mat3);
+    positionScaleVecUniform = bgfx::createUniform("u_positionScaleVec", bgfx::UniformType::Vec4);
+    positionOffsetVecUniform = bgfx::createUniform("u_positionOffsetVec", bgfx::UniformType::Vec4);
     exposureVecUniform = bgfx::createUniform("u_exposureVec", bgfx::UniformType::Vec4);
     tonemappingModeVecUniform = bgfx::createUniform("u_tonemappingModeVec", bgfx::UniformType::Vec4);
 
@@ -40,6 +48,18 @@ void Renderer::initialize()
     pbr.generateAlbedoLUT();
     lights.initialize();
 
+    occlusionSupported = OcclusionCuller::supported();
+    if(occlusionSupported)
+        occlusion.initialize();
+    depthPyramidSupported = DepthPyramid::supported();
+    if(depthPyramidSupported)
+        depthPyramid.initialize();
+    gpuCullingSupported = GpuCuller::supported();
+    if(gpuCullingSupported)
+        gpuCuller.initialize();
+    // encoder 0 belongs to the main thread and can't be used by workers
+    multithreadedSubmissionSupported = threads && threads->size() > 1 && bgfx::getCaps()->limits.maxEncoders > 1;
+
     onInitialize();
 
     // finish any queued precomputations before rendering the scene
@@ -53,6 +73,13 @@ void Renderer::reset(uint16_t width, uint16_t height)
         frameBuffer = createFrameBuffer(true, true);
         bgfx::setName(frameBuffer, "Render framebuffer (pre-postprocessing)");
     }
+    if(width != this->width || height != this->height)
+    {
+        // the first reset happens before initialize so we can't rely on depthPyramidSupported
+        if(DepthPyramid::supported())
+            depthPyramid.reset(width, height);
+        softwareOcclusion.reset(width, height);
+    }
     this->width = width;
     this->height = height;
 
@@ -73,9 +100,47 @@ void Renderer::render(float dt)
                                : glm::convertSRGBToLinear(scene->skyColor); // tonemapping expects linear colors
         glm::u8vec3 result = glm::u8vec3(glm::round(glm::clamp(linear, 0.0f, 1.0f) * 255.0f));
         clearColor = (result[0] << 24) | (result[1] << 16) | (result[2] << 8) | 255;
+
+        // the scene only changes while it's loading, otherwise only depth changes between frames
+        // a rebuild touches the whole scene, while meshes stream in wait until their number grew by a quarter
+        // to keep the total cost linear instead of rebuilding every frame
+        const size_t meshes = scene->meshes.size();
+        const bool geometryChanged =
+            builtGeometryRevision != scene->geometryRevision &&
+            (!scene->loadingGeometry() || meshes < builtMeshes || meshes - builtMeshes >= builtMeshes / 4 + 1);
+        if(!drawList.built() || geometryChanged)
+        {
+            drawList.build(scene);
+            bakeBindings();
+            if(occlusionSupported)
+                occlusion.reset(scene);
+            if(gpuCullingSupported)
+                gpuCuller.reset(scene);
+            builtGeometryRevision = scene->geometryRevision;
+            builtMaterialRevision = scene->materialRevision;
+            builtMeshes = meshes;
+        }
+        else if(builtMaterialRevision != scene->materialRevision)
+        {
+            // textures got swapped in
+            bakeBindings();
+            builtMaterialRevision = scene->materialRevision;
+        }
+        drawList.sort(scene->camera);
+
+        updateMatrices();
+        cull();
+        selectLods();
+        trackTextureDemand();
+        submitStats = SubmitStats();
     }
     else
+    {
         clearColor = 0x303030FF; // gray
+        cullingStats = CullingStats();
+        submitStats = SubmitStats();
+        textureDemand.clear();
+    }
 
     onRender(dt);
     blitToScreen(MAX_VIEW);
@@ -91,10 +156,20 @@ void Renderer::shutdown()
     pbr.shutdown();
     lights.shutdown();
 
+    drawList.clear();
+    if(occlusionSupported)
+        occlusion.shutdown();
+    if(depthPyramidSupported)
+        depthPyramid.shutdown();
+    if(gpuCullingSupported)
+        gpuCuller.shutdown();
+
     bgfx::destroy(blitProgram);
     bgfx::destroy(blitSampler);
     bgfx::destroy(camPosUniform);
     bgfx::destroy(normalMatrixUniform);
+    bgfx::destroy(positionScaleVecUniform);
+    bgfx::destroy(positionOffsetVecUniform);
     bgfx::destroy(exposureVecUniform);
     bgfx::destroy(tonemappingModeVecUniform);
     bgfx::destroy(blitTriangleBuffer);
@@ -104,6 +179,7 @@ void Renderer::shutdown()
     blitProgram = BGFX_INVALID_HANDLE;
     blitSampler = camPosUniform = normalMatrixUniform = exposureVecUniform = tonemappingModeVecUniform =
         BGFX_INVALID_HANDLE;
+    positionScaleVecUniform = positionOffsetVecUniform = BGFX_INVALID_HANDLE;
     blitTriangleBuffer = BGFX_INVALID_HANDLE;
     frameBuffer = BGFX_INVALID_HANDLE;
 
@@ -130,6 +206,32 @@ void Renderer::setMultipleScattering(bool enabled)
     pbr.multipleScatteringEnabled = enabled;
 }
 
+void Renderer::setOcclusionCullingMode(OcclusionCullingMode mode)
+{
+    if(mode != occlusionCullingMode)
+    {
+        // old results don't match the current view anymore
+        if(depthPyramidSupported)
+            depthPyramid.invalidate();
+    }
+    occlusionCullingMode = mode;
+}
+
+void Renderer::setGpuCulling(bool enabled)
+{
+    gpuCulling = enabled;
+}
+
+void Renderer::setLod(bool enabled)
+{
+    lodEnabled = enabled;
+}
+
+void Renderer::setMultithreadedSubmission(bool enabled)
+{
+    multithreadedSubmission = enabled;
+}
+
 void Renderer::setWhiteFurnace(bool enabled)
 {
     pbr.whiteFurnaceEnabled = enabled;
@@ -146,6 +248,11 @@ bool Renderer::supported()
 }
 
 void Renderer::setViewProjection(bgfx::ViewId view)
+{
+    bgfx::setViewTransform(view, glm::value_ptr(viewMat), glm::value_ptr(projMat));
+}
+
+void Renderer::updateMatrices()
 {
     // view matrix
     viewMat = scene->camera.matrix();
@@ -157,11 +264,154 @@ void Renderer::setViewProjection(bgfx::ViewId view)
                 scene->camera.zFar,
                 bgfx::getCaps()->homogeneousDepth,
                 bx::Handness::Left);
-    bgfx::setViewTransform(view, glm::value_ptr(viewMat), glm::value_ptr(projMat));
 }
 
-void Renderer::setNormalMatrix(const glm::mat4& modelMat)
+void Renderer::cull()
+{
+    // chunk bounds are in world space since node transformations are baked into the vertices
+    const BoundsSoA& bounds = scene->chunkBounds;
+    visibility.resize(bounds.size());
+
+    Frustum frustum(projMat * viewMat, bgfx::getCaps()->homogeneousDepth);
+
+    cullingStats = CullingStats();
+    cullingStats.total = uint32_t(bounds.size());
+
+    // opaque chunks are culled by the compute shader
+    // transparent chunks are drawn unculled, they need the CPU for depth sorting anyway
+    if(gpuCullingActive())
+    {
+        cullingStats.gpu = true;
+        std::fill(visibility.begin(), visibility.end(), uint8_t(1));
+        return;
+    }
+
+    cullingStats.frustumCulled = frustum.cull(bounds, visibility.data());
+
+    // normal cones, only for chunks that survived
+    const glm::vec3 camPos = scene->camera.position();
+    for(size_t i = 0; i < scene->chunks.size(); i++)
+    {
+        const MeshChunk& chunk = scene->chunks[i];
+        if(visibility[i] && chunk.cone.backfacing(chunk.sphere, camPos))
+        {
+            visibility[i] = 0;
+            cullingStats.backfaceCulled++;
+        }
+    }
+
+    switch(occlusionCullingMode)
+    {
+        case OcclusionCullingMode::QUERIES:
+            if(occlusionSupported)
+                cullingStats.occlusionCulled = occlusion.cull(scene, camPos, visibility.data());
+            break;
+        case OcclusionCullingMode::HIZ:
+            if(depthPyramidSupported)
+                cullingStats.occlusionCulled = depthPyramid.cull(scene, visibility.data());
+            break;
+        case OcclusionCullingMode::SOFTWARE:
+            cullingStats.occlusionCulled = softwareOcclusion.cull(scene, visibility.data(), *threads);
+            cullingStats.occluders = softwareOcclusion.stats.occluders;
+            cullingStats.occluderTriangles = softwareOcclusion.stats.occluderTriangles;
+            cullingStats.occludees = softwareOcclusion.stats.occludees;
+            cullingStats.occlusionTime = softwareOcclusion.stats.time;
+            break;
+        default:
+            break;
+    }
+}
+
+void Renderer::selectLods()
+{
+    lods.resize(scene->chunks.size(), 0);
+    if(!lodEnabled)
+    {
+        std::fill(lods.begin(), lods.end(), uint8_t(0));
+        return;
+    }
+
+    const glm::vec3 camPos = scene->camera.position();
+    const float pixelScale = lodPixelScale();
+    for(size_t i = 0; i < scene->chunks.size(); i++)
+    {
+        // hidden chunks keep their level
+        if(!visibility[i])
+            continue;
+
+        const MeshChunk& chunk = scene->chunks[i];
+        float distance =
+            glm::max(glm::distance(chunk.sphere.center, camPos) - chunk.sphere.radius, scene->camera.zNear);
+        float scale = pixelScale / distance;
+
+        uint32_t lod = glm::min(uint32_t(lods[i]), chunk.numLods - 1);
+        // refine as soon as the error becomes visible
+        while(lod > 0 && chunk.lods[lod].error * scale > LOD_MAX_ERROR)
+            lod--;
+        // only coarsen once the next level is well below the threshold
+        while(lod + 1 < chunk.numLods && chunk.lods[lod + 1].error * scale <= LOD_MAX_ERROR * (1.0f - LOD_HYSTERESIS))
+            lod++;
+
+        lods[i] = uint8_t(lod);
+        cullingStats.lodTrianglesSaved += (chunk.numIndices - chunk.lods[lod].numIndices) / 3;
+    }
+}
+
+float Renderer::lodPixelScale() const
+{
+    // vertical field of view
+    return float(height) / (2.0f * glm::tan(glm::radians(scene->camera.fov) * 0.5f));
+}
+
+void Renderer::trackTextureDemand()
+{
+    textureDemand.assign(scene->materials.size(), 0.0f);
+
+    // GPU culling marks every chunk visible, textures of hidden chunks are requested as well
+    const glm::vec3 camPos = scene->camera.position();
+    const float pixelScale = lodPixelScale();
+    for(size_t i = 0; i < scene->chunks.size(); i++)
+    {
+        if(!visibility[i])
+            continue;
+
+        const MeshChunk& chunk = scene->chunks[i];
+        const Mesh& mesh = scene->meshes[chunk.mesh];
+        // without texture coordinates every pixel samples the same texel
+        if(mesh.uvDensity <= 0.0f)
+            continue;
+        // closest point of the bounding sphere, world units -> pixels -> UV units
+        float distance =
+            glm::max(glm::distance(chunk.sphere.center, camPos) - chunk.sphere.radius, scene->camera.zNear);
+        float& demand = textureDemand[mesh.material];
+        demand = glm::max(demand, pixelScale / (distance * mesh.uvDensity));
+    }
+
+    // instanced meshes have no chunks and their UV density is in object space, keep them at full resolution
+    for(const Mesh& mesh : scene->meshes)
+    {
+        if(!mesh.instances.empty() && mesh.uvDensity > 0.0f)
+            textureDemand[mesh.material] = std::numeric_limits<float>::max();
+    }
+}
+
+void Renderer::submitOcclusionQueries(bgfx::ViewId view)
+{
+    if(occlusionCullingMode == OcclusionCullingMode::QUERIES && occlusionSupported && !gpuCullingActive())
+        occlusion.submitQueries(view, scene);
+}
+
+void Renderer::buildDepthPyramid(bgfx::ViewId view, bgfx::TextureHandle depth)
+{
+    if(occlusionCullingMode == OcclusionCullingMode::HIZ && depthPyramidSupported)
+        depthPyramid.build(view, DEPTH_PYRAMID_READ_VIEW, depth, projMat * viewMat);
+}
+
+void Renderer::setNormalMatrix(const glm::mat4& modelMat, bgfx::Encoder* encoder)
 {
+    if(!encoder)
+        encoder = bgfx::begin();
+
     // usually the normal matrix is based on the model view matrix
     // but shading is done in world space (not eye space) so it's just the model matrix
     //glm::mat4 modelViewMat = viewMat * modelMat;
@@ -174,7 +424,176 @@ void Renderer::setNormalMatrix(const glm::mat4& modelMat)
     // see https://github.com/graphitemaster/normals_revisited#the-details-of-transforming-normals
     // cofactor is the transpose of the adjugate
     glm::mat3 normalMat = glm::transpose(glm::adjugate(glm::mat3(modelMat)));
-    bgfx::setUniform(normalMatrixUniform, glm::value_ptr(normalMat));
+    encoder->setUniform(normalMatrixUniform, glm::value_ptr(normalMat));
+}
+
+void Renderer::setVertexDequantization(uint32_t mesh, bgfx::Encoder* encoder)
+{
+    if(!encoder)
+        encoder = bgfx::begin();
+
+    const DequantizationBinding& binding = dequantizationBindings[mesh];
+    encoder->setUniform(positionScaleVecUniform, glm::value_ptr(binding.positionScale));
+    encoder->setUniform(positionOffsetVecUniform, glm::value_ptr(binding.positionOffset));
+}
+
+void Renderer::bakeBindings()
+{
+    pbr.uploadMaterials(scene->materials);
+    materialBindings.clear();
+    for(size_t i = 0; i < scene->materials.size(); i++)
+    {
+        materialBindings.push_back(pbr.bakeMaterial(scene->materials[i], uint32_t(i)));
+    }
+
+    dequantizationBindings.clear();
+    for(const Mesh& mesh : scene->meshes)
+    {
+        DequantizationBinding binding;
+        binding.positionScale = glm::vec4(mesh.positionScale, scene->verticesQuantized ? 1.0f : 0.0f);
+        binding.positionOffset = glm::vec4(mesh.positionOffset, 0.0f);
+        dequantizationBindings.push_back(binding);
+    }
+}
+
+void Renderer::submitDraws(bgfx::ViewId view,
+                           DrawList::Pass pass,
+                           const SceneProgram& program,
+                           const SceneProgram& instancedProgram,
+                           uint64_t state,
+                           const PassBindings& bindings)
+{
+    const int64_t start = bx::getHPCounter();
+
+    // bgfx would otherwise reorder the draws by its own sort key
+    bgfx::setViewMode(view, bgfx::ViewMode::Sequential);
+
+    // static geometry is already in world space
+    // draws without a transform use bgfx's identity matrix, the normal matrix uniform keeps its value
+    if(bindings)
+        bindings(nullptr);
+    setNormalMatrix(glm::identity<glm::mat4>());
+    pbr.bindMaterialTable();
+    pbr.bindMultipleScattering();
+
+    if(pass == DrawList::Opaque && gpuCullingActive())
+    {
+        assert(bgfx::isValid(program.indirectHandle));
+        submitIndirectDraws(view, program, state);
+    }
+    else
+        submitChunkDraws(view, pass, program, state, bindings);
+
+    if(scene->meshesInstanced)
+        submitInstancedDraws(view, pass, instancedProgram, state);
+
+    submitStats.time += float(double(bx::getHPCounter() - start) * 1000.0 / double(bx::getHPFrequency()));
+}
+
+void Renderer::submitChunkDraws(bgfx::ViewId view,
+                                DrawList::Pass pass,
+                                const SceneProgram& program,
+                                uint64_t state,
+                                const PassBindings& bindings)
+{
+    visibleDraws.clear();
+    for(const uint32_t* it = drawList.begin(pass); it != drawList.end(pass); it++)
+    {
+        if(visibility[drawList.draws[*it].chunk])
+            visibleDraws.push_back(*it);
+    }
+    const uint32_t count = uint32_t(visibleDraws.size());
+
+    uint32_t tasks = 1;
+    if(multithreadedSubmission && multithreadedSubmissionSupported)
+    {
+        // one encoder per task, they're a limited resource
+        tasks = std::min(threads->size(), bgfx::getCaps()->limits.maxEncoders - 1);
+        tasks = std::min(tasks, count / MIN_DRAWS_PER_SUBMIT_TASK);
+    }
+
+    if(tasks <= 1)
+    {
+        // uniforms keep their value between submit calls
+        // textures stay bound as long as BGFX_DISCARD_BINDINGS is excluded from the discard flags
+        submitStats.draws += submitChunkRange(bgfx::begin(), view, program, state, 0, count, false);
+        return;
+    }
+
+    // bgfx assigns sequence numbers when a draw is submitted so draws from different encoders interleave
+    // transparent draws have to be blended in order, sort them by their position in the draw list instead
+    // the opaque pass stays sequential so occlusion queries submitted afterwards still come last
+    if(pass == DrawList::Transparent)
+        bgfx::setViewMode(view, bgfx::ViewMode::DepthAscending);
+
+    submitStats.workers.resize(threads->size());
+    threads->parallelFor(tasks, [&](uint32_t task, uint32_t worker) {
+        const int64_t start = bx::getHPCounter();
+
+        bgfx::Encoder* encoder = bgfx::begin(true);
+        // can't happen with fewer tasks than encoders
+        if(!encoder)
+            return;
+
+        // each encoder starts without bindings or uniforms
+        if(bindings)
+            bindings(encoder);
+        setNormalMatrix(glm::identity<glm::mat4>(), encoder);
+        pbr.bindMaterialTable(encoder);
+        pbr.bindMultipleScattering(encoder);
+
+        // uniforms of the encoders end up interleaved in the command buffer
+        // so the material index and mesh uniforms can't rely on the previous draw anymore
+        // textures are bindings and stay with the encoder
+        const uint32_t first = uint32_t(uint64_t(count) * task / tasks);
+        const uint32_t last = uint32_t(uint64_t(count) * (task + 1) / tasks);
+        uint32_t draws = submitChunkRange(encoder, view, program, state, first, last, true);
+        bgfx::end(encoder);
+
+        // workers are unique within a job, no other thread writes this entry
+        SubmitStats::Worker& stats = submitStats.workers[worker];
+        stats.draws += draws;
+        stats.time += float(double(bx::getHPCounter() - start) * 1000.0 / double(bx::getHPFrequency()));
+    });
+    submitStats.draws += count;
+}
+
+uint32_t Renderer::submitChunkRange(bgfx::Encoder* encoder,
+                                    bgfx::ViewId view,
+                                    const SceneProgram& program,
+                                    uint64_t state,
+                                    uint32_t first,
+                                    uint32_t last,
+                                    bool perDrawUniforms)
+{
+    uint32_t boundMaterial = UINT32_MAX;
+    uint32_t boundMesh = UINT32_MAX;
+    PBRShader::BindingCache bindingCache;
+
+    for(uint32_t i = first; i < last; i++)
+    {
+        const DrawList::Draw& draw = drawList.draws[visibleDraws[i]];
+        const MeshChunk::Lod& lod = scene->chunks[draw.chunk].lods[lods[draw.chunk]];
+        encoder->setVertexBuffer(0, draw.vertexBuffer);
+        encoder->setIndexBuffer(draw.indexBuffer, draw.firstIndex + lod.firstIndex, lod.numIndices);
+        if(perDrawUniforms || draw.mesh != boundMesh)
+        {
+            setVertexDequantization(draw.mesh, encoder);
+            boundMesh = draw.mesh;
+        }
+        if(perDrawUniforms || draw.material != boundMaterial)
+        {
+            pbr.bindMaterial(materialBindings[draw.material], encoder, &bindingCache);
+            boundMaterial = draw.material;
+        }
+        encoder->setState(state | draw.state);
+        // depth is only used by the DepthAscending view mode of multithreaded transparent passes
+        // material textures are sampled differently from texture arrays
+        const bgfx::ProgramHandle handle = materialBindings[draw.material].textureArrays ? program.arrayHandle
+                                                                                        : program.handle;
+        encoder->submit(view, handle, i, ~BGFX_DISCARD_BINDINGS);
+    }
+    return last - first;
 }
 
 void Renderer::blitToScreen(bgfx::ViewId view)
@@ -194,6 +613,45 @@ void Renderer::blitToScreen(bgfx::ViewId view)
     bgfx::submit(view, blitProgram);
 }
 
+Renderer::SceneProgram Renderer::loadSceneProgram(const char* vs,
+                                                  const char* fs,
+                                                  bool arrayVariant,
+                                                  bool indirectVariant)
+{
+    char vsName[128], fsName[128], fsArrayName[128];
+    bx::snprintf(vsName, BX_COUNTOF(vsName), "%s%s.bin", shaderDir(), vs);
+    bx::snprintf(fsName, BX_COUNTOF(fsName), "%s%s.bin", shaderDir(), fs);
+    bx::snprintf(fsArrayName, BX_COUNTOF(fsArrayName), "%s%s_array.bin", shaderDir(), fs);
+    arrayVariant = arrayVariant && (bgfx::getCaps()->supported & BGFX_CAPS_TEXTURE_2D_ARRAY);
+
+    SceneProgram program;
+    program.handle = program.arrayHandle = bigg::loadProgram(vsName, fsName);
+    if(arrayVariant)
+        program.arrayHandle = bigg::loadProgram(vsName, fsArrayName);
+
+    if(indirectVariant && GpuCuller::supported())
+    {
+        bx::snprintf(vsName, BX_COUNTOF(vsName), "%s%s_indirect.bin", shaderDir(), vs);
+        program.indirectHandle = program.indirectArrayHandle = bigg::loadProgram(vsName, fsName);
+        if(arrayVariant)
+            program.indirectArrayHandle = bigg::loadProgram(vsName, fsArrayName);
+    }
+    return program;
+}
+
+void Renderer::destroy(SceneProgram& program)
+{
+    if(program.arrayHandle.idx != program.handle.idx)
+        bgfx::destroy(program.arrayHandle);
+    bgfx::destroy(program.handle);
+    if(program.indirectArrayHandle.idx != program.indirectHandle.idx)
+        bgfx::destroy(program.indirectArrayHandle);
+    if(bgfx::isValid(program.indirectHandle))
+        bgfx::destroy(program.indirectHandle);
+    program.handle = program.arrayHandle = BGFX_INVALID_HANDLE;
+    program.indirectHandle = program.indirectArrayHandle = BGFX_INVALID_HANDLE;
+}
+
 bgfx::TextureFormat::Enum Renderer::findDepthFormat(uint64_t textureFlags, bool stencil)
 {
     const bgfx::TextureFormat::Enum depthFormats[] = { bgfx::TextureFormat::D16, bgfx::TextureFormat::D32 };
@@ -234,10 +692,11 @@ bgfx::FrameBufferHandle Renderer::createFrameBuffer(bool hdr, bool depth)
 
     if(depth)
     {
-        bgfx::TextureFormat::Enum depthFormat = findDepthFormat(BGFX_TEXTURE_RT_WRITE_ONLY | samplerFlags);
+        // sampled by the depth pyramid compute pass
+        bgfx::TextureFormat::Enum depthFormat = findDepthFormat(BGFX_TEXTURE_RT | samplerFlags);
         assert(depthFormat != bgfx::TextureFormat::Enum::Count);
-        textures[attachments++] = bgfx::createTexture2D(
-            bgfx::BackbufferRatio::Equal, false, 1, depthFormat, BGFX_TEXTURE_RT_WRITE_ONLY | samplerFlags);
+        textures[attachments++] =
+            bgfx::createTexture2D(bgfx::BackbufferRatio::Equal, false, 1, depthFormat, BGFX_TEXTURE_RT | samplerFlags);
     }
 
     bgfx::FrameBufferHandle fb = bgfx::createFrameBuffer(attachments, textures, true);
@@ -283,3 +742,141 @@ const char* Renderer::shaderDir()
 
     return path;
 }
+
+bool Renderer::gpuCullingActive() const
+{
+    return gpuCulling && gpuCullingSupported;
+}
+
+void Renderer::submitInstancedDraws(bgfx::ViewId view,
+                                    DrawList::Pass pass,
+                                    const SceneProgram& program,
+                                    uint64_t state)
+{
+    // instances aren't depth sorted with the chunks, transparent instances are drawn on top
+    const bool transparent = pass == DrawList::Transparent;
+    Frustum frustum(projMat * viewMat, bgfx::getCaps()->homogeneousDepth);
+    PBRShader::BindingCache bindingCache;
+
+    // meshes added since the last rebuild have no bindings yet
+    for(uint32_t m = 0; m < builtMeshes; m++)
+    {
+        const Mesh& mesh = scene->meshes[m];
+        const Material& mat = scene->materials[mesh.material];
+        if(mesh.instances.empty() || mat.blend != transparent)
+            continue;
+
+        uint32_t count = uint32_t(mesh.instances.size());
+        instanceVisibility.resize(count);
+        uint32_t visible = count - frustum.cull(mesh.instanceBounds, instanceVisibility.data());
+        if(visible == 0)
+            continue;
+
+        // bgfx has a per-frame limit for instance data, draw what fits
+        const uint16_t stride = sizeof(glm::mat4);
+        visible = bgfx::getAvailInstanceDataBuffer(visible, stride);
+        if(visible == 0)
+            continue;
+
+        bgfx::InstanceDataBuffer instanceData;
+        bgfx::allocInstanceDataBuffer(&instanceData, visible, stride);
+        glm::mat4* models = (glm::mat4*)instanceData.data;
+        for(uint32_t i = 0, written = 0; i < count && written < visible; i++)
+        {
+            if(instanceVisibility[i])
+                models[written++] = mesh.instances[i];
+        }
+
+        bgfx::setInstanceDataBuffer(&instanceData);
+        bgfx::setVertexBuffer(0, mesh.vertexBuffer);
+        // no chunks or LODs, just the mesh's triangles
+        bgfx::setIndexBuffer(mesh.indexBuffer, mesh.firstIndex, uint32_t(mesh.indices.size()));
+        setVertexDequantization(m);
+        const PBRShader::MaterialBinding& binding = materialBindings[mesh.material];
+        uint64_t materialState = pbr.bindMaterial(binding, nullptr, &bindingCache);
+        bgfx::setState(state | materialState);
+        // after all chunks if the view is depth sorted
+        const bgfx::ProgramHandle handle = binding.textureArrays ? program.arrayHandle : program.handle;
+        bgfx::submit(view, handle, UINT32_MAX, ~BGFX_DISCARD_BINDINGS);
+        submitStats.draws++;
+    }
+}
+
+void Renderer::submitIndirectDraws(bgfx::ViewId view, const SceneProgram& program, uint64_t state)
+{
+    // runs before the draws since they're in the same view
+    const bool hiz = occlusionCullingMode == OcclusionCullingMode::HIZ && depthPyramidSupported;
+    gpuCuller.dispatch(view,
+                       scene,
+                       projMat * viewMat,
+                       hiz ? &depthPyramid : nullptr,
+                       lodEnabled ? lodPixelScale() : 0.0f,
+                       LOD_MAX_ERROR);
+
+    PBRShader::BindingCache bindingCache;
+
+    // the material index comes from the instance data, meshes can be drawn together
+    // if they share buffers and dequantization and their materials share textures and state
+    auto compatible = [this](const Mesh& a, const Mesh& b) {
+        const PBRShader::MaterialBinding& bindingA = materialBindings[a.material];
+        const PBRShader::MaterialBinding& bindingB = materialBindings[b.material];
+        for(size_t t = 0; t < BX_COUNTOF(bindingA.textures); t++)
+        {
+            if(bindingA.textures[t].idx != bindingB.textures[t].idx)
+                return false;
+        }
+        return bindingA.state == bindingB.state && bindingA.textureArrays == bindingB.textureArrays &&
+               a.vertexBuffer.idx == b.vertexBuffer.idx &&
+               a.indexBuffer.idx == b.indexBuffer.idx && a.positionScale == b.positionScale &&
+               a.positionOffset == b.positionOffset;
+    };
+
+    // meshes added since the last rebuild have no bindings or indirect commands yet
+    const std::vector<Mesh>& meshes = scene->meshes;
+    for(size_t i = 0; i < builtMeshes; i++)
+    {
+        const size_t first = i;
+        const Mesh& mesh = meshes[i];
+        const Material& mat = scene->materials[mesh.material];
+        if(mat.blend || mesh.numChunks == 0)
+            continue;
+
+        // with merged buffers, meshes are sorted by material and their chunks are contiguous
+        uint32_t numChunks = mesh.numChunks;
+        while(i + 1 < builtMeshes && meshes[i + 1].firstChunk == mesh.firstChunk + numChunks &&
+              !scene->materials[meshes[i + 1].material].blend && compatible(mesh, meshes[i + 1]))
+        {
+            numChunks += meshes[++i].numChunks;
+        }
+
+        setVertexDequantization(uint32_t(first));
+        // only binds the textures, the material index uniform isn't used
+        const PBRShader::MaterialBinding& binding = materialBindings[mesh.material];
+        pbr.bindMaterial(binding, nullptr, &bindingCache);
+        const bgfx::ProgramHandle handle = binding.textureArrays ? program.indirectArrayHandle : program.indirectHandle;
+
+        // runs crossing an indirect buffer boundary take one submit per buffer
+        const uint32_t end = mesh.firstChunk + numChunks;
+        for(uint32_t chunk = mesh.firstChunk; chunk < end;)
+        {
+            const uint32_t batch = chunk / GpuCuller::BATCH_SIZE;
+            const uint32_t offset = chunk % GpuCuller::BATCH_SIZE;
+            const uint32_t count = std::min(end - chunk, GpuCuller::BATCH_SIZE - offset);
+
+            bgfx::setVertexBuffer(0, mesh.vertexBuffer);
+            // the indirect commands select the index range and the instance
+            bgfx::setIndexBuffer(mesh.indexBuffer);
+            gpuCuller.setInstanceData(batch);
+            bgfx::setState(state | binding.state);
+            bgfx::submit(view,
+                         handle,
+                         gpuCuller.indirectBuffers[batch],
+                         uint16_t(offset),
+                         uint16_t(count),
+                         0,
+                         ~BGFX_DISCARD_BINDINGS);
+            submitStats.draws++;
+            chunk += count;
+        }
+    }
+}
@@ -3,16 +3,26 @@
 #include <bgfx/bgfx.h>
 #include "Renderer/PBRShader.h"
 #include "Renderer/LightShader.h"
+#include "Renderer/DrawList.h"
+#include "Renderer/OcclusionCuller.h"
+#include "Renderer/DepthPyramid.h"
+#include "Renderer/SoftwareOcclusion.h"
+#include "Renderer/GpuCuller.h"
 #include <glm/matrix.hpp>
 #include <unordered_map>
+#include <functional>
+#include <vector>
 #include <string>
 
 class Scene;
+struct Mesh;
+class ThreadPool;
 
 class Renderer
 {
 public:
-    Renderer(const Scene* scene);
+    // threads are used for CPU culling and multithreaded submission
+    Renderer(const Scene* scene, ThreadPool* threads);
     virtual ~Renderer() { }
 
     void initialize();
@@ -35,6 +45,24 @@ public:
     };
 
     void setTonemappingMode(TonemappingMode mode);
+
+    enum class OcclusionCullingMode : int
+    {
+        NONE = 0,
+        QUERIES, // hardware occlusion queries, results from previous frames
+        HIZ,     // depth pyramid read back from previous frames
+        SOFTWARE // CPU rasterized occluders from the current frame
+    };
+
+    void setOcclusionCullingMode(OcclusionCullingMode mode);
+    // cull opaque chunks in a compute shader and draw them with indirect draw calls
+    // only Hi-Z occlusion culling is supported in this mode
+    void setGpuCulling(bool enabled);
+    // draw simplified chunks depending on their projected size
+    void setLod(bool enabled);
+    // record the chunk draws of a pass on worker threads, each with its own bgfx encoder
+    // ignored if bgfx only has one encoder
+    void setMultithreadedSubmission(bool enabled);
     void setMultipleScattering(bool enabled);
     void setWhiteFurnace(bool enabled);
 
@@ -60,6 +88,50 @@ public:
 
     TextureBuffer* buffers = nullptr;
 
+    // visibility results of the last frame
+
+    struct CullingStats
+    {
+        uint32_t total = 0;           // number of scene chunks
+        bool gpu = false;             // culled in a compute shader, the counts below aren't read back
+        uint32_t frustumCulled = 0;   // outside the view frustum
+        uint32_t backfaceCulled = 0;  // normal cone facing away from the camera
+        uint32_t occlusionCulled = 0; // bounding box hidden by occluders
+
+        // software occlusion only
+        uint32_t occluders = 0;
+        uint32_t occluderTriangles = 0;
+        uint32_t occludees = 0;
+        float occlusionTime = 0.0f; // ms
+
+        // visible chunks drawn at a coarser level of detail
+        uint32_t lodTrianglesSaved = 0;
+    };
+
+    CullingStats cullingStats;
+
+    // CPU side of submitDraws in the last frame
+    struct SubmitStats
+    {
+        uint32_t draws = 0; // bgfx::submit calls for scene geometry
+        float time = 0.0f;  // ms
+
+        // per worker thread, only filled with multithreaded submission
+        // time is the sum of all recorded ranges, without waiting for other workers
+        struct Worker
+        {
+            uint32_t draws = 0;
+            float time = 0.0f; // ms
+        };
+        std::vector<Worker> workers;
+    };
+
+    SubmitStats submitStats;
+
+    // screen pixels per unit of texture coordinates each material needs, 0 if it's not visible
+    // written by trackTextureDemand(), Scene::updateStreaming picks texture levels from it
+    std::vector<float> textureDemand;
+
     // final output
     // used for tonemapping
     bgfx::FrameBufferHandle frameBuffer = BGFX_INVALID_HANDLE;
@@ -80,9 +152,66 @@ protected:
     };
 
     static constexpr bgfx::ViewId MAX_VIEW = 199; // imgui in bigg uses view 200
+    static constexpr bgfx::ViewId DEPTH_PYRAMID_READ_VIEW = MAX_VIEW - 1;
 
+    // largest allowed projected LOD error in pixels
+    static constexpr float LOD_MAX_ERROR = 1.0f;
+    // switch to a coarser level only once its error is this much below the threshold
+    // prevents popping back and forth at the boundary
+    static constexpr float LOD_HYSTERESIS = 0.25f;
+
+    // fewest chunk draws per worker thread, smaller ranges aren't worth the encoder overhead
+    static constexpr uint32_t MIN_DRAWS_PER_SUBMIT_TASK = 128;
+
+    // sets the camera matrices calculated at the start of the frame
     void setViewProjection(bgfx::ViewId view);
-    void setNormalMatrix(const glm::mat4& modelMat);
+    // encoder = nullptr sets the uniform on the main thread's encoder
+    void setNormalMatrix(const glm::mat4& modelMat, bgfx::Encoder* encoder = nullptr);
+    // position scale/offset of quantized vertices, for vertex.sh
+    void setVertexDequantization(uint32_t mesh, bgfx::Encoder* encoder = nullptr);
+
+    // program for scene draws, with a variant for material textures in texture arrays (Material::textureArrays)
+    // the variant uses the fragment shader <fs>_array, arrayHandle is the same as handle without one
+    // opaque pass programs also get variants for GPU-driven indirect draws with the vertex shader <vs>_indirect
+    // that takes the material index from the instance data, invalid without one
+    struct SceneProgram
+    {
+        bgfx::ProgramHandle handle = BGFX_INVALID_HANDLE;
+        bgfx::ProgramHandle arrayHandle = BGFX_INVALID_HANDLE;
+        bgfx::ProgramHandle indirectHandle = BGFX_INVALID_HANDLE;
+        bgfx::ProgramHandle indirectArrayHandle = BGFX_INVALID_HANDLE;
+    };
+    // shader names without directory and extension
+    static SceneProgram loadSceneProgram(const char* vs,
+                                         const char* fs,
+                                         bool arrayVariant = true,
+                                         bool indirectVariant = false);
+    static void destroy(SceneProgram& program);
+
+    // binds a pass's shared uniforms, textures and buffers (lights, clusters, ...)
+    // called once for every encoder that records draws of the pass
+    using PassBindings = std::function<void(bgfx::Encoder* encoder)>;
+
+    // submit all visible scene chunks of a pass in draw list order
+    // the material index and its changed textures are only bound when the material changes
+    // with GPU culling the opaque pass is culled and submitted as indirect draws with the program's indirect variant
+    // instanced meshes are drawn afterwards with instancedProgram, it takes the model matrix from i_data0-3
+    // with multithreaded submission the chunk draws are split into contiguous ranges across worker threads
+    // the program variant is picked per draw based on the material's texture layout
+    void submitDraws(bgfx::ViewId view,
+                     DrawList::Pass pass,
+                     const SceneProgram& program,
+                     const SceneProgram& instancedProgram,
+                     uint64_t state,
+                     const PassBindings& bindings = nullptr);
+
+    // render chunk bounding boxes as occlusion queries for the next frame
+    // call after submitting the opaque pass, the view's depth buffer must contain the occluders
+    void submitOcclusionQueries(bgfx::ViewId view);
+
+    // build the depth pyramid used for culling in the next frames
+    // view must be a free view after the opaque pass and before any transparent draws that write depth
+    void buildDepthPyramid(bgfx::ViewId view, bgfx::TextureHandle depth);
 
     void blitToScreen(bgfx::ViewId view = MAX_VIEW);
 
@@ -92,8 +221,10 @@ protected:
     std::unordered_map<std::string, std::string> variables;
 
     TonemappingMode tonemappingMode = TonemappingMode::NONE;
+    OcclusionCullingMode occlusionCullingMode = OcclusionCullingMode::NONE;
 
     const Scene* scene = nullptr;
+    ThreadPool* threads = nullptr;
 
     uint16_t width = 0;
     uint16_t height = 0;
@@ -101,20 +232,95 @@ protected:
     PBRShader pbr;
     LightShader lights;
 
+    DrawList drawList;
+    // scene revisions the draw list and bindings were built for
+    uint32_t builtGeometryRevision = 0;
+    uint32_t builtMaterialRevision = 0;
+    // meshes the draw data was built for, more can be added while loading
+    size_t builtMeshes = 0;
+    // per chunk, written by cull()
+    std::vector<uint8_t> visibility;
+
+    OcclusionCuller occlusion;
+    bool occlusionSupported = false;
+    DepthPyramid depthPyramid;
+    bool depthPyramidSupported = false;
+    SoftwareOcclusion softwareOcclusion;
+
+    GpuCuller gpuCuller;
+    bool gpuCullingSupported = false;
+    bool gpuCulling = false;
+
+    bool lodEnabled = true;
+    // selected level per chunk, written by selectLods()
+    // kept between frames for hysteresis
+    std::vector<uint8_t> lods;
+
+    // per material and mesh uniforms, baked with the draw list
+    std::vector<PBRShader::MaterialBinding> materialBindings;
+    struct DequantizationBinding
+    {
+        glm::vec4 positionScale; // w = vertices are quantized
+        glm::vec4 positionOffset;
+    };
+    std::vector<DequantizationBinding> dequantizationBindings;
+
+    bool multithreadedSubmission = false;
+    bool multithreadedSubmissionSupported = false;
+    // draw list indices of the visible chunks of the current pass, written by submitChunkDraws()
+    std::vector<uint32_t> visibleDraws;
+
+    // per instance of the current mesh, written by submitInstancedDraws()
+    std::vector<uint8_t> instanceVisibility;
+
     uint32_t clearColor = 0;
     float time = 0.0f;
 
-    // set by setViewProjection()
+    // set by updateMatrices()
     glm::mat4 viewMat = glm::mat4(1.0);
     glm::mat4 projMat = glm::mat4(1.0);
 
     bgfx::VertexBufferHandle blitTriangleBuffer = BGFX_INVALID_HANDLE;
 
 private:
+    void updateMatrices();
+    // resolve material and mesh uniforms for the draw packets
+    void bakeBindings();
+    void cull();
+    bool gpuCullingActive() const;
+    // pick a LOD for every visible chunk from its projected error
+    void selectLods();
+    // object space error / distance -> pixels
+    float lodPixelScale() const;
+    // largest texel density each material's visible chunks need
+    void trackTextureDemand();
+    // one draw per visible chunk in draw list order
+    void submitChunkDraws(bgfx::ViewId view,
+                          DrawList::Pass pass,
+                          const SceneProgram& program,
+                          uint64_t state,
+                          const PassBindings& bindings);
+    // draws [first, last) of visibleDraws
+    // perDrawUniforms rebinds material and mesh uniforms for every draw instead of only on changes
+    // returns the number of draws
+    uint32_t submitChunkRange(bgfx::Encoder* encoder,
+                              bgfx::ViewId view,
+                              const SceneProgram& program,
+                              uint64_t state,
+                              uint32_t first,
+                              uint32_t last,
+                              bool perDrawUniforms);
+    // one indirect draw per opaque mesh, or run of meshes sharing material and buffers
+    void submitIndirectDraws(bgfx::ViewId view, const SceneProgram& program, uint64_t state);
+    // one instanced draw per mesh with its frustum culled instances
+    void submitInstancedDraws(bgfx::ViewId view, DrawList::Pass pass, const SceneProgram& program, uint64_t state);
+
     bgfx::ProgramHandle blitProgram = BGFX_INVALID_HANDLE;
     bgfx::UniformHandle blitSampler = BGFX_INVALID_HANDLE;
     bgfx::UniformHandle camPosUniform = BGFX_INVALID_HANDLE;
     bgfx::UniformHandle normalMatrixUniform = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle positionScaleVecUniform = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle positionOffsetVecUniform = BGFX_INVALID_HANDLE;
     bgfx::UniformHandle exposureVecUniform = BGFX_INVALID_HANDLE;
     bgfx::UniformHandle tonemappingModeVecUniform = BGFX_INVALID_HANDLE;
 };
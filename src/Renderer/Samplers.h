@@ -27,4 +27,20 @@ public:
     static const uint8_t DEFERRED_F0_METALLIC = 9;
     static const uint8_t DEFERRED_EMISSIVE_OCCLUSION = 10;
     static const uint8_t DEFERRED_DEPTH = 11;
+
+    // shared, after the per renderer bindings
+
+    static const uint8_t PBR_MATERIALS = 12;
+
+    // depth pyramid compute pass
+
+    static const uint8_t HIZ_INPUT = 0;
+    static const uint8_t HIZ_OUTPUT = 1;
+
+    // GPU culling compute pass
+
+    static const uint8_t GPU_CULLING_DRAWS = 0;
+    static const uint8_t GPU_CULLING_INDIRECT = 1;
+    static const uint8_t GPU_CULLING_HIZ = 2;
+    static const uint8_t GPU_CULLING_LODS = 3;
 };
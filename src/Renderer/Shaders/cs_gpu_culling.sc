@@ -0,0 +1,161 @@
+#include <bgfx_compute.sh>
+#include "samplers.sh"
+
+// frustum, normal cone and Hi-Z occlusion culling for every scene chunk
+// writes one indexed indirect draw command per chunk, culled chunks get 0 instances
+// the command's first instance is the chunk's instance data entry, relative to the batch
+
+#define GPU_CULLING_THREADS 64
+
+// vec4 per draw, keep in sync with GpuCuller::DrawData
+// 0: xyz = bounding sphere/box center, w = sphere radius
+// 1: xyz = box extents, w = normal cone cutoff
+// 2: xyz = normal cone axis, w = material
+// 3: LOD 0 - 3 errors, infinite for missing levels
+#define DRAW_STRIDE 4
+// uvec4 per draw, first index and number of indices
+// 0: LOD 0 and 1
+// 1: LOD 2 and 3
+#define LOD_STRIDE 2
+
+// xyz = camera position
+uniform vec4 u_cullCamPosVec;
+// x = unused, y = Hi-Z enabled, z = homogeneous depth, w = texture origin bottom left
+uniform vec4 u_cullParamsVec;
+#define u_hizEnabled (u_cullParamsVec.y != 0.0)
+#define u_homogeneousDepth (u_cullParamsVec.z != 0.0)
+#define u_originBottomLeft (u_cullParamsVec.w != 0.0)
+// x = first draw of this dispatch, y = number of draws
+// the indirect buffer only holds this batch, see GpuCuller::BATCH_SIZE
+uniform vec4 u_cullBatchVec;
+#define u_firstDraw uint(u_cullBatchVec.x)
+#define u_drawCount uint(u_cullBatchVec.y)
+// xy = size of the depth buffer the Hi-Z pyramid was built from, z = number of levels
+uniform vec4 u_cullHizVec;
+// x = LOD pixel scale (0 = full resolution only), y = max error in pixels, z = camera near plane
+uniform vec4 u_cullLodVec;
+// same order as Frustum::Plane
+uniform vec4 u_frustumPlanes[6];
+// matrix the Hi-Z pyramid was rendered with
+uniform mat4 u_hizViewProj;
+
+BUFFER_RO(b_draws, vec4, SAMPLER_GPU_CULLING_DRAWS);
+BUFFER_RO(b_lodRanges, uvec4, SAMPLER_GPU_CULLING_LODS);
+BUFFER_WR(b_indirect, uvec4, SAMPLER_GPU_CULLING_INDIRECT);
+SAMPLER2D(s_hiz, SAMPLER_GPU_CULLING_HIZ);
+
+// same as Frustum::cull
+bool frustumVisible(vec3 center, vec3 extents, float radius)
+{
+    for(int i = 0; i < 6; i++)
+    {
+        vec4 plane = u_frustumPlanes[i];
+        float dist = dot(plane.xyz, center) + plane.w;
+        float boxRadius = dot(abs(plane.xyz), extents);
+        if(dist < -min(boxRadius, radius))
+            return false;
+    }
+    return true;
+}
+
+// same as NormalCone::backfacing
+bool coneBackfacing(vec3 center, float radius, vec3 axis, float cutoff)
+{
+    vec3 view = center - u_cullCamPosVec.xyz;
+    return dot(view, axis) >= cutoff * length(view) + radius;
+}
+
+// same as DepthPyramid::cull but on the level where the box covers at most 2x2 texels
+bool hizVisible(vec3 center, vec3 extents)
+{
+    vec3 ndcMin = vec3_splat(1.0e30);
+    vec3 ndcMax = vec3_splat(-1.0e30);
+    for(int corner = 0; corner < 8; corner++)
+    {
+        vec3 side = vec3(float(corner & 1), float((corner >> 1) & 1), float((corner >> 2) & 1)) * 2.0 - 1.0;
+        vec4 clip = mul(u_hizViewProj, vec4(center + extents * side, 1.0));
+        // crosses the near plane
+        if(clip.w <= 0.00001)
+            return true;
+        vec3 ndc = clip.xyz / clip.w;
+        ndcMin = min(ndcMin, ndc);
+        ndcMax = max(ndcMax, ndc);
+    }
+
+    // no depth information outside of the old view
+    if(any(lessThan(ndcMin.xy, vec2_splat(-1.0))) || any(greaterThan(ndcMax.xy, vec2_splat(1.0))))
+        return true;
+
+    // nearest depth of the box in [0, 1]
+    float nearest = u_homogeneousDepth ? ndcMin.z * 0.5 + 0.5 : ndcMin.z;
+
+    vec2 uvMin = ndcMin.xy * 0.5 + 0.5;
+    vec2 uvMax = ndcMax.xy * 0.5 + 0.5;
+    if(!u_originBottomLeft)
+    {
+        // texture rows start at the top
+        float top = 1.0 - uvMax.y;
+        uvMax.y = 1.0 - uvMin.y;
+        uvMin.y = top;
+    }
+
+    // covered level 0 texels through the depth buffer pixels, see DepthPyramid::cull
+    ivec2 depthSize = ivec2(u_cullHizVec.xy);
+    ivec2 first = clamp(ivec2(uvMin * vec2(depthSize)), ivec2(0, 0), depthSize - 1) >> 1;
+    ivec2 last = clamp(ivec2(uvMax * vec2(depthSize)), ivec2(0, 0), depthSize - 1) >> 1;
+
+    // n texels span at most 2 texels on level ceil(log2(n))
+    vec2 extent = vec2(last - first + 1);
+    int level = clamp(int(ceil(log2(max(extent.x, extent.y)))), 0, int(u_cullHizVec.z) - 1);
+    ivec2 levelSize = max((depthSize >> 1) >> level, ivec2(1, 1));
+    first = min(first >> level, levelSize - 1);
+    last = min(last >> level, levelSize - 1);
+
+    // occluded if it's behind the farthest depth in all covered texels
+    for(int y = first.y; y <= last.y; y++)
+    {
+        for(int x = first.x; x <= last.x; x++)
+        {
+            if(nearest <= texelFetch(s_hiz, ivec2(x, y), level).y)
+                return true;
+        }
+    }
+    return false;
+}
+
+NUM_THREADS(GPU_CULLING_THREADS, 1, 1)
+void main()
+{
+    uint command = gl_GlobalInvocationID.x;
+    if(command >= u_drawCount)
+        return;
+    uint index = u_firstDraw + command;
+
+    vec4 centerRadius = b_draws[index * DRAW_STRIDE + 0];
+    vec4 extentsCutoff = b_draws[index * DRAW_STRIDE + 1];
+    vec4 axisMaterial = b_draws[index * DRAW_STRIDE + 2];
+    vec4 lodErrors = b_draws[index * DRAW_STRIDE + 3];
+
+    bool visible = frustumVisible(centerRadius.xyz, extentsCutoff.xyz, centerRadius.w) &&
+                   !coneBackfacing(centerRadius.xyz, centerRadius.w, axisMaterial.xyz, extentsCutoff.w) &&
+                   (!u_hizEnabled || hizVisible(centerRadius.xyz, extentsCutoff.xyz));
+
+    // coarsest level with a small enough projected error, same as Renderer::selectLods minus the hysteresis
+    int lod = 0;
+    if(u_cullLodVec.x > 0.0)
+    {
+        float distance = max(length(centerRadius.xyz - u_cullCamPosVec.xyz) - centerRadius.w, u_cullLodVec.z);
+        float scale = u_cullLodVec.x / distance;
+        for(int i = 1; i < 4; i++)
+        {
+            if(lodErrors[i] * scale <= u_cullLodVec.y)
+                lod = i;
+        }
+    }
+    uvec4 ranges = b_lodRanges[index * LOD_STRIDE + uint(lod >> 1)];
+    uvec2 range = (lod & 1) == 0 ? ranges.xy : ranges.zw;
+
+    uint firstIndex = range.x;
+    uint numIndices = range.y;
+    drawIndexedIndirect(b_indirect, command, numIndices, visible ? 1u : 0u, firstIndex, 0u, command);
+}
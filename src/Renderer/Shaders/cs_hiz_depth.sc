@@ -0,0 +1,28 @@
+#include "hiz.sh"
+
+// first pyramid level from the depth buffer
+
+SAMPLER2D(s_texDepth, SAMPLER_HIZ_INPUT);
+
+NUM_THREADS(HIZ_THREADS, HIZ_THREADS, 1)
+void main()
+{
+    ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+    if(coord.x >= u_hizOutputSize.x || coord.y >= u_hizOutputSize.y)
+        return;
+
+    ivec2 first, last;
+    hizFootprint(coord, first, last);
+
+    vec2 minMax = vec2(1.0, 0.0);
+    for(int y = first.y; y <= last.y; y++)
+    {
+        for(int x = first.x; x <= last.x; x++)
+        {
+            float depth = texelFetch(s_texDepth, ivec2(x, y), 0).x;
+            minMax = vec2(min(minMax.x, depth), max(minMax.y, depth));
+        }
+    }
+
+    imageStore(i_hizOutput, coord, vec4(minMax, 0.0, 0.0));
+}
@@ -0,0 +1,28 @@
+#include "hiz.sh"
+
+// next pyramid level from the previous one
+
+IMAGE2D_RO(i_hizInput, rg32f, SAMPLER_HIZ_INPUT);
+
+NUM_THREADS(HIZ_THREADS, HIZ_THREADS, 1)
+void main()
+{
+    ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+    if(coord.x >= u_hizOutputSize.x || coord.y >= u_hizOutputSize.y)
+        return;
+
+    ivec2 first, last;
+    hizFootprint(coord, first, last);
+
+    vec2 minMax = vec2(1.0, 0.0);
+    for(int y = first.y; y <= last.y; y++)
+    {
+        for(int x = first.x; x <= last.x; x++)
+        {
+            vec2 texel = imageLoad(i_hizInput, ivec2(x, y)).xy;
+            minMax = vec2(min(minMax.x, texel.x), max(minMax.y, texel.y));
+        }
+    }
+
+    imageStore(i_hizOutput, coord, vec4(minMax, 0.0, 0.0));
+}
@@ -0,0 +1,6 @@
+$input v_worldpos, v_normal, v_tangent, v_texcoord0, v_material
+
+// material textures are layers in texture arrays
+#define MATERIAL_TEXTURE_ARRAYS
+
+#include "clustered.sh"
@@ -0,0 +1,7 @@
+#include <bgfx_shader.sh>
+
+// color writes are disabled, only the samples passing the depth test matter
+void main()
+{
+    gl_FragColor = vec4_splat(0.0);
+}
@@ -0,0 +1,32 @@
+#ifndef HIZ_SH_HEADER_GUARD
+#define HIZ_SH_HEADER_GUARD
+
+#include <bgfx_compute.sh>
+#include "samplers.sh"
+
+// hierarchical min/max depth pyramid
+// every texel stores the minimum (R) and maximum (G) depth of its footprint in the depth buffer
+
+#define HIZ_THREADS 8
+
+// xy = input size, zw = output size
+uniform vec4 u_hizSizeVec;
+#define u_hizInputSize ivec2(u_hizSizeVec.xy)
+#define u_hizOutputSize ivec2(u_hizSizeVec.zw)
+
+IMAGE2D_WR(i_hizOutput, rg32f, SAMPLER_HIZ_OUTPUT);
+
+// first and last input texel covered by an output texel
+// usually 2x2, on odd-sized inputs the last row/column also covers the remaining texel
+// this keeps the pyramid conservative with floor(size / 2) mip sizes
+void hizFootprint(ivec2 coord, out ivec2 first, out ivec2 last)
+{
+    first = coord * 2;
+    last = first + ivec2(1, 1);
+    if(coord.x == u_hizOutputSize.x - 1)
+        last.x = u_hizInputSize.x - 1;
+    if(coord.y == u_hizOutputSize.y - 1)
+        last.y = u_hizInputSize.y - 1;
+}
+
+#endif // HIZ_SH_HEADER_GUARD
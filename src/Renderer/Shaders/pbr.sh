@@ -1,6 +1,7 @@
 #ifndef PBR_SH_HEADER_GUARD
 #define PBR_SH_HEADER_GUARD
 
+#include <bgfx_compute.sh>
 #include "samplers.sh"
 
 #ifdef WRITE_LUT
@@ -13,16 +14,47 @@ SAMPLER2D(s_texAlbedoLUT, SAMPLER_PBR_ALBEDO_LUT);
 // without it you can still use the struct definition or BRDF functions
 #ifdef READ_MATERIAL
 
+// define MATERIAL_TEXTURE_ARRAYS if the scene was loaded with texture arrays
+// the layer of each texture is stored in the material table
+#ifdef MATERIAL_TEXTURE_ARRAYS
+
+SAMPLER2DARRAY(s_texBaseColor,         SAMPLER_PBR_BASECOLOR);
+SAMPLER2DARRAY(s_texMetallicRoughness, SAMPLER_PBR_METALROUGHNESS);
+SAMPLER2DARRAY(s_texNormal,            SAMPLER_PBR_NORMAL);
+SAMPLER2DARRAY(s_texOcclusion,         SAMPLER_PBR_OCCLUSION);
+SAMPLER2DARRAY(s_texEmissive,          SAMPLER_PBR_EMISSIVE);
+
+#define materialTexture(sampler, texcoord, layer) texture2DArray(sampler, vec3(texcoord, layer))
+
+#else
+
 SAMPLER2D(s_texBaseColor,         SAMPLER_PBR_BASECOLOR);
 SAMPLER2D(s_texMetallicRoughness, SAMPLER_PBR_METALROUGHNESS);
 SAMPLER2D(s_texNormal,            SAMPLER_PBR_NORMAL);
 SAMPLER2D(s_texOcclusion,         SAMPLER_PBR_OCCLUSION);
 SAMPLER2D(s_texEmissive,          SAMPLER_PBR_EMISSIVE);
 
-uniform vec4 u_baseColorFactor;
-uniform vec4 u_metallicRoughnessNormalOcclusionFactor;
-uniform vec4 u_emissiveFactorVec;
-uniform vec4 u_hasTextures;
+#define materialTexture(sampler, texcoord, layer) texture2D(sampler, texcoord)
+
+#endif
+
+// material table, keep in sync with PBRShader::MaterialData
+// 0: base color factor
+// 1: metallic factor, roughness factor, normal scale, occlusion strength
+// 2: xyz = emissive factor, w = emissive texture layer
+// 3: x = texture bit mask
+// 4: base color, metallic/roughness, normal, occlusion texture layer
+BUFFER_RO(b_materials, vec4, SAMPLER_PBR_MATERIALS);
+#define MATERIAL_STRIDE 5
+
+// the vertex shader passes on the material index, see vertex.sh
+#define u_materialOffset (uint(v_material) * MATERIAL_STRIDE)
+
+#define u_baseColorFactor                        (b_materials[u_materialOffset + 0])
+#define u_metallicRoughnessNormalOcclusionFactor (b_materials[u_materialOffset + 1])
+#define u_emissiveFactorVec                      (b_materials[u_materialOffset + 2])
+#define u_hasTextures                            (b_materials[u_materialOffset + 3])
+#define u_textureLayers                          (b_materials[u_materialOffset + 4])
 
 #define u_hasBaseColorTexture         ((uint(u_hasTextures.x) & (1 << 0)) != 0)
 #define u_hasMetallicRoughnessTexture ((uint(u_hasTextures.x) & (1 << 1)) != 0)
@@ -35,6 +67,12 @@ uniform vec4 u_hasTextures;
 #define u_occlusionStrength       (u_metallicRoughnessNormalOcclusionFactor.w)
 #define u_emissiveFactor          (u_emissiveFactorVec.xyz)
 
+#define u_baseColorLayer          (u_textureLayers.x)
+#define u_metallicRoughnessLayer  (u_textureLayers.y)
+#define u_normalLayer             (u_textureLayers.z)
+#define u_occlusionLayer          (u_textureLayers.w)
+#define u_emissiveLayer           (u_emissiveFactorVec.w)
+
 #endif
 
 uniform vec4 u_multipleScatteringVec;
@@ -67,7 +105,7 @@ vec4 pbrBaseColor(vec2 texcoord)
 {
     if(u_hasBaseColorTexture)
     {
-        return texture2D(s_texBaseColor, texcoord) * u_baseColorFactor;
+        return materialTexture(s_texBaseColor, texcoord, u_baseColorLayer) * u_baseColorFactor;
     }
     else
     {
@@ -79,7 +117,7 @@ vec2 pbrMetallicRoughness(vec2 texcoord)
 {
     if(u_hasMetallicRoughnessTexture)
     {
-        return texture2D(s_texMetallicRoughness, texcoord).bg * u_metallicRoughnessFactor;
+        return materialTexture(s_texMetallicRoughness, texcoord, u_metallicRoughnessLayer).bg * u_metallicRoughnessFactor;
     }
     else
     {
@@ -93,7 +131,9 @@ vec3 pbrNormal(vec2 texcoord)
     {
         // the normal scale can cause problems and serves no real purpose
         // normal compression and BRDF calculations assume unit length
-        return normalize((texture2D(s_texNormal, texcoord).rgb * 2.0) - 1.0); // * u_normalScale;
+        // BC5 normal maps only store x and y, z is always reconstructed since it's positive in tangent space
+        vec2 xy = (materialTexture(s_texNormal, texcoord, u_normalLayer).rg * 2.0) - 1.0; // * u_normalScale;
+        return normalize(vec3(xy, sqrt(saturate(1.0 - dot(xy, xy)))));
     }
     else
     {
@@ -108,7 +148,7 @@ float pbrOcclusion(vec2 texcoord)
     if(u_hasOcclusionTexture)
     {
         // occludedColor = lerp(color, color * <sampled occlusion texture value>, <occlusion strength>)
-        float occlusion = texture2D(s_texOcclusion, texcoord).r;
+        float occlusion = materialTexture(s_texOcclusion, texcoord, u_occlusionLayer).r;
         return occlusion + (1.0 - occlusion) * (1.0 - u_occlusionStrength);
     }
     else
@@ -121,7 +161,7 @@ vec3 pbrEmissive(vec2 texcoord)
 {
     if(u_hasEmissiveTexture)
     {
-        return texture2D(s_texEmissive, texcoord).rgb * u_emissiveFactor;
+        return materialTexture(s_texEmissive, texcoord, u_emissiveLayer).rgb * u_emissiveFactor;
     }
     else
     {
@@ -26,4 +26,20 @@
 #define SAMPLER_DEFERRED_EMISSIVE_OCCLUSION 10
 #define SAMPLER_DEFERRED_DEPTH 11
 
+// shared, after the per renderer bindings
+
+#define SAMPLER_PBR_MATERIALS 12
+
+// depth pyramid compute pass
+
+#define SAMPLER_HIZ_INPUT 0
+#define SAMPLER_HIZ_OUTPUT 1
+
+// GPU culling compute pass
+
+#define SAMPLER_GPU_CULLING_DRAWS 0
+#define SAMPLER_GPU_CULLING_INDIRECT 1
+#define SAMPLER_GPU_CULLING_HIZ 2
+#define SAMPLER_GPU_CULLING_LODS 3
+
 #endif // SAMPLERS_SH_HEADER_GUARD
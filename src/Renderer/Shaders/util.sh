@@ -50,11 +50,12 @@ float screen2EyeDepth(float depth, float near, float far)
 }
 
 // convert normal from tangent space to space of normal_ref and tangent_ref
-vec3 convertTangentNormal(vec3 normal_ref, vec3 tangent_ref, vec3 normal)
+// tangent_ref.w is the bitangent sign
+vec3 convertTangentNormal(vec3 normal_ref, vec4 tangent_ref, vec3 normal)
 {
-    vec3 bitangent = cross(normal_ref, tangent_ref);
+    vec3 bitangent = cross(normal_ref, tangent_ref.xyz) * tangent_ref.w;
     mat3 TBN = mtxFromCols(
-        normalize(tangent_ref),
+        normalize(tangent_ref.xyz),
         normalize(bitangent),
         normalize(normal_ref)
     );
@@ -0,0 +1,57 @@
+#ifndef VERTEX_SH_HEADER_GUARD
+#define VERTEX_SH_HEADER_GUARD
+
+// decoding of mesh vertex attributes
+// either plain floats (Mesh::PosNormalTangentTex0Vertex) or quantized (Mesh::QuantizedVertex)
+
+// xyz = position scale, w = 1 if the vertex is quantized
+uniform vec4 u_positionScaleVec;
+// xyz = position offset
+uniform vec4 u_positionOffsetVec;
+#define u_vertexQuantized (u_positionScaleVec.w != 0.0)
+
+// x = index into the material table, passed to the fragment shader in v_material
+// indirect draws take it from the instance data instead (vs_*_indirect.sc)
+uniform vec4 u_materialIndexVec;
+
+// inverse of octahedralEncode in Mesh.cpp
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e.x, e.y, 1.0 - abs(e.x) - abs(e.y));
+    if(n.z < 0.0)
+    {
+        vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        n.xy = (1.0 - abs(n.yx)) * signs;
+    }
+    return normalize(n);
+}
+
+vec3 decodePosition(vec3 position)
+{
+    // float vertices have scale 1 and offset 0
+    return position * u_positionScaleVec.xyz + u_positionOffsetVec.xyz;
+}
+
+vec3 decodeNormal(vec4 normal)
+{
+    if(u_vertexQuantized)
+        return octahedralDecode(normal.xy);
+    return normal.xyz;
+}
+
+// w = bitangent sign
+vec4 decodeTangent(vec4 tangent)
+{
+    if(u_vertexQuantized)
+        return vec4(octahedralDecode(tangent.xy * 2.0 - 1.0), tangent.w * 2.0 - 1.0);
+    return tangent;
+}
+
+// normal matrix for instance model matrices, see Renderer::setNormalMatrix
+// cofactor matrix of the upper 3x3 model matrix, columns c0, c1, c2
+mat3 instanceNormalMatrix(vec3 c0, vec3 c1, vec3 c2)
+{
+    return mtxFromCols(cross(c1, c2), cross(c2, c0), cross(c0, c1));
+}
+
+#endif // VERTEX_SH_HEADER_GUARD
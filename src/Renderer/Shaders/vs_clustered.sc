@@ -1,15 +1,21 @@
 $input a_position, a_normal, a_tangent, a_texcoord0
-$output v_worldpos, v_normal, v_tangent, v_texcoord0
+$output v_worldpos, v_normal, v_tangent, v_texcoord0, v_material
 
 #include <bgfx_shader.sh>
+#include "vertex.sh"
 
 uniform mat3 u_normalMatrix;
 
 void main()
 {
-    v_worldpos = mul(u_model[0], vec4(a_position, 1.0)).xyz;
-    v_normal = mul(u_normalMatrix, a_normal);
-    v_tangent = mul(u_model[0], vec4(a_tangent, 0.0)).xyz;
+    vec3 position = decodePosition(a_position);
+    vec3 normal = decodeNormal(a_normal);
+    vec4 tangent = decodeTangent(a_tangent);
+
+    v_worldpos = mul(u_model[0], vec4(position, 1.0)).xyz;
+    v_normal = mul(u_normalMatrix, normal);
+    v_tangent = vec4(mul(u_model[0], vec4(tangent.xyz, 0.0)).xyz, tangent.w);
     v_texcoord0 = a_texcoord0;
-    gl_Position = mul(u_modelViewProj, vec4(a_position, 1.0));
+    v_material = u_materialIndexVec.x;
+    gl_Position = mul(u_modelViewProj, vec4(position, 1.0));
 }
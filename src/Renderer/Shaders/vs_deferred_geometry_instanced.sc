@@ -0,0 +1,22 @@
+$input a_position, a_normal, a_tangent, a_texcoord0, i_data0, i_data1, i_data2, i_data3
+$output v_normal, v_tangent, v_texcoord0, v_material
+
+#include <bgfx_shader.sh>
+#include "vertex.sh"
+
+// same as vs_deferred_geometry.sc with the model matrix from the instance data
+
+void main()
+{
+    vec3 position = decodePosition(a_position);
+    vec3 normal = decodeNormal(a_normal);
+    vec4 tangent = decodeTangent(a_tangent);
+
+    mat4 model = mtxFromCols(i_data0, i_data1, i_data2, i_data3);
+
+    v_normal = mul(instanceNormalMatrix(i_data0.xyz, i_data1.xyz, i_data2.xyz), normal);
+    v_tangent = vec4(mul(model, vec4(tangent.xyz, 0.0)).xyz, tangent.w);
+    v_texcoord0 = a_texcoord0;
+    v_material = u_materialIndexVec.x;
+    gl_Position = mul(u_viewProj, mul(model, vec4(position, 1.0)));
+}
@@ -0,0 +1,24 @@
+$input a_position, a_normal, a_tangent, a_texcoord0, i_data0
+$output v_worldpos, v_normal, v_tangent, v_texcoord0, v_material
+
+#include <bgfx_shader.sh>
+#include "vertex.sh"
+
+// same as vs_forward.sc with the material index from the instance data
+// GPU-driven draws of several materials share one indirect submit, see GpuCuller
+
+uniform mat3 u_normalMatrix;
+
+void main()
+{
+    vec3 position = decodePosition(a_position);
+    vec3 normal = decodeNormal(a_normal);
+    vec4 tangent = decodeTangent(a_tangent);
+
+    v_worldpos = mul(u_model[0], vec4(position, 1.0)).xyz;
+    v_normal = mul(u_normalMatrix, normal);
+    v_tangent = vec4(mul(u_model[0], vec4(tangent.xyz, 0.0)).xyz, tangent.w);
+    v_texcoord0 = a_texcoord0;
+    v_material = i_data0.x;
+    gl_Position = mul(u_modelViewProj, vec4(position, 1.0));
+}
@@ -0,0 +1,331 @@
+#include "SoftwareOcclusion.h"
+
+#include "Scene/Scene.h"
+#include "Util/ThreadPool.h"
+#include <bx/math.h>
+#include <bx/simd_t.h>
+#include <bx/timer.h>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <limits>
+
+using namespace bx;
+
+void SoftwareOcclusion::reset(uint16_t width, uint16_t height)
+{
+    aspect = float(width) / height;
+    this->height = bx::max<uint32_t>(uint32_t(float(WIDTH) / aspect + 0.5f), 1);
+    depth.resize(WIDTH / 4 * this->height);
+}
+
+uint32_t SoftwareOcclusion::cull(const Scene* scene, uint8_t* visibility, ThreadPool& threads)
+{
+    const int64_t start = bx::getHPCounter();
+
+    stats = Stats();
+    if(depth.empty() || scene->chunks.empty())
+        return 0;
+
+    const Camera& camera = scene->camera;
+    glm::mat4 proj;
+    bx::mtxProj(
+        glm::value_ptr(proj), camera.fov, aspect, camera.zNear, camera.zFar, false /* [0, 1] */, bx::Handness::Left);
+    viewProj = proj * camera.matrix();
+
+    // pick the chunks that cover the most screen area
+    // transparent chunks don't hide anything
+
+    struct Candidate
+    {
+        float size;
+        uint32_t chunk;
+    };
+    std::vector<Candidate> candidates;
+
+    const glm::vec3 camPos = camera.position();
+    for(uint32_t i = 0; i < scene->chunks.size(); i++)
+    {
+        if(!visibility[i])
+            continue;
+        stats.occludees++;
+
+        const MeshChunk& chunk = scene->chunks[i];
+        if(scene->materials[scene->meshes[chunk.mesh].material].blend)
+            continue;
+        float distance = glm::max(glm::length(chunk.sphere.center - camPos), camera.zNear);
+        float size = chunk.sphere.radius / distance;
+        if(size >= MIN_OCCLUDER_SIZE)
+            candidates.push_back({ size, i });
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.size > b.size;
+    });
+
+    occluders.clear();
+    uint32_t triangleBudget = MAX_OCCLUDER_TRIANGLES;
+    for(const Candidate& candidate : candidates)
+    {
+        uint32_t triangles = scene->chunks[candidate.chunk].numIndices / 3;
+        if(triangles > triangleBudget)
+            break;
+        triangleBudget -= triangles;
+        occluders.push_back(candidate.chunk);
+    }
+    stats.occluders = uint32_t(occluders.size());
+
+    // transform and clip occluders
+
+    occluderTriangles.resize(occluders.size());
+    threads.parallelFor(uint32_t(occluders.size()), [this, scene](uint32_t task, uint32_t) {
+        transformOccluder(scene, occluders[task], occluderTriangles[task]);
+    });
+    for(const std::vector<Triangle>& triangles : occluderTriangles)
+    {
+        stats.occluderTriangles += uint32_t(triangles.size());
+    }
+
+    // rasterize, each task owns a band of rows
+
+    const uint32_t bands = (height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+    threads.parallelFor(bands, [this](uint32_t band, uint32_t) {
+        int firstRow = int(band * BAND_HEIGHT);
+        int lastRow = int(bx::min((band + 1) * BAND_HEIGHT, height)) - 1;
+
+        const DepthBlock far = { { 1.0f, 1.0f, 1.0f, 1.0f } };
+        std::fill(depth.begin() + firstRow * width / 4, depth.begin() + (lastRow + 1) * width / 4, far);
+
+        for(const std::vector<Triangle>& triangles : occluderTriangles)
+        {
+            for(const Triangle& triangle : triangles)
+            {
+                if(triangle.maxY >= firstRow && triangle.minY <= lastRow)
+                    rasterize(triangle, firstRow, lastRow);
+            }
+        }
+    });
+
+    // test bounding boxes
+
+    const uint32_t tasks = (uint32_t(scene->chunks.size()) + TEST_BATCH - 1) / TEST_BATCH;
+    culledPerTask.assign(tasks, 0);
+    threads.parallelFor(tasks, [this, scene, visibility](uint32_t task, uint32_t) {
+        uint32_t first = task * TEST_BATCH;
+        uint32_t last = bx::min(first + TEST_BATCH, uint32_t(scene->chunks.size()));
+        for(uint32_t i = first; i < last; i++)
+        {
+            const AABB& aabb = scene->chunks[i].aabb;
+            if(visibility[i] && !testBox(aabb.min, aabb.max))
+            {
+                visibility[i] = 0;
+                culledPerTask[task]++;
+            }
+        }
+    });
+
+    uint32_t culled = 0;
+    for(uint32_t count : culledPerTask)
+    {
+        culled += count;
+    }
+
+    stats.time = float(double(bx::getHPCounter() - start) * 1000.0 / double(bx::getHPFrequency()));
+
+    return culled;
+}
+
+void SoftwareOcclusion::transformOccluder(const Scene* scene, uint32_t chunkIndex, std::vector<Triangle>& triangles) const
+{
+    triangles.clear();
+
+    const MeshChunk& chunk = scene->chunks[chunkIndex];
+    const Mesh& mesh = scene->meshes[chunk.mesh];
+    const bool doubleSided = scene->materials[mesh.material].doubleSided;
+
+    for(uint32_t i = chunk.firstIndex; i < chunk.firstIndex + chunk.numIndices; i += 3)
+    {
+        glm::vec4 clip[3];
+        uint32_t inside = 0;
+        for(uint32_t v = 0; v < 3; v++)
+        {
+            clip[v] = viewProj * glm::vec4(mesh.positions[mesh.indices[i + v]], 1.0f);
+            inside += clip[v].z >= 0.0f ? 1 : 0;
+        }
+
+        if(inside == 3)
+        {
+            addTriangle(clip, doubleSided, triangles);
+        }
+        else if(inside > 0)
+        {
+            // clip against the near plane (z = 0), results in 3 or 4 vertices
+            glm::vec4 polygon[4];
+            uint32_t count = 0;
+            for(uint32_t v = 0; v < 3; v++)
+            {
+                const glm::vec4& a = clip[v];
+                const glm::vec4& b = clip[(v + 1) % 3];
+                if(a.z >= 0.0f)
+                    polygon[count++] = a;
+                if((a.z >= 0.0f) != (b.z >= 0.0f))
+                    polygon[count++] = glm::mix(a, b, a.z / (a.z - b.z));
+            }
+
+            glm::vec4 fan[3] = { polygon[0], polygon[1], polygon[2] };
+            addTriangle(fan, doubleSided, triangles);
+            if(count == 4)
+            {
+                fan[1] = polygon[2];
+                fan[2] = polygon[3];
+                addTriangle(fan, doubleSided, triangles);
+            }
+        }
+    }
+}
+
+void SoftwareOcclusion::addTriangle(const glm::vec4 clip[3], bool doubleSided, std::vector<Triangle>& triangles) const
+{
+    // pixel coordinates, y down
+    glm::vec3 s[3];
+    for(uint32_t v = 0; v < 3; v++)
+    {
+        glm::vec3 ndc = glm::vec3(clip[v]) / clip[v].w;
+        s[v] = { (ndc.x * 0.5f + 0.5f) * width, (0.5f - ndc.y * 0.5f) * height, ndc.z };
+    }
+
+    // front faces are counter-clockwise in NDC, clockwise with y pointing down
+    float area = (s[1].x - s[0].x) * (s[2].y - s[0].y) - (s[2].x - s[0].x) * (s[1].y - s[0].y);
+    if(area > 0.0f)
+    {
+        if(!doubleSided)
+            return;
+    }
+    else
+    {
+        std::swap(s[1], s[2]);
+        area = -area;
+    }
+    if(area <= std::numeric_limits<float>::epsilon())
+        return;
+
+    Triangle triangle;
+    triangle.minX = bx::max(int(glm::floor(glm::min(s[0].x, glm::min(s[1].x, s[2].x)))), 0);
+    triangle.minY = bx::max(int(glm::floor(glm::min(s[0].y, glm::min(s[1].y, s[2].y)))), 0);
+    triangle.maxX = bx::min(int(glm::ceil(glm::max(s[0].x, glm::max(s[1].x, s[2].x)))), int(width) - 1);
+    triangle.maxY = bx::min(int(glm::ceil(glm::max(s[0].y, glm::max(s[1].y, s[2].y)))), int(height) - 1);
+    if(triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+        return;
+
+    for(uint32_t e = 0; e < 3; e++)
+    {
+        const glm::vec3& a = s[e];
+        const glm::vec3& b = s[(e + 1) % 3];
+        triangle.a[e] = a.y - b.y;
+        triangle.b[e] = b.x - a.x;
+        triangle.c[e] = -(triangle.a[e] * a.x + triangle.b[e] * a.y);
+    }
+
+    glm::vec3 d1 = s[1] - s[0];
+    glm::vec3 d2 = s[2] - s[0];
+    triangle.za = (d1.z * d2.y - d2.z * d1.y) / area;
+    triangle.zb = (d2.z * d1.x - d1.z * d2.x) / area;
+    triangle.zc = s[0].z - triangle.za * s[0].x - triangle.zb * s[0].y;
+
+    triangles.push_back(triangle);
+}
+
+void SoftwareOcclusion::rasterize(const Triangle& triangle, int firstRow, int lastRow)
+{
+    const simd128_t zero = simd_zero<simd128_t>();
+    const simd128_t offsets = simd_ld<simd128_t>(0.5f, 1.5f, 2.5f, 3.5f);
+
+    const simd128_t a0 = simd_splat<simd128_t>(triangle.a[0]);
+    const simd128_t a1 = simd_splat<simd128_t>(triangle.a[1]);
+    const simd128_t a2 = simd_splat<simd128_t>(triangle.a[2]);
+    const simd128_t za = simd_splat<simd128_t>(triangle.za);
+
+    float* buffer = depth.front().z;
+
+    const int minY = bx::max(triangle.minY, firstRow);
+    const int maxY = bx::min(triangle.maxY, lastRow);
+    // start on a SIMD boundary
+    const int minX = triangle.minX & ~3;
+
+    for(int y = minY; y <= maxY; y++)
+    {
+        const float py = float(y) + 0.5f;
+        const simd128_t row0 = simd_splat<simd128_t>(triangle.b[0] * py + triangle.c[0]);
+        const simd128_t row1 = simd_splat<simd128_t>(triangle.b[1] * py + triangle.c[1]);
+        const simd128_t row2 = simd_splat<simd128_t>(triangle.b[2] * py + triangle.c[2]);
+        const simd128_t rowZ = simd_splat<simd128_t>(triangle.zb * py + triangle.zc);
+
+        float* row = buffer + y * width;
+        for(int x = minX; x <= triangle.maxX; x += 4)
+        {
+            const simd128_t px = simd_add(simd_splat<simd128_t>(float(x)), offsets);
+
+            // coverage mask, pixel centers inside all edges
+            const simd128_t e0 = simd_madd(a0, px, row0);
+            const simd128_t e1 = simd_madd(a1, px, row1);
+            const simd128_t e2 = simd_madd(a2, px, row2);
+            const simd128_t inside =
+                simd_and(simd_and(simd_cmpge(e0, zero), simd_cmpge(e1, zero)), simd_cmpge(e2, zero));
+
+            // depth test, keep the closest
+            const simd128_t z = simd_madd(za, px, rowZ);
+            const simd128_t old = simd_ld<simd128_t>(row + x);
+            const simd128_t mask = simd_and(inside, simd_cmplt(z, old));
+            simd_st(row + x, simd_selb(mask, z, old));
+        }
+    }
+}
+
+bool SoftwareOcclusion::testBox(const glm::vec3& min, const glm::vec3& max) const
+{
+    glm::vec3 ndcMin = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 ndcMax = glm::vec3(-std::numeric_limits<float>::max());
+    for(int corner = 0; corner < 8; corner++)
+    {
+        glm::vec4 pos = {
+            (corner & 1) ? max.x : min.x, (corner & 2) ? max.y : min.y, (corner & 4) ? max.z : min.z, 1.0f
+        };
+        glm::vec4 clip = viewProj * pos;
+        // crosses the near plane
+        if(clip.z < 0.0f)
+            return true;
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        ndcMin = glm::min(ndcMin, ndc);
+        ndcMax = glm::max(ndcMax, ndc);
+    }
+
+    // pixel rectangle, y down
+    int minX = bx::max(int(glm::floor((ndcMin.x * 0.5f + 0.5f) * width)), 0);
+    int maxX = bx::min(int(glm::floor((ndcMax.x * 0.5f + 0.5f) * width)), int(width) - 1);
+    int minY = bx::max(int(glm::floor((0.5f - ndcMax.y * 0.5f) * height)), 0);
+    int maxY = bx::min(int(glm::floor((0.5f - ndcMin.y * 0.5f) * height)), int(height) - 1);
+    if(minX > maxX || minY > maxY)
+        return true; // off-screen, leave it to frustum culling
+
+    // visible if any pixel in the rectangle is farther away than the closest point of the box
+    // the SIMD blocks may reach past the rectangle which only makes this more conservative
+    const simd128_t nearest = simd_splat<simd128_t>(ndcMin.z);
+    const float* buffer = depth.front().z;
+    for(int y = minY; y <= maxY; y++)
+    {
+        const float* row = buffer + y * width;
+        simd128_t visible = simd_zero<simd128_t>();
+        for(int x = minX & ~3; x <= maxX; x += 4)
+        {
+            visible = simd_or(visible, simd_cmpge(simd_ld<simd128_t>(row + x), nearest));
+        }
+
+        alignas(16) uint32_t mask[4];
+        simd_st(mask, visible);
+        if(mask[0] | mask[1] | mask[2] | mask[3])
+            return true;
+    }
+
+    return false;
+}
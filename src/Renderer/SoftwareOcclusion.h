@@ -0,0 +1,85 @@
+#pragma once
+
+#include <glm/matrix.hpp>
+#include <glm/vec3.hpp>
+#include <vector>
+
+class Scene;
+class ThreadPool;
+
+// CPU occlusion culling with a low resolution software depth buffer
+// the largest chunks on screen are rasterized as occluders, then all chunk bounding boxes are tested against the result
+// triangles are rasterized 4 pixels at a time with SIMD coverage masks, rows are split into bands across worker threads
+// doesn't need any GPU features and has no latency
+class SoftwareOcclusion
+{
+public:
+    struct Stats
+    {
+        uint32_t occluders = 0;         // chunks rasterized
+        uint32_t occluderTriangles = 0; // triangles after clipping and backface culling
+        uint32_t occludees = 0;         // chunks tested
+        float time = 0.0f;              // ms
+    };
+
+    // size of the render target, the depth buffer uses the same aspect ratio
+    void reset(uint16_t width, uint16_t height);
+
+    // remove chunks hidden behind the occluders
+    // visibility must contain the frustum culling results
+    // returns the number of culled chunks
+    uint32_t cull(const Scene* scene, uint8_t* visibility, ThreadPool& threads);
+
+    Stats stats;
+
+private:
+    // depth buffer width, height follows the aspect ratio
+    // has to be a multiple of 4 (SIMD width)
+    static constexpr uint32_t WIDTH = 256;
+    // rows per rasterization task
+    static constexpr uint32_t BAND_HEIGHT = 8;
+    // chunks per occludee test task
+    static constexpr uint32_t TEST_BATCH = 64;
+
+    // occluder selection
+    // projected size = bounding sphere radius / distance
+    static constexpr float MIN_OCCLUDER_SIZE = 0.1f;
+    static constexpr uint32_t MAX_OCCLUDER_TRIANGLES = 64 * 1024;
+
+    // screen space triangle in pixel coordinates (y down), wound so the edge functions are positive inside
+    struct Triangle
+    {
+        // edge functions e(x, y) = a * x + b * y + c, >= 0 inside
+        float a[3], b[3], c[3];
+        // depth plane z(x, y) = za * x + zb * y + zc
+        float za, zb, zc;
+        // pixel bounds, inclusive
+        int minX, minY, maxX, maxY;
+    };
+
+    void transformOccluder(const Scene* scene, uint32_t chunk, std::vector<Triangle>& triangles) const;
+    void addTriangle(const glm::vec4 clip[3], bool doubleSided, std::vector<Triangle>& triangles) const;
+    void rasterize(const Triangle& triangle, int firstRow, int lastRow);
+    bool testBox(const glm::vec3& min, const glm::vec3& max) const;
+
+    uint32_t width = WIDTH;
+    uint32_t height = 0;
+    float aspect = 1.0f;
+
+    // matrix with [0, 1] clip space depth
+    glm::mat4 viewProj = glm::mat4(1.0f);
+
+    // 4 pixels, aligned for SIMD loads and stores
+    struct alignas(16) DepthBlock
+    {
+        float z[4];
+    };
+
+    // post-projection depth, cleared to 1 (far plane)
+    std::vector<DepthBlock> depth;
+
+    // per frame
+    std::vector<uint32_t> occluders;
+    std::vector<std::vector<Triangle>> occluderTriangles; // per occluder
+    std::vector<uint32_t> culledPerTask;
+};
@@ -0,0 +1,133 @@
+#include "Bounds.h"
+
+#include <bx/simd_t.h>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <cassert>
+#include <limits>
+
+constexpr size_t BoundsSoA::LANES;
+
+AABB AABB::around(const float* points, size_t count)
+{
+    using namespace bx;
+
+    // 4 points per iteration, xyz get gathered into one register per axis
+    // bx only has aligned loads and the points are 12 bytes apart
+    simd128_t minX = simd_splat<simd128_t>(std::numeric_limits<float>::max());
+    simd128_t minY = minX, minZ = minX;
+    simd128_t maxX = simd_splat<simd128_t>(-std::numeric_limits<float>::max());
+    simd128_t maxY = maxX, maxZ = maxX;
+
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        const float* p = points + i * 3;
+        const simd128_t x = simd_ld<simd128_t>(p[0], p[3], p[6], p[9]);
+        const simd128_t y = simd_ld<simd128_t>(p[1], p[4], p[7], p[10]);
+        const simd128_t z = simd_ld<simd128_t>(p[2], p[5], p[8], p[11]);
+        minX = simd_min(minX, x);
+        minY = simd_min(minY, y);
+        minZ = simd_min(minZ, z);
+        maxX = simd_max(maxX, x);
+        maxY = simd_max(maxY, y);
+        maxZ = simd_max(maxZ, z);
+    }
+
+    alignas(16) float lanes[6][4];
+    simd_st(lanes[0], minX);
+    simd_st(lanes[1], minY);
+    simd_st(lanes[2], minZ);
+    simd_st(lanes[3], maxX);
+    simd_st(lanes[4], maxY);
+    simd_st(lanes[5], maxZ);
+
+    AABB out;
+    out.min = glm::vec3(std::numeric_limits<float>::max());
+    out.max = glm::vec3(-std::numeric_limits<float>::max());
+    for(size_t lane = 0; lane < 4; lane++)
+    {
+        out.min = glm::min(out.min, glm::vec3(lanes[0][lane], lanes[1][lane], lanes[2][lane]));
+        out.max = glm::max(out.max, glm::vec3(lanes[3][lane], lanes[4][lane], lanes[5][lane]));
+    }
+    for(; i < count; i++)
+    {
+        const glm::vec3 p = glm::vec3(points[i * 3 + 0], points[i * 3 + 1], points[i * 3 + 2]);
+        out.min = glm::min(out.min, p);
+        out.max = glm::max(out.max, p);
+    }
+    return out;
+}
+
+Sphere Sphere::around(const glm::vec3& center, const float* points, size_t count)
+{
+    using namespace bx;
+
+    const simd128_t cx = simd_splat<simd128_t>(center.x);
+    const simd128_t cy = simd_splat<simd128_t>(center.y);
+    const simd128_t cz = simd_splat<simd128_t>(center.z);
+    simd128_t radius2 = simd_zero<simd128_t>();
+
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        const float* p = points + i * 3;
+        const simd128_t dx = simd_sub(simd_ld<simd128_t>(p[0], p[3], p[6], p[9]), cx);
+        const simd128_t dy = simd_sub(simd_ld<simd128_t>(p[1], p[4], p[7], p[10]), cy);
+        const simd128_t dz = simd_sub(simd_ld<simd128_t>(p[2], p[5], p[8], p[11]), cz);
+        const simd128_t d2 = simd_madd(dz, dz, simd_madd(dy, dy, simd_mul(dx, dx)));
+        radius2 = simd_max(radius2, d2);
+    }
+
+    alignas(16) float lanes[4];
+    simd_st(lanes, radius2);
+    float max2 = glm::max(glm::max(lanes[0], lanes[1]), glm::max(lanes[2], lanes[3]));
+    for(; i < count; i++)
+    {
+        const glm::vec3 d = glm::vec3(points[i * 3 + 0], points[i * 3 + 1], points[i * 3 + 2]) - center;
+        max2 = glm::max(max2, glm::dot(d, d));
+    }
+
+    Sphere out;
+    out.center = center;
+    out.radius = glm::sqrt(max2);
+    return out;
+}
+
+bool NormalCone::backfacing(const Sphere& sphere, const glm::vec3& cameraPos) const
+{
+    // cone apex is approximated by the sphere, this is conservative
+    glm::vec3 view = sphere.center - cameraPos;
+    return glm::dot(view, axis) >= cutoff * glm::length(view) + sphere.radius;
+}
+
+void BoundsSoA::resize(size_t count)
+{
+    this->count = count;
+    // unused lanes in the last block are zero-sized and never read back
+    blocks.resize((count + LANES - 1) / LANES, Block());
+}
+
+void BoundsSoA::clear()
+{
+    count = 0;
+    blocks.clear();
+}
+
+void BoundsSoA::set(size_t index, const AABB& aabb, float radius)
+{
+    assert(index < count);
+
+    Block& block = blocks[index / LANES];
+    size_t lane = index % LANES;
+
+    glm::vec3 center = aabb.center();
+    glm::vec3 extents = aabb.extents();
+    block.centerX[lane] = center.x;
+    block.centerY[lane] = center.y;
+    block.centerZ[lane] = center.z;
+    block.extentX[lane] = extents.x;
+    block.extentY[lane] = extents.y;
+    block.extentZ[lane] = extents.z;
+    block.radius[lane] = radius;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <vector>
+
+// axis-aligned bounding box
+struct AABB
+{
+    glm::vec3 min = { 0.0f, 0.0f, 0.0f };
+    glm::vec3 max = { 0.0f, 0.0f, 0.0f };
+
+    glm::vec3 center() const
+    {
+        return min + (max - min) / 2.0f;
+    }
+
+    glm::vec3 extents() const
+    {
+        return (max - min) / 2.0f;
+    }
+
+    // smallest box around count points stored as consecutive xyz floats
+    static AABB around(const float* points, size_t count);
+};
+
+struct Sphere
+{
+    glm::vec3 center = { 0.0f, 0.0f, 0.0f };
+    float radius = 0.0f;
+
+    // smallest sphere with the given center around count points stored as consecutive xyz floats
+    static Sphere around(const glm::vec3& center, const float* points, size_t count);
+};
+
+// cone containing all triangle normals of a surface patch
+// same test as meshopt_computeMeshletBounds in https://github.com/zeux/meshoptimizer
+struct NormalCone
+{
+    glm::vec3 axis = { 0.0f, 0.0f, 1.0f };
+    // sine of the cone half-angle, 1 means the cone can't be used for culling
+    float cutoff = 1.0f;
+
+    // true if all triangles inside the bounding sphere face away from the camera
+    bool backfacing(const Sphere& sphere, const glm::vec3& cameraPos) const;
+};
+
+// bounding volumes in SIMD-friendly structure of arrays layout
+// volumes are grouped in blocks of 4, one per SIMD lane
+// the AABB is stored as center + extents, the sphere shares the center
+class BoundsSoA
+{
+public:
+    static constexpr size_t LANES = 4;
+
+    struct alignas(16) Block
+    {
+        float centerX[LANES];
+        float centerY[LANES];
+        float centerZ[LANES];
+        float extentX[LANES];
+        float extentY[LANES];
+        float extentZ[LANES];
+        float radius[LANES];
+    };
+
+    void resize(size_t count);
+    void clear();
+
+    // sphere center is assumed to be the box center
+    void set(size_t index, const AABB& aabb, float radius);
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    size_t blockCount() const
+    {
+        return blocks.size();
+    }
+
+    const Block* data() const
+    {
+        return blocks.data();
+    }
+
+private:
+    size_t count = 0;
+    std::vector<Block> blocks;
+};
@@ -0,0 +1,1032 @@
+#include "GltfLoader.h"
+
+#include "Util/MappedFile.h"
+#include <assimp/scene.h>
+#include <assimp/mesh.h>
+#include <assimp/material.h>
+#include <assimp/GltfMaterial.h>
+#include <assimp/camera.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/matrix_operation.hpp>
+#include <bx/filepath.h>
+#include <bx/string.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+// GLB header and chunk types
+static constexpr uint32_t GLB_MAGIC = 0x46546C67; // glTF
+static constexpr uint32_t GLB_JSON_CHUNK = 0x4E4F534A;
+static constexpr uint32_t GLB_BIN_CHUNK = 0x004E4942;
+
+// accessor component types
+static constexpr uint32_t BYTE = 5120;
+static constexpr uint32_t UNSIGNED_BYTE = 5121;
+static constexpr uint32_t SHORT = 5122;
+static constexpr uint32_t UNSIGNED_SHORT = 5123;
+static constexpr uint32_t UNSIGNED_INT = 5125;
+static constexpr uint32_t FLOAT = 5126;
+
+// primitive modes, everything after TRIANGLES is a strip or fan
+static constexpr uint32_t TRIANGLES = 4;
+
+// glTF is right-handed, aiProcess_MakeLeftHanded mirrors the z axis
+static const glm::mat4 MIRROR_Z = glm::diagonal4x4(glm::vec4(1.0f, 1.0f, -1.0f, 1.0f));
+
+// non-negative integer or the default if the value is missing
+static size_t integer(const Json& value, size_t def = 0)
+{
+    if(value.isNull())
+        return def;
+    const double number = value.number(-1.0);
+    if(number < 0.0 || number > 9007199254740992.0 || number != std::floor(number))
+        throw std::runtime_error("Invalid index or size");
+    return size_t(number);
+}
+
+static size_t componentSize(uint32_t componentType)
+{
+    switch(componentType)
+    {
+        case BYTE:
+        case UNSIGNED_BYTE:
+            return 1;
+        case SHORT:
+        case UNSIGNED_SHORT:
+            return 2;
+        case UNSIGNED_INT:
+        case FLOAT:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+// normalized integers map to [0, 1] or [-1, 1], KHR_mesh_quantization also allows them unnormalized
+static float readComponent(const uint8_t* data, uint32_t componentType, bool normalized)
+{
+    switch(componentType)
+    {
+        case BYTE:
+        {
+            int8_t value;
+            std::memcpy(&value, data, sizeof(value));
+            return normalized ? std::max(float(value) / 127.0f, -1.0f) : float(value);
+        }
+        case UNSIGNED_BYTE:
+            return normalized ? float(*data) / 255.0f : float(*data);
+        case SHORT:
+        {
+            int16_t value;
+            std::memcpy(&value, data, sizeof(value));
+            return normalized ? std::max(float(value) / 32767.0f, -1.0f) : float(value);
+        }
+        case UNSIGNED_SHORT:
+        {
+            uint16_t value;
+            std::memcpy(&value, data, sizeof(value));
+            return normalized ? float(value) / 65535.0f : float(value);
+        }
+        case UNSIGNED_INT:
+        {
+            uint32_t value;
+            std::memcpy(&value, data, sizeof(value));
+            return float(value);
+        }
+        case FLOAT:
+        default:
+        {
+            float value;
+            std::memcpy(&value, data, sizeof(value));
+            return value;
+        }
+    }
+}
+
+// missing components are left untouched, surplus ones are dropped
+void GltfLoader::readFloats(const Accessor& accessor, float* out, uint32_t stride)
+{
+    const size_t size = componentSize(accessor.componentType);
+    // tightly packed floats in the same layout are copied as they are
+    if(accessor.componentType == FLOAT && accessor.components == stride && accessor.stride == size * stride)
+    {
+        std::memcpy(out, accessor.data, size_t(accessor.count) * accessor.stride);
+        return;
+    }
+
+    const uint32_t components = std::min(accessor.components, stride);
+    for(uint32_t i = 0; i < accessor.count; i++)
+    {
+        const uint8_t* element = accessor.data + i * accessor.stride;
+        for(uint32_t c = 0; c < components; c++)
+        {
+            const uint8_t* component = element + c * size;
+            out[size_t(i) * stride + c] = readComponent(component, accessor.componentType, accessor.normalized);
+        }
+    }
+}
+
+static std::string decodeUri(const std::string& uri)
+{
+    auto hex = [](char c) {
+        if(c >= '0' && c <= '9')
+            return c - '0';
+        if(c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if(c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    };
+    std::string out;
+    for(size_t i = 0; i < uri.size(); i++)
+    {
+        if(uri[i] == '%' && i + 2 < uri.size() && hex(uri[i + 1]) >= 0 && hex(uri[i + 2]) >= 0)
+        {
+            out += char(hex(uri[i + 1]) * 16 + hex(uri[i + 2]));
+            i += 2;
+        }
+        else
+            out += uri[i];
+    }
+    return out;
+}
+
+// data:[<mime type>][;base64],<data>
+// only base64 is allowed by glTF
+static bool isDataUri(const std::string& uri)
+{
+    return uri.compare(0, 5, "data:") == 0;
+}
+
+static std::vector<uint8_t> decodeDataUri(const std::string& uri, std::string& mimeType)
+{
+    const size_t separator = uri.find(";base64,");
+    if(!isDataUri(uri) || separator == std::string::npos)
+        throw std::runtime_error("Data URI is not base64 encoded");
+    mimeType = uri.substr(5, separator - 5);
+
+    std::vector<uint8_t> out;
+    out.reserve((uri.size() - separator) / 4 * 3);
+    uint32_t bits = 0;
+    uint32_t count = 0;
+    for(size_t i = separator + 8; i < uri.size() && uri[i] != '='; i++)
+    {
+        const char c = uri[i];
+        uint32_t value;
+        if(c >= 'A' && c <= 'Z')
+            value = c - 'A';
+        else if(c >= 'a' && c <= 'z')
+            value = c - 'a' + 26;
+        else if(c >= '0' && c <= '9')
+            value = c - '0' + 52;
+        else if(c == '+')
+            value = 62;
+        else if(c == '/')
+            value = 63;
+        else
+            throw std::runtime_error("Invalid base64 data");
+
+        bits = ((bits << 6) | value) & 0xFFFFFF;
+        count += 6;
+        if(count >= 8)
+        {
+            count -= 8;
+            out.push_back(uint8_t(bits >> count));
+        }
+    }
+    return out;
+}
+
+// local transformation of a node, right-handed like the file
+static glm::mat4 nodeMatrix(const Json& node)
+{
+    const Json& matrix = node["matrix"];
+    if(matrix.size() == 16)
+    {
+        // column-major like glm
+        glm::mat4 out;
+        for(int i = 0; i < 16; i++)
+        {
+            out[i / 4][i % 4] = float(matrix[i].number());
+        }
+        return out;
+    }
+
+    const Json& t = node["translation"];
+    const Json& r = node["rotation"];
+    const Json& s = node["scale"];
+    const glm::vec3 translation = t.size() == 3 ? glm::vec3(t[0].number(), t[1].number(), t[2].number())
+                                                : glm::vec3(0.0f);
+    // xyzw in the file, glm takes wxyz
+    const glm::quat rotation = r.size() == 4 ? glm::quat(float(r[3].number()),
+                                                         float(r[0].number()),
+                                                         float(r[1].number()),
+                                                         float(r[2].number()))
+                                             : glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    const glm::vec3 scale = s.size() == 3 ? glm::vec3(s[0].number(), s[1].number(), s[2].number()) : glm::vec3(1.0f);
+    return glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation) *
+           glm::scale(glm::mat4(1.0f), scale);
+}
+
+// area weighted face normals, right-handed like the file
+static void generateNormals(aiMesh* mesh)
+{
+    std::vector<glm::vec3> normals(mesh->mNumVertices, glm::vec3(0.0f));
+    for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+    {
+        const unsigned int* face = mesh->mFaces[i].mIndices;
+        const aiVector3D& a = mesh->mVertices[face[0]];
+        const aiVector3D& b = mesh->mVertices[face[1]];
+        const aiVector3D& c = mesh->mVertices[face[2]];
+        const glm::vec3 normal =
+            glm::cross(glm::vec3(b.x - a.x, b.y - a.y, b.z - a.z), glm::vec3(c.x - a.x, c.y - a.y, c.z - a.z));
+        for(int v = 0; v < 3; v++)
+        {
+            normals[face[v]] += normal;
+        }
+    }
+
+    mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+    for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+    {
+        const float length = glm::length(normals[i]);
+        const glm::vec3 n = length > 0.0f ? normals[i] / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        mesh->mNormals[i] = aiVector3D(n.x, n.y, n.z);
+    }
+}
+
+// per-vertex tangent space from the UV derivatives of the adjacent faces, like aiProcess_CalcTangentSpace
+// meshes without UVs get an arbitrary tangent perpendicular to the normal
+static void generateTangents(aiMesh* mesh)
+{
+    std::vector<glm::vec3> tangents(mesh->mNumVertices, glm::vec3(0.0f));
+    std::vector<glm::vec3> bitangents(mesh->mNumVertices, glm::vec3(0.0f));
+    const aiVector3D* uvs = mesh->mTextureCoords[0];
+    if(uvs)
+    {
+        for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+        {
+            const unsigned int* face = mesh->mFaces[i].mIndices;
+            const aiVector3D& p0 = mesh->mVertices[face[0]];
+            const aiVector3D& p1 = mesh->mVertices[face[1]];
+            const aiVector3D& p2 = mesh->mVertices[face[2]];
+            const glm::vec3 e1 = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+            const glm::vec3 e2 = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+            // v points down in glTF but the bitangent follows v pointing up (bitangent = cross(normal, tangent) * w),
+            // assimp flips v around aiProcess_CalcTangentSpace for the same result
+            const glm::vec2 d1 = { uvs[face[1]].x - uvs[face[0]].x, uvs[face[0]].y - uvs[face[1]].y };
+            const glm::vec2 d2 = { uvs[face[2]].x - uvs[face[0]].x, uvs[face[0]].y - uvs[face[2]].y };
+            const float det = d1.x * d2.y - d2.x * d1.y;
+            if(std::abs(det) < 1e-12f)
+                continue;
+            const glm::vec3 tangent = (e1 * d2.y - e2 * d1.y) / det;
+            const glm::vec3 bitangent = (e2 * d1.x - e1 * d2.x) / det;
+            for(int v = 0; v < 3; v++)
+            {
+                tangents[face[v]] += tangent;
+                bitangents[face[v]] += bitangent;
+            }
+        }
+    }
+
+    mesh->mTangents = new aiVector3D[mesh->mNumVertices];
+    mesh->mBitangents = new aiVector3D[mesh->mNumVertices];
+    for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+    {
+        const glm::vec3 n = { mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z };
+        // Gram-Schmidt, keep the handedness of the accumulated bitangent
+        glm::vec3 t = tangents[i] - n * glm::dot(n, tangents[i]);
+        if(glm::dot(t, t) < 1e-12f)
+            t = glm::cross(n, std::abs(n.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f));
+        t = glm::normalize(t);
+        glm::vec3 b = glm::cross(n, t);
+        if(glm::dot(b, bitangents[i]) < 0.0f)
+            b = -b;
+        mesh->mTangents[i] = aiVector3D(t.x, t.y, t.z);
+        mesh->mBitangents[i] = aiVector3D(b.x, b.y, b.z);
+    }
+}
+
+// negate z of everything, see MIRROR_Z
+static void makeLeftHanded(aiMesh* mesh)
+{
+    aiVector3D* streams[] = { mesh->mVertices, mesh->mNormals, mesh->mTangents, mesh->mBitangents };
+    for(aiVector3D* stream : streams)
+    {
+        for(unsigned int i = 0; stream && i < mesh->mNumVertices; i++)
+        {
+            stream[i].z = -stream[i].z;
+        }
+    }
+}
+
+// same as Scene::bakeInstances
+static void transformMesh(aiMesh* mesh, const glm::mat4& model)
+{
+    const glm::mat3 normalMat = glm::transpose(glm::adjugate(glm::mat3(model)));
+    for(unsigned int v = 0; v < mesh->mNumVertices; v++)
+    {
+        aiVector3D& pos = mesh->mVertices[v];
+        const glm::vec3 p = glm::vec3(model * glm::vec4(pos.x, pos.y, pos.z, 1.0f));
+        pos = aiVector3D(p.x, p.y, p.z);
+        aiVector3D& nrm = mesh->mNormals[v];
+        const glm::vec3 n = glm::normalize(normalMat * glm::vec3(nrm.x, nrm.y, nrm.z));
+        nrm = aiVector3D(n.x, n.y, n.z);
+        aiVector3D& tan = mesh->mTangents[v];
+        const glm::vec3 t = glm::normalize(glm::mat3(model) * glm::vec3(tan.x, tan.y, tan.z));
+        tan = aiVector3D(t.x, t.y, t.z);
+        aiVector3D& bit = mesh->mBitangents[v];
+        const glm::vec3 b = glm::normalize(glm::mat3(model) * glm::vec3(bit.x, bit.y, bit.z));
+        bit = aiVector3D(b.x, b.y, b.z);
+    }
+}
+
+static aiMesh* copyMesh(const aiMesh* mesh)
+{
+    auto copy = [mesh](const aiVector3D* stream) -> aiVector3D* {
+        if(!stream)
+            return nullptr;
+        aiVector3D* out = new aiVector3D[mesh->mNumVertices];
+        std::memcpy(out, stream, mesh->mNumVertices * sizeof(aiVector3D));
+        return out;
+    };
+
+    std::unique_ptr<aiMesh> out(new aiMesh());
+    out->mName = mesh->mName;
+    out->mPrimitiveTypes = mesh->mPrimitiveTypes;
+    out->mMaterialIndex = mesh->mMaterialIndex;
+    out->mNumVertices = mesh->mNumVertices;
+    out->mVertices = copy(mesh->mVertices);
+    out->mNormals = copy(mesh->mNormals);
+    out->mTangents = copy(mesh->mTangents);
+    out->mBitangents = copy(mesh->mBitangents);
+    out->mTextureCoords[0] = copy(mesh->mTextureCoords[0]);
+    out->mNumUVComponents[0] = mesh->mNumUVComponents[0];
+    out->mFaces = new aiFace[mesh->mNumFaces];
+    out->mNumFaces = mesh->mNumFaces;
+    for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+    {
+        out->mFaces[i].mNumIndices = 3;
+        out->mFaces[i].mIndices = new unsigned int[3];
+        std::memcpy(out->mFaces[i].mIndices, mesh->mFaces[i].mIndices, 3 * sizeof(unsigned int));
+    }
+    return out.release();
+}
+
+// pointers in aiScene and aiNode arrays, ownership moves to the array
+template<typename T>
+static T** releaseAll(std::vector<std::unique_ptr<T>>& objects)
+{
+    if(objects.empty())
+        return nullptr;
+    T** out = new T*[objects.size()];
+    for(size_t i = 0; i < objects.size(); i++)
+    {
+        out[i] = objects[i].release();
+    }
+    return out;
+}
+
+GltfLoader::~GltfLoader()
+{
+    for(MappedFile* mapped : mappings)
+    {
+        mapped->release();
+    }
+}
+
+bool GltfLoader::handles(const char* file)
+{
+    const bx::StringView ext = bx::FilePath(file).getExt();
+    return bx::strCmpI(ext, ".gltf") == 0 || bx::strCmpI(ext, ".glb") == 0;
+}
+
+aiScene* GltfLoader::load(const char* file, bool preTransform, uint32_t maxVertices)
+{
+    this->maxVertices = maxVertices;
+    const bx::FilePath path(file);
+    const bx::StringView parent = path.getPath();
+    dir.assign(parent.getPtr(), parent.getLength());
+    parse(file);
+    checkExtensions();
+    loadBuffers();
+    embeddedImages.assign(document["images"].size(), -1);
+
+    // primitives without a material get the default material after the file's materials
+    std::vector<std::unique_ptr<aiMaterial>> materials;
+    const Json& materialList = document["materials"];
+    for(size_t i = 0; i < materialList.size(); i++)
+    {
+        materials.emplace_back(loadMaterial(materialList[i]));
+    }
+    const uint32_t defaultMaterial = uint32_t(materials.size());
+
+    // one aiMesh per primitive
+    std::vector<std::unique_ptr<aiMesh>> meshes;
+    const Json& meshList = document["meshes"];
+    std::vector<std::vector<uint32_t>> meshPrimitives(meshList.size());
+    bool usesDefaultMaterial = false;
+    for(size_t i = 0; i < meshList.size(); i++)
+    {
+        const Json& primitives = meshList[i]["primitives"];
+        for(size_t p = 0; p < primitives.size(); p++)
+        {
+            aiMesh* mesh = loadPrimitive(primitives[p], defaultMaterial);
+            if(!mesh)
+                continue;
+            mesh->mName.Set(meshList[i]["name"].string().c_str());
+            usesDefaultMaterial = usesDefaultMaterial || mesh->mMaterialIndex == defaultMaterial;
+            meshPrimitives[i].push_back(uint32_t(meshes.size()));
+            meshes.emplace_back(mesh);
+        }
+    }
+    if(usesDefaultMaterial || materials.empty())
+        materials.emplace_back(loadMaterial(Json()));
+
+    std::unique_ptr<aiScene> scene(new aiScene());
+    scene->mRootNode = new aiNode();
+    scene->mRootNode->mName.Set("root");
+
+    // nodes of the default scene, or all root nodes if there is none
+    const Json& nodes = document["nodes"];
+    std::vector<size_t> roots;
+    const Json& scenes = document["scenes"];
+    if(scenes.size() > 0)
+    {
+        const Json& sceneNodes = scenes[integer(document["scene"])]["nodes"];
+        for(size_t i = 0; i < sceneNodes.size(); i++)
+        {
+            roots.push_back(integer(sceneNodes[i]));
+        }
+    }
+    else
+    {
+        std::vector<bool> isChild(nodes.size(), false);
+        for(size_t i = 0; i < nodes.size(); i++)
+        {
+            const Json& children = nodes[i]["children"];
+            for(size_t c = 0; c < children.size(); c++)
+            {
+                if(integer(children[c]) < nodes.size())
+                    isChild[integer(children[c])] = true;
+            }
+        }
+        for(size_t i = 0; i < nodes.size(); i++)
+        {
+            if(!isChild[i])
+                roots.push_back(i);
+        }
+    }
+
+    aiNode* graph = preTransform ? nullptr : scene->mRootNode;
+    if(graph && !roots.empty())
+        graph->mChildren = new aiNode*[roots.size()];
+    for(size_t root : roots)
+    {
+        addNode(root, glm::mat4(1.0f), graph, 0);
+    }
+
+    if(preTransform)
+    {
+        // a mesh per use in world space like aiProcess_PreTransformVertices, unused meshes are dropped
+        // the last use takes the original mesh, all others get a copy
+        std::vector<uint32_t> remaining(meshes.size(), 0);
+        for(const NodeUse& use : meshUses)
+        {
+            for(uint32_t primitive : meshPrimitives[use.index])
+            {
+                remaining[primitive]++;
+            }
+        }
+        std::vector<std::unique_ptr<aiMesh>> transformed;
+        for(const NodeUse& use : meshUses)
+        {
+            for(uint32_t primitive : meshPrimitives[use.index])
+            {
+                aiMesh* mesh = --remaining[primitive] == 0 ? meshes[primitive].release()
+                                                           : copyMesh(meshes[primitive].get());
+                transformed.emplace_back(mesh);
+                transformMesh(mesh, use.world);
+            }
+        }
+        meshes = std::move(transformed);
+
+        aiNode* root = scene->mRootNode;
+        if(!meshes.empty())
+            root->mMeshes = new unsigned int[meshes.size()];
+        root->mNumMeshes = unsigned(meshes.size());
+        for(unsigned int i = 0; i < root->mNumMeshes; i++)
+        {
+            root->mMeshes[i] = i;
+        }
+    }
+    else
+    {
+        // nodes reference the primitives of their mesh
+        for(const NodeUse& use : meshUses)
+        {
+            const std::vector<uint32_t>& primitives = meshPrimitives[use.index];
+            if(primitives.empty())
+                continue;
+            use.graphNode->mMeshes = new unsigned int[primitives.size()];
+            use.graphNode->mNumMeshes = unsigned(primitives.size());
+            std::copy(primitives.begin(), primitives.end(), use.graphNode->mMeshes);
+        }
+    }
+
+    // perspective cameras looking down -z, mirrored to +z
+    // like aiProcess_PreTransformVertices, baked cameras get their node transformation applied
+    std::vector<std::unique_ptr<aiCamera>> cameras;
+    for(const NodeUse& use : cameraUses)
+    {
+        const Json& camera = document["cameras"][size_t(use.index)];
+        const Json& perspective = camera["perspective"];
+        if(camera["type"].string() != "perspective" || !perspective.isObject())
+            continue;
+
+        const glm::mat4 world = preTransform ? use.world : glm::mat4(1.0f);
+        const glm::vec3 position = glm::vec3(world * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        const glm::vec3 lookAt = glm::mat3(world) * glm::vec3(0.0f, 0.0f, 1.0f);
+        const glm::vec3 up = glm::mat3(world) * glm::vec3(0.0f, 1.0f, 0.0f);
+
+        std::unique_ptr<aiCamera> out(new aiCamera());
+        out->mName.Set(use.node.c_str());
+        out->mPosition = aiVector3D(position.x, position.y, position.z);
+        out->mLookAt = aiVector3D(lookAt.x, lookAt.y, lookAt.z);
+        out->mUp = aiVector3D(up.x, up.y, up.z);
+        // Scene::loadCamera turns the horizontal half angle back into the vertical angle, with 16:9 by default
+        const float aspect = float(perspective["aspectRatio"].number(0.0));
+        const float yfov = float(perspective["yfov"].number(glm::radians(60.0)));
+        out->mAspect = aspect;
+        out->mHorizontalFOV = std::atan(std::tan(yfov * 0.5f) * (aspect > 0.0f ? aspect : 16.0f / 9.0f));
+        out->mClipPlaneNear = float(perspective["znear"].number(0.1));
+        out->mClipPlaneFar = float(perspective["zfar"].number(1000.0));
+        cameras.push_back(std::move(out));
+    }
+
+    scene->mNumMeshes = unsigned(meshes.size());
+    scene->mMeshes = releaseAll(meshes);
+    scene->mNumMaterials = unsigned(materials.size());
+    scene->mMaterials = releaseAll(materials);
+    scene->mNumTextures = unsigned(textures.size());
+    scene->mTextures = releaseAll(textures);
+    scene->mNumCameras = unsigned(cameras.size());
+    scene->mCameras = releaseAll(cameras);
+    return scene.release();
+}
+
+void GltfLoader::parse(const char* file)
+{
+    MappedFile* mapped = MappedFile::open(file);
+    if(!mapped)
+        throw std::runtime_error("Can't open file or file is empty");
+    mappings.push_back(mapped);
+
+    const uint8_t* data = mapped->data();
+    const size_t size = mapped->size();
+    const char* json = (const char*)data;
+    size_t jsonSize = size;
+
+    // GLB: 12 byte header, then chunks with a length and type each
+    // the first chunk is JSON, an optional second chunk holds the binary buffer
+    uint32_t header[3] = {};
+    if(size >= sizeof(header))
+        std::memcpy(header, data, sizeof(header));
+    if(header[0] == GLB_MAGIC)
+    {
+        if(header[1] != 2)
+            throw std::runtime_error("Unsupported GLB version");
+        const size_t length = std::min(size_t(header[2]), size);
+        json = nullptr;
+        for(size_t offset = sizeof(header); offset + 8 <= length;)
+        {
+            uint32_t chunk[2];
+            std::memcpy(chunk, data + offset, sizeof(chunk));
+            offset += sizeof(chunk);
+            if(chunk[0] > length - offset)
+                throw std::runtime_error("GLB chunk is truncated");
+            if(chunk[1] == GLB_JSON_CHUNK && !json)
+            {
+                json = (const char*)data + offset;
+                jsonSize = chunk[0];
+            }
+            else if(chunk[1] == GLB_BIN_CHUNK && !binary.data)
+            {
+                binary.data = data + offset;
+                binary.size = chunk[0];
+            }
+            // chunks are 4-byte aligned
+            offset += (size_t(chunk[0]) + 3) & ~size_t(3);
+        }
+        if(!json)
+            throw std::runtime_error("GLB file has no JSON chunk");
+    }
+
+    document = Json::parse(json, jsonSize);
+    const std::string& version = document["asset"]["version"].string();
+    if(version.compare(0, 2, "2.") != 0)
+        throw std::runtime_error("Unsupported glTF version " + version);
+}
+
+void GltfLoader::checkExtensions() const
+{
+    // only changes how accessors are interpreted, everything else would need its own decoder
+    // a required KHR_texture_basisu means textures have no fallback image, bimg can't transcode Basis Universal
+    const Json& required = document["extensionsRequired"];
+    for(size_t i = 0; i < required.size(); i++)
+    {
+        const std::string& extension = required[i].string();
+        if(extension != "KHR_mesh_quantization")
+            throw std::runtime_error("Unsupported extension " + extension);
+    }
+
+    // applied by aiProcess_TransformUVCoords on the assimp path
+    const Json& used = document["extensionsUsed"];
+    for(size_t i = 0; i < used.size(); i++)
+    {
+        if(used[i].string() == "KHR_texture_transform")
+            throw std::runtime_error("Unsupported extension KHR_texture_transform");
+    }
+}
+
+void GltfLoader::loadBuffers()
+{
+    const Json& list = document["buffers"];
+    for(size_t i = 0; i < list.size(); i++)
+    {
+        const Json& json = list[i];
+        const std::string& uri = json["uri"].string();
+        const size_t byteLength = integer(json["byteLength"]);
+
+        Buffer buffer;
+        if(uri.empty())
+        {
+            // the first buffer of a GLB file is the binary chunk
+            if(i != 0 || !binary.data)
+                throw std::runtime_error("Buffer has no data");
+            buffer = binary;
+        }
+        else if(isDataUri(uri))
+        {
+            std::string mimeType;
+            decodedBuffers.push_back(decodeDataUri(uri, mimeType));
+            buffer.data = decodedBuffers.back().data();
+            buffer.size = decodedBuffers.back().size();
+        }
+        else
+        {
+            const std::string path = dir + decodeUri(uri);
+            MappedFile* mapped = MappedFile::open(path.c_str());
+            if(!mapped)
+                throw std::runtime_error("Can't open buffer " + path);
+            mappings.push_back(mapped);
+            buffer.data = mapped->data();
+            buffer.size = mapped->size();
+        }
+
+        if(buffer.size < byteLength)
+            throw std::runtime_error("Buffer is truncated");
+        buffer.size = byteLength;
+        buffers.push_back(buffer);
+    }
+}
+
+GltfLoader::Buffer GltfLoader::bufferView(const Json& index) const
+{
+    const Json& view = document["bufferViews"][integer(index, SIZE_MAX)];
+    if(!view.isObject())
+        throw std::runtime_error("Invalid buffer view");
+    const size_t buffer = integer(view["buffer"], SIZE_MAX);
+    if(buffer >= buffers.size())
+        throw std::runtime_error("Invalid buffer");
+
+    const size_t offset = integer(view["byteOffset"]);
+    const size_t length = integer(view["byteLength"]);
+    if(offset > buffers[buffer].size || length > buffers[buffer].size - offset)
+        throw std::runtime_error("Buffer view is out of bounds");
+    Buffer out;
+    out.data = buffers[buffer].data + offset;
+    out.size = length;
+    return out;
+}
+
+GltfLoader::Accessor GltfLoader::accessor(const Json& index) const
+{
+    const Json& json = document["accessors"][integer(index, SIZE_MAX)];
+    if(!json.isObject())
+        throw std::runtime_error("Invalid accessor");
+    // sparse accessors patch values, accessors without a buffer view are all zeros
+    if(json.has("sparse") || !json.has("bufferView"))
+        throw std::runtime_error("Sparse accessors are not supported");
+
+    Accessor out;
+    out.count = uint32_t(std::min(integer(json["count"]), size_t(UINT32_MAX)));
+    out.componentType = uint32_t(integer(json["componentType"]));
+    out.normalized = json["normalized"].boolean();
+    const std::string& type = json["type"].string();
+    out.components = type == "SCALAR" ? 1 : type == "VEC2" ? 2 : type == "VEC3" ? 3 : type == "VEC4" ? 4 : 0;
+    const size_t elementSize = out.components * componentSize(out.componentType);
+    if(elementSize == 0)
+        throw std::runtime_error("Unsupported accessor type");
+
+    const Json& view = document["bufferViews"][integer(json["bufferView"])];
+    const Buffer data = bufferView(json["bufferView"]);
+    out.stride = integer(view["byteStride"], elementSize);
+    const size_t offset = integer(json["byteOffset"]);
+    if(out.stride < elementSize || offset > data.size ||
+       (out.count > 0 && (data.size - offset < elementSize ||
+                          size_t(out.count - 1) * out.stride > data.size - offset - elementSize)))
+        throw std::runtime_error("Accessor is out of bounds");
+    out.data = data.data + offset;
+    return out;
+}
+
+aiMesh* GltfLoader::loadPrimitive(const Json& primitive, uint32_t defaultMaterial) const
+{
+    const size_t mode = integer(primitive["mode"], TRIANGLES);
+    if(mode < TRIANGLES)
+        return nullptr;
+    if(mode != TRIANGLES)
+        throw std::runtime_error("Triangle strips and fans are not supported");
+
+    const Json& attributes = primitive["attributes"];
+    const Accessor positions = accessor(attributes["POSITION"]);
+    if(positions.components != 3)
+        throw std::runtime_error("Invalid POSITION accessor");
+    if(positions.count == 0)
+        return nullptr;
+    if(positions.count > maxVertices)
+        throw std::runtime_error("Primitive has too many vertices");
+
+    std::unique_ptr<aiMesh> mesh(new aiMesh());
+    mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+    mesh->mNumVertices = positions.count;
+    mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+    readFloats(positions, &mesh->mVertices[0].x, 3);
+
+    mesh->mMaterialIndex = unsigned(integer(primitive["material"], defaultMaterial));
+    if(mesh->mMaterialIndex > defaultMaterial)
+        throw std::runtime_error("Invalid material");
+
+    // unindexed primitives use every vertex once
+    std::vector<unsigned int> indices;
+    if(primitive.has("indices"))
+    {
+        const Accessor indexAccessor = accessor(primitive["indices"]);
+        if(indexAccessor.components != 1 || indexAccessor.normalized ||
+           (indexAccessor.componentType != UNSIGNED_BYTE && indexAccessor.componentType != UNSIGNED_SHORT &&
+            indexAccessor.componentType != UNSIGNED_INT))
+            throw std::runtime_error("Invalid index accessor");
+        indices.resize(indexAccessor.count);
+        const size_t size = componentSize(indexAccessor.componentType);
+        for(uint32_t i = 0; i < indexAccessor.count; i++)
+        {
+            uint32_t index = 0;
+            std::memcpy(&index, indexAccessor.data + i * indexAccessor.stride, size); // little-endian
+            if(index >= mesh->mNumVertices)
+                throw std::runtime_error("Index is out of range");
+            indices[i] = index;
+        }
+    }
+    else
+    {
+        indices.resize(mesh->mNumVertices);
+        for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+        {
+            indices[i] = i;
+        }
+    }
+
+    mesh->mNumFaces = unsigned(indices.size() / 3);
+    if(mesh->mNumFaces == 0)
+        return nullptr;
+    mesh->mFaces = new aiFace[mesh->mNumFaces];
+    for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+    {
+        aiFace& face = mesh->mFaces[i];
+        face.mNumIndices = 3;
+        face.mIndices = new unsigned int[3];
+        std::memcpy(face.mIndices, &indices[i * 3], 3 * sizeof(unsigned int));
+    }
+
+    // only the first UV set is used
+    if(attributes.has("TEXCOORD_0"))
+    {
+        const Accessor uvs = accessor(attributes["TEXCOORD_0"]);
+        if(uvs.components != 2 || uvs.count != mesh->mNumVertices)
+            throw std::runtime_error("Invalid TEXCOORD_0 accessor");
+        mesh->mTextureCoords[0] = new aiVector3D[mesh->mNumVertices];
+        mesh->mNumUVComponents[0] = 2;
+        readFloats(uvs, &mesh->mTextureCoords[0][0].x, 3);
+    }
+
+    if(attributes.has("NORMAL"))
+    {
+        const Accessor normals = accessor(attributes["NORMAL"]);
+        if(normals.components != 3 || normals.count != mesh->mNumVertices)
+            throw std::runtime_error("Invalid NORMAL accessor");
+        mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+        readFloats(normals, &mesh->mNormals[0].x, 3);
+        // quantized normals are only roughly unit length
+        if(normals.componentType != FLOAT)
+        {
+            for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+            {
+                aiVector3D& n = mesh->mNormals[i];
+                const glm::vec3 normalized = glm::normalize(glm::vec3(n.x, n.y, n.z));
+                n = aiVector3D(normalized.x, normalized.y, normalized.z);
+            }
+        }
+    }
+    else
+        generateNormals(mesh.get());
+
+    // w is the handedness of the bitangent
+    if(attributes.has("TANGENT"))
+    {
+        const Accessor tangents = accessor(attributes["TANGENT"]);
+        if(tangents.components != 4 || tangents.count != mesh->mNumVertices)
+            throw std::runtime_error("Invalid TANGENT accessor");
+        std::vector<glm::vec4> values(mesh->mNumVertices);
+        readFloats(tangents, &values[0].x, 4);
+        mesh->mTangents = new aiVector3D[mesh->mNumVertices];
+        mesh->mBitangents = new aiVector3D[mesh->mNumVertices];
+        for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+        {
+            const glm::vec3 n = { mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z };
+            const glm::vec3 t = glm::normalize(glm::vec3(values[i]));
+            const glm::vec3 b = glm::cross(n, t) * (values[i].w < 0.0f ? -1.0f : 1.0f);
+            mesh->mTangents[i] = aiVector3D(t.x, t.y, t.z);
+            mesh->mBitangents[i] = aiVector3D(b.x, b.y, b.z);
+        }
+    }
+    else
+        generateTangents(mesh.get());
+
+    makeLeftHanded(mesh.get());
+    return mesh.release();
+}
+
+aiMaterial* GltfLoader::loadMaterial(const Json& material)
+{
+    // every property is set so Scene::loadMaterial doesn't need to know the glTF defaults
+    std::unique_ptr<aiMaterial> out(new aiMaterial());
+
+    aiString alphaMode(material.has("alphaMode") ? material["alphaMode"].string().c_str() : "OPAQUE");
+    out->AddProperty(&alphaMode, AI_MATKEY_GLTF_ALPHAMODE);
+    const int twoSided = material["doubleSided"].boolean() ? 1 : 0;
+    out->AddProperty(&twoSided, 1, AI_MATKEY_TWOSIDED);
+
+    const Json& pbr = material["pbrMetallicRoughness"];
+    const Json& baseColor = pbr["baseColorFactor"];
+    aiColor4D baseColorFactor;
+    baseColorFactor.r = float(baseColor[0].number(1.0));
+    baseColorFactor.g = float(baseColor[1].number(1.0));
+    baseColorFactor.b = float(baseColor[2].number(1.0));
+    baseColorFactor.a = float(baseColor[3].number(1.0));
+    out->AddProperty(&baseColorFactor, 1, AI_MATKEY_BASE_COLOR);
+    addTexture(out.get(), pbr["baseColorTexture"], AI_MATKEY_BASE_COLOR_TEXTURE);
+
+    const ai_real metallicFactor = ai_real(pbr["metallicFactor"].number(1.0));
+    out->AddProperty(&metallicFactor, 1, AI_MATKEY_METALLIC_FACTOR);
+    const ai_real roughnessFactor = ai_real(pbr["roughnessFactor"].number(1.0));
+    out->AddProperty(&roughnessFactor, 1, AI_MATKEY_ROUGHNESS_FACTOR);
+    addTexture(out.get(),
+               pbr["metallicRoughnessTexture"],
+               AI_MATKEY_GLTF_PBRMETALLICROUGHNESS_METALLICROUGHNESS_TEXTURE);
+
+    const Json& normalTexture = material["normalTexture"];
+    addTexture(out.get(), normalTexture, aiTextureType_NORMALS, 0);
+    const ai_real normalScale = ai_real(normalTexture["scale"].number(1.0));
+    out->AddProperty(&normalScale, 1, AI_MATKEY_GLTF_TEXTURE_SCALE(aiTextureType_NORMALS, 0));
+
+    // assimp puts the occlusion texture into the lightmap slot
+    const Json& occlusionTexture = material["occlusionTexture"];
+    addTexture(out.get(), occlusionTexture, aiTextureType_LIGHTMAP, 0);
+    const ai_real occlusionStrength = ai_real(occlusionTexture["strength"].number(1.0));
+    out->AddProperty(&occlusionStrength, 1, AI_MATKEY_GLTF_TEXTURE_STRENGTH(aiTextureType_LIGHTMAP, 0));
+
+    const Json& emissive = material["emissiveFactor"];
+    aiColor3D emissiveFactor;
+    emissiveFactor.r = float(emissive[0].number(0.0));
+    emissiveFactor.g = float(emissive[1].number(0.0));
+    emissiveFactor.b = float(emissive[2].number(0.0));
+    out->AddProperty(&emissiveFactor, 1, AI_MATKEY_COLOR_EMISSIVE);
+    addTexture(out.get(), material["emissiveTexture"], aiTextureType_EMISSIVE, 0);
+
+    return out.release();
+}
+
+void GltfLoader::addTexture(aiMaterial* material, const Json& textureInfo, unsigned int type, unsigned int index)
+{
+    if(!textureInfo.isObject())
+        return;
+
+    const Json& texture = document["textures"][integer(textureInfo["index"], SIZE_MAX)];
+    if(!texture.isObject())
+        throw std::runtime_error("Invalid texture");
+    // optional KHR_texture_basisu keeps a PNG or JPEG in source for viewers that can't transcode KTX2
+    if(!texture.has("source"))
+        throw std::runtime_error("Texture has no image bimg can decode");
+
+    const size_t image = integer(texture["source"]);
+    const Json& json = document["images"][image];
+    if(!json.isObject())
+        throw std::runtime_error("Invalid image");
+
+    aiString path;
+    const std::string& uri = json["uri"].string();
+    if(!uri.empty() && !isDataUri(uri))
+        path.Set(decodeUri(uri).c_str());
+    else
+    {
+        // embedded images are decoded by Scene from the aiTexture
+        if(embeddedImages[image] < 0)
+        {
+            embeddedImages[image] = int32_t(textures.size());
+            textures.emplace_back(loadEmbeddedImage(json));
+        }
+        path.Set(("*" + std::to_string(embeddedImages[image])).c_str());
+    }
+    material->AddProperty(&path, AI_MATKEY_TEXTURE((aiTextureType)type, index));
+}
+
+aiTexture* GltfLoader::loadEmbeddedImage(const Json& image) const
+{
+    std::string mimeType = image["mimeType"].string();
+    std::vector<uint8_t> decoded;
+    Buffer data;
+    if(image.has("bufferView"))
+        data = bufferView(image["bufferView"]);
+    else
+    {
+        decoded = decodeDataUri(image["uri"].string(), mimeType);
+        data.data = decoded.data();
+        data.size = decoded.size();
+    }
+    if(data.size == 0 || data.size > UINT32_MAX)
+        throw std::runtime_error("Invalid embedded image");
+
+    // compressed images have a height of 0 and their size in mWidth
+    std::unique_ptr<aiTexture> texture(new aiTexture());
+    texture->mWidth = unsigned(data.size);
+    texture->mHeight = 0;
+    texture->pcData = new aiTexel[(data.size + sizeof(aiTexel) - 1) / sizeof(aiTexel)];
+    std::memcpy(texture->pcData, data.data, data.size);
+    const char* hint = mimeType == "image/png"    ? "png"
+                       : mimeType == "image/jpeg" ? "jpg"
+                       : mimeType == "image/ktx2" ? "ktx2"
+                                                  : "";
+    bx::strCopy(texture->achFormatHint, sizeof(texture->achFormatHint), hint);
+    return texture.release();
+}
+
+void GltfLoader::addNode(size_t index, const glm::mat4& parentWorld, aiNode* parent, uint32_t depth)
+{
+    const Json& nodes = document["nodes"];
+    const Json& node = nodes[index];
+    // a hierarchy deeper than the number of nodes has a cycle
+    if(!node.isObject() || depth > nodes.size())
+        throw std::runtime_error("Invalid node hierarchy");
+
+    // S * M * S is the left-handed version of M
+    const glm::mat4 local = MIRROR_Z * nodeMatrix(node) * MIRROR_Z;
+    const glm::mat4 world = parentWorld * local;
+    // cameras are found by node name
+    std::string name = node["name"].string();
+    if(name.empty())
+        name = "node" + std::to_string(index);
+
+    aiNode* out = nullptr;
+    const Json& children = node["children"];
+    if(parent)
+    {
+        // the parent's child array has room for all of its children
+        out = new aiNode();
+        out->mName.Set(name.c_str());
+        out->mParent = parent;
+        parent->mChildren[parent->mNumChildren++] = out;
+        const glm::mat4 transposed = glm::transpose(local); // aiMatrix4x4 is row-major
+        std::memcpy(&out->mTransformation.a1, glm::value_ptr(transposed), sizeof(transposed));
+        if(children.size() > 0)
+            out->mChildren = new aiNode*[children.size()];
+    }
+
+    if(node.has("mesh"))
+    {
+        const size_t mesh = integer(node["mesh"]);
+        if(mesh >= document["meshes"].size())
+            throw std::runtime_error("Invalid mesh");
+        meshUses.push_back({ uint32_t(mesh), name, world, out });
+    }
+    if(node.has("camera"))
+        cameraUses.push_back({ uint32_t(integer(node["camera"])), name, world, out });
+
+    for(size_t i = 0; i < children.size(); i++)
+    {
+        addNode(integer(children[i]), world, out, depth + 1);
+    }
+}
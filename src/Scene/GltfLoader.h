@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Util/Json.h"
+#include <glm/matrix.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct aiScene;
+struct aiNode;
+struct aiMesh;
+struct aiMaterial;
+struct aiTexture;
+class MappedFile;
+
+// reads glTF 2.0 files (.gltf and .glb) straight into an aiScene, without assimp's importer and post-processing
+// the scene looks like what Scene gets from assimp with its import flags: left-handed, triangles only, with normals,
+// tangents and bitangents, UVs with the origin in the top left
+// accessors are read straight from the memory mapped buffers, KHR_mesh_quantization accessors are dequantized
+// embedded images become aiTextures referenced as *index like assimp does it
+// bimg can't transcode Basis Universal, textures with an optional KHR_texture_basisu image use their fallback image
+// and files that require the extension aren't supported
+// load throws std::runtime_error for files it doesn't support, Scene imports those with assimp
+class GltfLoader
+{
+public:
+    ~GltfLoader();
+
+    // .gltf or .glb extension
+    static bool handles(const char* file);
+
+    // preTransform bakes node transformations into a mesh per node like aiProcess_PreTransformVertices,
+    // otherwise every mesh is kept once and the node graph references it
+    // primitives with more than maxVertices vertices throw, there is no aiProcess_SplitLargeMeshes
+    // meshes aren't merged like with aiProcess_OptimizeMeshes, one aiMesh per primitive
+    // the caller owns the returned scene
+    aiScene* load(const char* file, bool preTransform, uint32_t maxVertices = UINT32_MAX);
+
+private:
+    struct Buffer
+    {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+    };
+
+    // typed view into a buffer
+    struct Accessor
+    {
+        const uint8_t* data = nullptr;
+        uint32_t count = 0;
+        uint32_t components = 0;
+        uint32_t componentType = 0;
+        bool normalized = false;
+        size_t stride = 0;
+    };
+
+    // node of the default scene using a mesh or camera, world transformation is left-handed
+    struct NodeUse
+    {
+        uint32_t index; // mesh or camera
+        std::string node;
+        glm::mat4 world;
+        // node in the scene's node graph, nullptr if the graph isn't kept
+        aiNode* graphNode;
+    };
+
+    Json document;
+    uint32_t maxVertices = UINT32_MAX;
+    // directory of the glTF file, relative URIs start here
+    std::string dir;
+    // the glTF file and external buffers, released by the destructor
+    std::vector<MappedFile*> mappings;
+    // GLB binary chunk
+    Buffer binary;
+    std::vector<Buffer> buffers;
+    // buffers from data URIs
+    std::vector<std::vector<uint8_t>> decodedBuffers;
+    // image index -> embedded texture index, -1 until the image is used
+    std::vector<int32_t> embeddedImages;
+    std::vector<std::unique_ptr<aiTexture>> textures;
+    std::vector<NodeUse> meshUses;
+    std::vector<NodeUse> cameraUses;
+
+    void parse(const char* file);
+    // throws for required extensions that change how the data is read
+    void checkExtensions() const;
+    void loadBuffers();
+    Accessor accessor(const Json& index) const;
+    Buffer bufferView(const Json& index) const;
+    // count elements as floats into out, stride is in floats
+    static void readFloats(const Accessor& accessor, float* out, uint32_t stride);
+
+    // returns nullptr for points and lines, they're dropped like with AI_CONFIG_PP_SBP_REMOVE
+    aiMesh* loadPrimitive(const Json& primitive, uint32_t defaultMaterial) const;
+    // null json gives the glTF default material
+    aiMaterial* loadMaterial(const Json& material);
+    // type is an aiTextureType
+    void addTexture(aiMaterial* material, const Json& textureInfo, unsigned int type, unsigned int index);
+    aiTexture* loadEmbeddedImage(const Json& image) const;
+    // walks the node hierarchy, fills meshUses and cameraUses
+    // the node graph is added to parent if it's not nullptr
+    void addNode(size_t index, const glm::mat4& parentWorld, aiNode* parent, uint32_t depth);
+};
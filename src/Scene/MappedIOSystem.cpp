@@ -0,0 +1,99 @@
+#include "MappedIOSystem.h"
+
+#include "Util/MappedFile.h"
+#include <bx/bx.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+bool MappedIOSystem::Exists(const char* file) const
+{
+    FILE* handle = std::fopen(file, "rb");
+    if(!handle)
+        return false;
+    std::fclose(handle);
+    return true;
+}
+
+char MappedIOSystem::getOsSeparator() const
+{
+#if BX_PLATFORM_WINDOWS
+    return '\\';
+#else
+    return '/';
+#endif
+}
+
+Assimp::IOStream* MappedIOSystem::Open(const char* file, const char* mode)
+{
+    if(std::strchr(mode, 'w') || std::strchr(mode, 'a') || std::strchr(mode, '+'))
+        return nullptr;
+
+    MappedFile* mapped = MappedFile::open(file);
+    if(!mapped)
+        return nullptr;
+    return new MappedIOStream(mapped);
+}
+
+void MappedIOSystem::Close(Assimp::IOStream* stream)
+{
+    delete stream;
+}
+
+MappedIOStream::~MappedIOStream()
+{
+    mapped->release();
+}
+
+size_t MappedIOStream::Read(void* buffer, size_t size, size_t count)
+{
+    if(size == 0)
+        return 0;
+
+    // only whole elements like fread
+    count = std::min(count, (mapped->size() - cursor) / size);
+    std::memcpy(buffer, mapped->data() + cursor, size * count);
+    cursor += size * count;
+    return count;
+}
+
+size_t MappedIOStream::Write(const void* buffer, size_t size, size_t count)
+{
+    return 0;
+}
+
+aiReturn MappedIOStream::Seek(size_t offset, aiOrigin origin)
+{
+    size_t base = 0;
+    switch(origin)
+    {
+        case aiOrigin_SET:
+            break;
+        case aiOrigin_CUR:
+            base = cursor;
+            break;
+        case aiOrigin_END:
+            // offset is subtracted from the end
+            if(offset > mapped->size())
+                return aiReturn_FAILURE;
+            cursor = mapped->size() - offset;
+            return aiReturn_SUCCESS;
+        default:
+            return aiReturn_FAILURE;
+    }
+
+    if(offset > mapped->size() - base)
+        return aiReturn_FAILURE;
+    cursor = base + offset;
+    return aiReturn_SUCCESS;
+}
+
+size_t MappedIOStream::Tell() const
+{
+    return cursor;
+}
+
+size_t MappedIOStream::FileSize() const
+{
+    return mapped->size();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+
+class MappedFile;
+
+// read-only assimp file system that serves scene files and their buffers from memory mappings
+// importers read straight from the page cache instead of going through buffered stdio
+class MappedIOSystem : public Assimp::IOSystem
+{
+public:
+    virtual bool Exists(const char* file) const override;
+    virtual char getOsSeparator() const override;
+    // nullptr for missing or empty files and any write mode
+    virtual Assimp::IOStream* Open(const char* file, const char* mode = "rb") override;
+    virtual void Close(Assimp::IOStream* stream) override;
+};
+
+class MappedIOStream : public Assimp::IOStream
+{
+public:
+    // takes over the reference to the mapping
+    explicit MappedIOStream(MappedFile* mapped) : mapped(mapped) { }
+    virtual ~MappedIOStream();
+
+    virtual size_t Read(void* buffer, size_t size, size_t count) override;
+    virtual size_t Write(const void* buffer, size_t size, size_t count) override;
+    virtual aiReturn Seek(size_t offset, aiOrigin origin) override;
+    virtual size_t Tell() const override;
+    virtual size_t FileSize() const override;
+    virtual void Flush() override { }
+
+private:
+    MappedFile* mapped;
+    size_t cursor = 0;
+};
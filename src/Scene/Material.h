@@ -25,4 +25,16 @@ struct Material
 
     bgfx::TextureHandle emissiveTexture = BGFX_INVALID_HANDLE;
     glm::vec3 emissiveFactor = { 0.0f, 0.0f, 0.0f };
+
+    // all textures are texture arrays, only set with Scene::texturesInArrays
+    // the others are plain 2D textures, bgfx can't create an array with a single layer
+    bool textureArrays = false;
+
+    // layer of each texture if they're texture arrays, 0 otherwise
+    // textures can be shared with other materials in that case
+    uint16_t baseColorLayer = 0;
+    uint16_t metallicRoughnessLayer = 0;
+    uint16_t normalLayer = 0;
+    uint16_t occlusionLayer = 0;
+    uint16_t emissiveLayer = 0;
 };
@@ -1,4 +1,129 @@
 #include "Mesh.h"
 
+#include <bx/simd_t.h>
+#include <bx/uint32_t.h>
+#include <algorithm>
+
 // initialized in Scene::init
 bgfx::VertexLayout Mesh::PosNormalTangentTex0Vertex::layout;
+bgfx::VertexLayout Mesh::QuantizedVertex::layout;
+
+// octahedral encoding of 4 unit vectors, results are in [-1, 1]
+// see http://jcgt.org/published/0003/02/01/
+static void octahedralEncode(bx::simd128_t x,
+                             bx::simd128_t y,
+                             bx::simd128_t z,
+                             bx::simd128_t& outX,
+                             bx::simd128_t& outY)
+{
+    using namespace bx;
+
+    const simd128_t zero = simd_zero<simd128_t>();
+    const simd128_t one = simd_splat<simd128_t>(1.0f);
+    const simd128_t minusOne = simd_splat<simd128_t>(-1.0f);
+
+    // zero vectors are encoded as 0, divide them by 1 instead
+    const simd128_t sum = simd_add(simd_add(simd_abs(x), simd_abs(y)), simd_abs(z));
+    const simd128_t valid = simd_cmpneq(sum, zero);
+    const simd128_t invSum = simd_div(one, simd_selb(valid, sum, one));
+    x = simd_mul(x, invSum);
+    y = simd_mul(y, invSum);
+    z = simd_mul(z, invSum);
+
+    // fold the lower hemisphere
+    const simd128_t signX = simd_selb(simd_cmpge(x, zero), one, minusOne);
+    const simd128_t signY = simd_selb(simd_cmpge(y, zero), one, minusOne);
+    const simd128_t foldX = simd_mul(simd_sub(one, simd_abs(y)), signX);
+    const simd128_t foldY = simd_mul(simd_sub(one, simd_abs(x)), signY);
+    const simd128_t lower = simd_cmplt(z, zero);
+    outX = simd_and(valid, simd_selb(lower, foldX, x));
+    outY = simd_and(valid, simd_selb(lower, foldY, y));
+}
+
+// clamped to [min, max] and scaled to integers in [min, max] * scale
+static bx::simd128_t toFixed(bx::simd128_t value, float min, float max, float scale)
+{
+    using namespace bx;
+
+    value = simd_min(simd_max(value, simd_splat<simd128_t>(min)), simd_splat<simd128_t>(max));
+    return simd_ftoi(simd_round(simd_mul(value, simd_splat<simd128_t>(scale))));
+}
+
+void Mesh::QuantizedVertex::quantize(QuantizedVertex* out,
+                                     const PosNormalTangentTex0Vertex* vertices,
+                                     size_t count,
+                                     const glm::vec3& center,
+                                     const glm::vec3& extents)
+{
+    using namespace bx;
+
+    // flat boxes have 0 extents on some axis, the coordinate becomes 0
+    const simd128_t centerX = simd_splat<simd128_t>(center.x);
+    const simd128_t centerY = simd_splat<simd128_t>(center.y);
+    const simd128_t centerZ = simd_splat<simd128_t>(center.z);
+    const simd128_t scaleX = simd_splat<simd128_t>(extents.x > 0.0f ? 1.0f / extents.x : 0.0f);
+    const simd128_t scaleY = simd_splat<simd128_t>(extents.y > 0.0f ? 1.0f / extents.y : 0.0f);
+    const simd128_t scaleZ = simd_splat<simd128_t>(extents.z > 0.0f ? 1.0f / extents.z : 0.0f);
+    const simd128_t half = simd_splat<simd128_t>(0.5f);
+
+    for(size_t i = 0; i < count; i += 4)
+    {
+        // gather one attribute component of 4 vertices into a register
+        // the last group repeats the last vertex, only valid lanes get written
+        const PosNormalTangentTex0Vertex* v[4];
+        for(size_t lane = 0; lane < 4; lane++)
+        {
+            v[lane] = &vertices[std::min(i + lane, count - 1)];
+        }
+        auto gather = [&v](float PosNormalTangentTex0Vertex::*member) {
+            return simd_ld<simd128_t>(v[0]->*member, v[1]->*member, v[2]->*member, v[3]->*member);
+        };
+
+        const simd128_t x = simd_mul(simd_sub(gather(&PosNormalTangentTex0Vertex::x), centerX), scaleX);
+        const simd128_t y = simd_mul(simd_sub(gather(&PosNormalTangentTex0Vertex::y), centerY), scaleY);
+        const simd128_t z = simd_mul(simd_sub(gather(&PosNormalTangentTex0Vertex::z), centerZ), scaleZ);
+
+        simd128_t nx, ny;
+        octahedralEncode(gather(&PosNormalTangentTex0Vertex::nx),
+                         gather(&PosNormalTangentTex0Vertex::ny),
+                         gather(&PosNormalTangentTex0Vertex::nz),
+                         nx,
+                         ny);
+
+        simd128_t tx, ty;
+        octahedralEncode(gather(&PosNormalTangentTex0Vertex::tx),
+                         gather(&PosNormalTangentTex0Vertex::ty),
+                         gather(&PosNormalTangentTex0Vertex::tz),
+                         tx,
+                         ty);
+        tx = simd_madd(tx, half, half);
+        ty = simd_madd(ty, half, half);
+
+        alignas(16) int32_t fixed[7][4];
+        simd_st(fixed[0], toFixed(x, -1.0f, 1.0f, 32767.0f));
+        simd_st(fixed[1], toFixed(y, -1.0f, 1.0f, 32767.0f));
+        simd_st(fixed[2], toFixed(z, -1.0f, 1.0f, 32767.0f));
+        simd_st(fixed[3], toFixed(nx, -1.0f, 1.0f, 32767.0f));
+        simd_st(fixed[4], toFixed(ny, -1.0f, 1.0f, 32767.0f));
+        simd_st(fixed[5], toFixed(tx, 0.0f, 1.0f, 255.0f));
+        simd_st(fixed[6], toFixed(ty, 0.0f, 1.0f, 255.0f));
+
+        const size_t lanes = std::min(count - i, size_t(4));
+        for(size_t lane = 0; lane < lanes; lane++)
+        {
+            QuantizedVertex& q = out[i + lane];
+            q.x = int16_t(fixed[0][lane]);
+            q.y = int16_t(fixed[1][lane]);
+            q.z = int16_t(fixed[2][lane]);
+            q.w = 0;
+            q.nx = int16_t(fixed[3][lane]);
+            q.ny = int16_t(fixed[4][lane]);
+            q.tx = uint8_t(fixed[5][lane]);
+            q.ty = uint8_t(fixed[6][lane]);
+            q.tz = 0;
+            q.tw = v[lane]->tw < 0.0f ? 0 : 255;
+            q.u = bx::halfFromFloat(v[lane]->u);
+            q.v = bx::halfFromFloat(v[lane]->v);
+        }
+    }
+}
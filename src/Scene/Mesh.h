@@ -1,14 +1,74 @@
 #pragma once
 
+#include "Scene/Bounds.h"
 #include <bgfx/bgfx.h>
+#include <glm/vec3.hpp>
+#include <glm/matrix.hpp>
+#include <vector>
+
+// spatially coherent range of triangles in a mesh's index buffer
+// smallest unit for culling and drawing
+struct MeshChunk
+{
+    uint32_t mesh = 0; // index into meshes vector
+    uint32_t firstIndex = 0;
+    uint32_t numIndices = 0;
+
+    // simplified versions of the chunk, relative to the mesh like firstIndex
+    // level 0 is the full resolution range above, coarser levels are stored after all full resolution indices
+    struct Lod
+    {
+        uint32_t firstIndex = 0;
+        uint32_t numIndices = 0;
+        // root of the area-weighted mean squared distance to the full resolution surface around the worst
+        // collapsed vertex, object space units so it projects linearly like a distance
+        float error = 0.0f;
+    };
+    static constexpr uint32_t MAX_LODS = 4;
+    Lod lods[MAX_LODS];
+    uint32_t numLods = 1;
+
+    AABB aabb;
+    Sphere sphere; // centered on the AABB
+    NormalCone cone;
+};
 
 struct Mesh
 {
     bgfx::VertexBufferHandle vertexBuffer = BGFX_INVALID_HANDLE;
     bgfx::IndexBufferHandle indexBuffer = BGFX_INVALID_HANDLE;
     unsigned int material = 0; // index into materials vector
+    // start of the mesh in indexBuffer, only non-zero when it's shared with other meshes
+    // chunk index ranges are relative to this
+    uint32_t firstIndex = 0;
+
+    // decoded position * positionScale + positionOffset = object space position
+    // identity unless the vertices are quantized
+    glm::vec3 positionScale = glm::vec3(1.0f);
+    glm::vec3 positionOffset = glm::vec3(0.0f);
+
+    // object space bounds, used for culling and depth sorting
+    AABB aabb;
+    Sphere sphere; // centered on the AABB
+    // average UV units per object space unit, 0 without texture coordinates
+    // texture streaming estimates the texels a material needs on screen from this
+    float uvDensity = 0.0f;
+
+    // range in the scene's chunk vector, a mesh's chunks are contiguous
+    uint32_t firstChunk = 0;
+    uint32_t numChunks = 0;
+
+    // world transformations of all nodes using the mesh when loading with instancing
+    // empty for meshes that were pre-transformed to world space
+    // instanced meshes stay in object space and have no chunks, aabb and sphere are in object space
+    std::vector<glm::mat4> instances;
+    // world space bounds per instance
+    BoundsSoA instanceBounds;
 
-    //bgfx::OcclusionQueryHandle occlusionQuery = BGFX_INVALID_HANDLE;
+    // CPU copy of the geometry for the software occlusion rasterizer
+    std::vector<glm::vec3> positions;
+    // indices are relative to the mesh, chunk LODs follow the full resolution triangles
+    std::vector<uint32_t> indices;
 
     // bgfx vertex attributes
     // initialized by Scene
@@ -17,6 +77,7 @@ struct Mesh
         float x, y, z;    // position
         float nx, ny, nz; // normal
         float tx, ty, tz; // tangent
+        float tw;         // bitangent sign, -1 or 1
         float u, v;       // UV coordinates
 
         static void init()
@@ -24,10 +85,40 @@ struct Mesh
             layout.begin()
                 .add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float)
                 .add(bgfx::Attrib::Normal, 3, bgfx::AttribType::Float)
-                .add(bgfx::Attrib::Tangent, 3, bgfx::AttribType::Float)
+                .add(bgfx::Attrib::Tangent, 4, bgfx::AttribType::Float)
                 .add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Float)
                 .end();
         }
         static bgfx::VertexLayout layout;
     };
+
+    // compressed version of PosNormalTangentTex0Vertex, 20 instead of 48 bytes
+    // decoded in vertex.sh
+    struct QuantizedVertex
+    {
+        int16_t x, y, z, w;   // position in [-1, 1] relative to a bounding box, w unused
+        int16_t nx, ny;       // octahedral normal
+        uint8_t tx, ty, tz;   // octahedral tangent in [0, 1], z unused
+        uint8_t tw;           // bitangent sign, 0 = -1, 255 = 1
+        uint16_t u, v;        // half float UV coordinates
+
+        static void init()
+        {
+            layout.begin()
+                .add(bgfx::Attrib::Position, 4, bgfx::AttribType::Int16, true)
+                .add(bgfx::Attrib::Normal, 2, bgfx::AttribType::Int16, true)
+                .add(bgfx::Attrib::Tangent, 4, bgfx::AttribType::Uint8, true)
+                .add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Half)
+                .end();
+        }
+        static bgfx::VertexLayout layout;
+
+        // center and extents of the bounding box the positions are quantized to
+        // converts 4 vertices at a time with SIMD
+        static void quantize(QuantizedVertex* out,
+                             const PosNormalTangentTex0Vertex* vertices,
+                             size_t count,
+                             const glm::vec3& center,
+                             const glm::vec3& extents);
+    };
 };
@@ -0,0 +1,260 @@
+#include "MeshSimplifier.h"
+
+#include <glm/geometric.hpp>
+#include <glm/common.hpp>
+#include <unordered_map>
+#include <algorithm>
+#include <limits>
+
+MeshSimplifier::Quadric MeshSimplifier::Quadric::fromPlane(const glm::vec3& normal, float distance, float weight)
+{
+    Quadric q;
+    q.a00 = weight * normal.x * normal.x;
+    q.a01 = weight * normal.x * normal.y;
+    q.a02 = weight * normal.x * normal.z;
+    q.a11 = weight * normal.y * normal.y;
+    q.a12 = weight * normal.y * normal.z;
+    q.a22 = weight * normal.z * normal.z;
+    q.b0 = weight * normal.x * distance;
+    q.b1 = weight * normal.y * distance;
+    q.b2 = weight * normal.z * distance;
+    q.c = weight * distance * distance;
+    q.weight = weight;
+    return q;
+}
+
+MeshSimplifier::Quadric& MeshSimplifier::Quadric::operator+=(const Quadric& other)
+{
+    a00 += other.a00;
+    a01 += other.a01;
+    a02 += other.a02;
+    a11 += other.a11;
+    a12 += other.a12;
+    a22 += other.a22;
+    b0 += other.b0;
+    b1 += other.b1;
+    b2 += other.b2;
+    c += other.c;
+    weight += other.weight;
+    return *this;
+}
+
+double MeshSimplifier::Quadric::error(const glm::vec3& p) const
+{
+    if(weight <= 0.0)
+        return 0.0;
+
+    // p^T A p + 2 b^T p + c
+    double x = p.x, y = p.y, z = p.z;
+    double ax = a00 * x + a01 * y + a02 * z;
+    double ay = a01 * x + a11 * y + a12 * z;
+    double az = a02 * x + a12 * y + a22 * z;
+    double e = x * ax + y * ay + z * az + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+    return std::max(e, 0.0) / weight;
+}
+
+MeshSimplifier::MeshSimplifier(const glm::vec3* positions, const uint32_t* indices, size_t indexCount)
+{
+    // compact the referenced vertices
+    std::unordered_map<uint32_t, uint32_t> local;
+    this->indices.resize(indexCount);
+    for(size_t i = 0; i < indexCount; i++)
+    {
+        auto inserted = local.emplace(indices[i], uint32_t(vertices.size()));
+        if(inserted.second)
+        {
+            vertices.push_back(indices[i]);
+            this->positions.push_back(positions[indices[i]]);
+        }
+        this->indices[i] = inserted.first->second;
+    }
+
+    size_t vertexCount = vertices.size();
+    quadrics.resize(vertexCount);
+    locked.assign(vertexCount, false);
+
+    // edges used by exactly one triangle are borders, more than two is non-manifold
+    // lock both of their vertices
+    std::unordered_map<uint64_t, uint32_t> edges;
+    for(size_t t = 0; t < indexCount; t += 3)
+    {
+        const uint32_t* tri = &this->indices[t];
+        for(size_t e = 0; e < 3; e++)
+        {
+            uint32_t a = tri[e];
+            uint32_t b = tri[(e + 1) % 3];
+            uint64_t key = (uint64_t(std::min(a, b)) << 32) | std::max(a, b);
+            edges[key]++;
+        }
+
+        glm::vec3 p0 = this->positions[tri[0]];
+        glm::vec3 normal = glm::cross(this->positions[tri[1]] - p0, this->positions[tri[2]] - p0);
+        float area2 = glm::length(normal);
+        if(area2 > 0.0f)
+        {
+            normal /= area2;
+            Quadric q = Quadric::fromPlane(normal, -glm::dot(normal, p0), area2 * 0.5f);
+            for(size_t v = 0; v < 3; v++)
+            {
+                quadrics[tri[v]] += q;
+            }
+        }
+    }
+    for(const auto& edge : edges)
+    {
+        if(edge.second != 2)
+        {
+            locked[uint32_t(edge.first >> 32)] = true;
+            locked[uint32_t(edge.first & 0xFFFFFFFF)] = true;
+        }
+    }
+}
+
+bool MeshSimplifier::simplify(size_t targetIndexCount)
+{
+    bool collapsed = false;
+    size_t vertexCount = vertices.size();
+
+    // every pass collapses a set of edges that don't share any triangles
+    // so the flip checks and adjacency stay valid until the pass is done
+    while(indices.size() > targetIndexCount)
+    {
+        // triangles around each vertex
+        adjacencyOffsets.assign(vertexCount + 1, 0);
+        for(uint32_t index : indices)
+        {
+            adjacencyOffsets[index + 1]++;
+        }
+        for(size_t i = 0; i < vertexCount; i++)
+        {
+            adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+        }
+        adjacency.resize(indices.size());
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for(size_t i = 0; i < indices.size(); i++)
+        {
+            adjacency[fill[indices[i]]++] = uint32_t(i / 3);
+        }
+
+        // cheapest direction of every edge
+        // interior edges show up twice with opposite winding, only look at them once
+        std::vector<Collapse> collapses;
+        collapses.reserve(indices.size() / 2);
+        for(size_t t = 0; t < indices.size(); t += 3)
+        {
+            for(size_t e = 0; e < 3; e++)
+            {
+                uint32_t a = indices[t + e];
+                uint32_t b = indices[t + (e + 1) % 3];
+                if(a > b || (locked[a] && locked[b]))
+                    continue;
+
+                Quadric q = quadrics[a];
+                q += quadrics[b];
+                Collapse best = { a, b, std::numeric_limits<double>::max() };
+                if(!locked[a])
+                    best.error = q.error(positions[b]);
+                if(!locked[b])
+                {
+                    double error = q.error(positions[a]);
+                    if(error < best.error)
+                        best = { b, a, error };
+                }
+                collapses.push_back(best);
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+            return a.error < b.error;
+        });
+
+        std::vector<uint32_t> remap(vertexCount);
+        for(uint32_t i = 0; i < vertexCount; i++)
+        {
+            remap[i] = i;
+        }
+        std::vector<bool> touched(vertexCount, false);
+
+        // don't overshoot the target by much
+        size_t trianglesLeft = (indices.size() - targetIndexCount + 2) / 3;
+        size_t removed = 0;
+        for(const Collapse& collapse : collapses)
+        {
+            if(touched[collapse.from] || touched[collapse.to] || flips(collapse.from, collapse.to))
+                continue;
+
+            for(uint32_t i = adjacencyOffsets[collapse.from]; i < adjacencyOffsets[collapse.from + 1]; i++)
+            {
+                const uint32_t* tri = &indices[adjacency[i] * 3];
+                touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+                if(tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to)
+                    removed++;
+            }
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            maxError = std::max(maxError, collapse.error);
+
+            if(removed >= trianglesLeft)
+                break;
+        }
+
+        if(removed == 0)
+            break;
+        collapsed = true;
+
+        size_t count = 0;
+        for(size_t t = 0; t < indices.size(); t += 3)
+        {
+            uint32_t a = remap[indices[t + 0]];
+            uint32_t b = remap[indices[t + 1]];
+            uint32_t c = remap[indices[t + 2]];
+            if(a == b || b == c || a == c)
+                continue;
+            indices[count++] = a;
+            indices[count++] = b;
+            indices[count++] = c;
+        }
+        indices.resize(count);
+    }
+
+    return collapsed;
+}
+
+std::vector<uint32_t> MeshSimplifier::getIndices() const
+{
+    std::vector<uint32_t> result(indices.size());
+    for(size_t i = 0; i < indices.size(); i++)
+    {
+        result[i] = vertices[indices[i]];
+    }
+    return result;
+}
+
+float MeshSimplifier::getError() const
+{
+    return float(glm::sqrt(maxError));
+}
+
+bool MeshSimplifier::flips(uint32_t from, uint32_t to) const
+{
+    for(uint32_t i = adjacencyOffsets[from]; i < adjacencyOffsets[from + 1]; i++)
+    {
+        const uint32_t* tri = &indices[adjacency[i] * 3];
+        // removed by the collapse
+        if(tri[0] == to || tri[1] == to || tri[2] == to)
+            continue;
+
+        glm::vec3 p[3], q[3];
+        for(size_t v = 0; v < 3; v++)
+        {
+            p[v] = positions[tri[v]];
+            q[v] = tri[v] == from ? positions[to] : p[v];
+        }
+        glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+        glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+        // reject flipped, degenerate and strongly rotated triangles (> 60 degrees)
+        if(glm::dot(before, after) <= 0.5f * glm::length(before) * glm::length(after))
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <vector>
+
+// quadric error metric edge collapse simplification
+// vertices are never moved or created, edges collapse onto one of their existing vertices
+// so every attribute of the surviving vertices stays valid
+// vertices on border edges are locked, with split vertices that includes UV and normal seams,
+// mesh (material) boundaries and the boundaries of the range being simplified
+// simplify can be called repeatedly with decreasing targets to build a LOD chain,
+// the error keeps accumulating relative to the original geometry
+class MeshSimplifier
+{
+public:
+    // positions are indexed by indices, only the referenced vertices are used
+    MeshSimplifier(const glm::vec3* positions, const uint32_t* indices, size_t indexCount);
+
+    // collapse edges until there are at most targetIndexCount indices left or nothing can be collapsed
+    // returns false if no edge could be collapsed
+    bool simplify(size_t targetIndexCount);
+
+    // current triangles, in the original vertex indices
+    std::vector<uint32_t> getIndices() const;
+    // square root of the largest collapse error, the area-weighted mean squared distance of a collapsed vertex
+    // to the original planes around it
+    // an RMS distance in object space units, not a bound on the largest distance
+    float getError() const;
+
+private:
+    // error quadric of a set of planes, area weighted
+    // evaluates to the weighted sum of squared distances to the planes
+    struct Quadric
+    {
+        // symmetric 3x3 matrix A, vector b, scalar c
+        double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+        double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+        double c = 0.0;
+        double weight = 0.0;
+
+        static Quadric fromPlane(const glm::vec3& normal, float distance, float weight);
+        Quadric& operator+=(const Quadric& other);
+        // squared distance, divided by the total weight
+        double error(const glm::vec3& p) const;
+    };
+
+    struct Collapse
+    {
+        uint32_t from;
+        uint32_t to;
+        double error; // squared distance
+    };
+
+    bool flips(uint32_t from, uint32_t to) const;
+
+    // local vertex index -> original vertex index
+    std::vector<uint32_t> vertices;
+    std::vector<glm::vec3> positions;
+    std::vector<Quadric> quadrics;
+    std::vector<bool> locked;
+
+    // local indices, degenerate triangles get removed after every pass
+    std::vector<uint32_t> indices;
+
+    // triangles around each vertex, rebuilt every pass
+    std::vector<uint32_t> adjacencyOffsets;
+    std::vector<uint32_t> adjacency;
+
+    double maxError = 0.0;
+};
@@ -0,0 +1,207 @@
+#include "MipGenerator.h"
+
+#include <bimg/bimg.h>
+#include <bx/simd_t.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+// linear values are quantized to this many steps before converting them back to sRGB
+// fine enough that the darkest sRGB values still round correctly
+static constexpr uint32_t SRGB_STEPS = 16384;
+
+// conversion tables between 8-bit values and linear floats
+struct ColorTables
+{
+    float srgbToLinear[256];
+    float unormToFloat[256];
+    uint8_t linearToSrgb[SRGB_STEPS];
+
+    ColorTables()
+    {
+        for(uint32_t i = 0; i < 256; i++)
+        {
+            const float c = float(i) / 255.0f;
+            srgbToLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            unormToFloat[i] = c;
+        }
+        for(uint32_t i = 0; i < SRGB_STEPS; i++)
+        {
+            const float l = float(i) / float(SRGB_STEPS - 1);
+            const float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            linearToSrgb[i] = uint8_t(std::min(c * 255.0f + 0.5f, 255.0f));
+        }
+    }
+};
+
+static const ColorTables& colorTables()
+{
+    // initialized once, even with several decoding threads
+    static const ColorTables tables;
+    return tables;
+}
+
+bimg::ImageContainer* MipGenerator::generate(bx::AllocatorI* allocator,
+                                             bimg::ImageContainer* image,
+                                             bool sRGB,
+                                             bool normalMap)
+{
+    if(image->m_numMips > 1 || bimg::isCompressed(image->m_format) || image->m_cubeMap || image->m_depth > 1 ||
+       (image->m_width == 1 && image->m_height == 1))
+        return image;
+
+    // 16-bit and float formats
+    const bimg::ImageBlockInfo& info = bimg::getBlockInfo(image->m_format);
+    if(std::max({ info.rBits, info.gBits, info.bBits, info.aBits }) > 8)
+        return image;
+
+    if(image->m_format != bimg::TextureFormat::RGBA8)
+    {
+        bimg::ImageContainer* converted = bimg::imageConvert(allocator, bimg::TextureFormat::RGBA8, *image);
+        bimg::imageFree(image);
+        if(!converted)
+            throw std::runtime_error("Can't convert image to RGBA8");
+        image = converted;
+    }
+
+    bimg::ImageContainer* output = bimg::imageAlloc(allocator,
+                                                    bimg::TextureFormat::RGBA8,
+                                                    uint16_t(image->m_width),
+                                                    uint16_t(image->m_height),
+                                                    1,
+                                                    image->m_numLayers,
+                                                    false,
+                                                    true);
+    output->m_hasAlpha = image->m_hasAlpha;
+
+    for(uint16_t layer = 0; layer < image->m_numLayers; layer++)
+    {
+        bimg::ImageMip src, dst;
+        bimg::imageGetRawData(*image, layer, 0, image->m_data, image->m_size, src);
+        bimg::imageGetRawData(*output, layer, 0, output->m_data, output->m_size, dst);
+        std::memcpy((void*)dst.m_data, src.m_data, src.m_size);
+
+        // each level from the previous one, only the top level gets read twice
+        for(uint8_t lod = 1; lod < output->m_numMips; lod++)
+        {
+            src = dst;
+            bimg::imageGetRawData(*output, layer, lod, output->m_data, output->m_size, dst);
+            downsample(src.m_data,
+                       src.m_width,
+                       src.m_height,
+                       (uint8_t*)dst.m_data,
+                       dst.m_width,
+                       dst.m_height,
+                       sRGB,
+                       normalMap);
+        }
+    }
+    bimg::imageFree(image);
+    return output;
+}
+
+MipGenerator::Taps MipGenerator::taps(uint32_t x, uint32_t srcSize, uint32_t size)
+{
+    Taps taps;
+    if(srcSize == 1)
+        taps = { { 0, 0, 0 }, { 1.0f, 0.0f, 0.0f }, 1 };
+    else if(srcSize % 2 == 0)
+        taps = { { x * 2, x * 2 + 1, 0 }, { 0.5f, 0.5f, 0.0f }, 2 };
+    else
+    {
+        // srcSize = 2 * size + 1, each destination texel covers srcSize / size source texels
+        // the outer taps are only partially covered, neighbors share them
+        const float n = float(srcSize);
+        taps = { { x * 2, x * 2 + 1, x * 2 + 2 },
+                 { float(size - x) / n, float(size) / n, float(x + 1) / n },
+                 3 };
+    }
+    return taps;
+}
+
+void MipGenerator::downsample(const uint8_t* src,
+                              uint32_t srcWidth,
+                              uint32_t srcHeight,
+                              uint8_t* dst,
+                              uint32_t width,
+                              uint32_t height,
+                              bool sRGB,
+                              bool normalMap)
+{
+    using namespace bx;
+
+    const ColorTables& tables = colorTables();
+    const float* toLinear = sRGB ? tables.srgbToLinear : tables.unormToFloat;
+    // one pixel per register, alpha in w
+    auto load = [toLinear, &tables](const uint8_t* pixel) {
+        return simd_ld<simd128_t>(
+            toLinear[pixel[0]], toLinear[pixel[1]], toLinear[pixel[2]], tables.unormToFloat[pixel[3]]);
+    };
+
+    const simd128_t zero = simd_zero<simd128_t>();
+    const simd128_t one = simd_splat<simd128_t>(1.0f);
+    // sRGB color goes through the table, everything else is stored directly
+    const float colorScale = sRGB ? float(SRGB_STEPS - 1) : 255.0f;
+    const simd128_t scale = simd_ld<simd128_t>(colorScale, colorScale, colorScale, 255.0f);
+    const simd128_t two = simd_splat<simd128_t>(2.0f);
+
+    std::vector<Taps> columns(width);
+    for(uint32_t x = 0; x < width; x++)
+    {
+        columns[x] = taps(x, srcWidth, width);
+    }
+
+    for(uint32_t y = 0; y < height; y++)
+    {
+        const Taps rows = taps(y, srcHeight, height);
+        uint8_t* out = dst + size_t(y) * width * 4;
+        for(uint32_t x = 0; x < width; x++)
+        {
+            const Taps& columnTaps = columns[x];
+            simd128_t average = zero;
+            for(uint32_t ty = 0; ty < rows.count; ty++)
+            {
+                const uint8_t* row = src + size_t(rows.index[ty]) * srcWidth * 4;
+                for(uint32_t tx = 0; tx < columnTaps.count; tx++)
+                {
+                    const simd128_t weight = simd_splat<simd128_t>(rows.weight[ty] * columnTaps.weight[tx]);
+                    average = simd_madd(load(row + size_t(columnTaps.index[tx]) * 4), weight, average);
+                }
+            }
+
+            if(normalMap)
+            {
+                // [0, 1] -> [-1, 1], normalize xyz and map back
+                // averaging shortens the vectors, without this mips get darker and flatter
+                alignas(16) float n[4];
+                simd_st(n, simd_sub(simd_mul(average, two), one));
+                const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if(length > 0.0f)
+                {
+                    const simd128_t normalized = simd_ld<simd128_t>(n[0] / length, n[1] / length, n[2] / length, n[3]);
+                    average = simd_mul(simd_add(normalized, one), simd_splat<simd128_t>(0.5f));
+                }
+            }
+
+            average = simd_min(simd_max(average, zero), one);
+            alignas(16) int32_t quantized[4];
+            simd_st(quantized, simd_ftoi(simd_round(simd_mul(average, scale))));
+            if(sRGB)
+            {
+                out[0] = tables.linearToSrgb[quantized[0]];
+                out[1] = tables.linearToSrgb[quantized[1]];
+                out[2] = tables.linearToSrgb[quantized[2]];
+            }
+            else
+            {
+                out[0] = uint8_t(quantized[0]);
+                out[1] = uint8_t(quantized[1]);
+                out[2] = uint8_t(quantized[2]);
+            }
+            out[3] = uint8_t(quantized[3]);
+            out += 4;
+        }
+    }
+}
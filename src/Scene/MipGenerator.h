@@ -0,0 +1,46 @@
+#pragma once
+
+#include <bx/allocator.h>
+
+namespace bimg
+{
+struct ImageContainer;
+}
+
+// full mip chain for images that come without one
+// every level is a box filter of the previous level, averaged in linear space for sRGB images
+// even sizes average 2 texels per axis, odd sizes 3 with weights so every source texel counts equally
+// and renormalized for normal maps, alpha is always linear
+// thread-safe, the decoding threads run it for one image each
+class MipGenerator
+{
+public:
+    // takes ownership of the image and returns an RGBA8 image with all mips
+    // images that already have mips, compressed images, cube maps, volumes and 1x1 images are returned as they are
+    // so are images with more than 8 bits per channel, RGBA8 would lose their precision
+    // throws std::runtime_error if the image can't be converted to RGBA8
+    static bimg::ImageContainer* generate(bx::AllocatorI* allocator,
+                                          bimg::ImageContainer* image,
+                                          bool sRGB,
+                                          bool normalMap);
+
+private:
+    // source texels and weights of a destination texel along one axis
+    struct Taps
+    {
+        uint32_t index[3];
+        float weight[3];
+        uint32_t count;
+    };
+    static Taps taps(uint32_t x, uint32_t srcSize, uint32_t size);
+
+    // one level from the next bigger one, both RGBA8
+    static void downsample(const uint8_t* src,
+                           uint32_t srcWidth,
+                           uint32_t srcHeight,
+                           uint8_t* dst,
+                           uint32_t width,
+                           uint32_t height,
+                           bool sRGB,
+                           bool normalMap);
+};
@@ -1,7 +1,14 @@
 #include "Scene.h"
 
+#include "Scene/GltfLoader.h"
+#include "Scene/MappedIOSystem.h"
+#include "Scene/MipGenerator.h"
+#include "Scene/MeshSimplifier.h"
+#include "Util/MappedFile.h"
+#include "Util/ThreadPool.h"
 #include <assimp/DefaultLogger.hpp>
 #include <assimp/Importer.hpp>
+#include <assimp/ProgressHandler.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 #include <assimp/mesh.h>
@@ -9,13 +16,93 @@
 #include <assimp/GltfMaterial.h>
 #include <assimp/camera.h>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/matrix_operation.hpp>
 #include <glm/trigonometric.hpp>
 #include <bx/file.h>
+#include <bx/timer.h>
 #include <bimg/decode.h>
 #include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
 
 bx::DefaultAllocator Scene::allocator;
 
+// material members that hold textures
+static bgfx::TextureHandle Material::*const MATERIAL_TEXTURES[] = { &Material::baseColorTexture,
+                                                                    &Material::metallicRoughnessTexture,
+                                                                    &Material::normalTexture,
+                                                                    &Material::occlusionTexture,
+                                                                    &Material::emissiveTexture };
+
+static float millisecondsSince(int64_t start)
+{
+    return float(double(bx::getHPCounter() - start) * 1000.0 / double(bx::getHPFrequency()));
+}
+
+// writes the image data in the layout createTexture2D expects, layers one after the other with their whole mip chain
+// decoded and DDS images are already stored like that, KTX files have the size of each mip in front of it
+// out must hold image.m_size bytes, KTX files were checked by ktxComplete
+static void copyImageData(const bimg::ImageContainer& image, const MappedFile* mapped, uint8_t* out)
+{
+    if(!mapped || !image.m_ktx)
+    {
+        std::memcpy(out, image.m_data, image.m_size);
+        return;
+    }
+
+    for(uint16_t layer = 0; layer < image.m_numLayers; layer++)
+    {
+        for(uint8_t lod = 0; lod < image.m_numMips; lod++)
+        {
+            bimg::ImageMip mip;
+            bimg::imageGetRawData(image, layer, lod, mapped->data(), uint32_t(mapped->size()), mip);
+            std::memcpy(out, mip.m_data, mip.m_size);
+            out += mip.m_size;
+        }
+    }
+}
+
+// all mips of a KTX header fit into the file and add up to the size of the image
+static bool ktxComplete(const bimg::ImageContainer& image, const uint8_t* data, uint32_t size)
+{
+    uint64_t total = 0;
+    for(uint16_t layer = 0; layer < image.m_numLayers; layer++)
+    {
+        for(uint8_t lod = 0; lod < image.m_numMips; lod++)
+        {
+            bimg::ImageMip mip;
+            if(!bimg::imageGetRawData(image, layer, lod, data, size, mip) || mip.m_data < data ||
+               mip.m_size > size_t(data + size - mip.m_data))
+                return false;
+            total += mip.m_size;
+        }
+    }
+    return total == image.m_size;
+}
+
+// reports the import progress in percent and aborts the import once the load is cancelled
+class ImportProgressHandler : public Assimp::ProgressHandler
+{
+public:
+    ImportProgressHandler(const std::atomic<bool>& cancel, std::atomic<uint32_t>& percent) :
+        cancel(cancel), percent(percent)
+    {
+    }
+
+    bool Update(float percentage) override
+    {
+        if(percentage >= 0.0f)
+            percent = uint32_t(percentage * 100.0f);
+        return !cancel;
+    }
+
+private:
+    const std::atomic<bool>& cancel;
+    std::atomic<uint32_t>& percent;
+};
+
 Scene::Scene() :
     skyColor({ 0.53f, 0.81f, 0.98f }), // https://en.wikipedia.org/wiki/Sky_blue#Light_sky_blue
     ambientLight({ { 0.03f, 0.03f, 0.03f } })
@@ -24,53 +111,63 @@ Scene::Scene() :
     Assimp::DefaultLogger::set(&logSource);
 }
 
+Scene::~Scene()
+{
+    endLoad();
+}
+
 void Scene::init()
 {
     Mesh::PosNormalTangentTex0Vertex::init();
+    Mesh::QuantizedVertex::init();
 }
 
 void Scene::clear()
 {
-    if(loaded)
+    // the importing thread has to stop before its results are thrown away
+    const bool wasLoading = loading();
+    endLoad();
+
+    if(loaded || wasLoading)
     {
+        if(buffersMerged)
+        {
+            if(bgfx::isValid(vertexBuffer))
+                bgfx::destroy(vertexBuffer);
+            if(bgfx::isValid(indexBuffer))
+                bgfx::destroy(indexBuffer);
+            vertexBuffer = BGFX_INVALID_HANDLE;
+            indexBuffer = BGFX_INVALID_HANDLE;
+        }
+        else
+        {
+            for(Mesh& mesh : meshes)
+            {
+                bgfx::destroy(mesh.vertexBuffer);
+                bgfx::destroy(mesh.indexBuffer);
+            }
+        }
         for(Mesh& mesh : meshes)
         {
-            bgfx::destroy(mesh.vertexBuffer);
-            bgfx::destroy(mesh.indexBuffer);
             mesh.vertexBuffer = BGFX_INVALID_HANDLE;
             mesh.indexBuffer = BGFX_INVALID_HANDLE;
         }
 
-        for(Material& mat : materials)
+        // every material slot holds a reference, shared textures are destroyed with the last one
+        for(const Material& material : materials)
         {
-            if(bgfx::isValid(mat.baseColorTexture))
+            for(bgfx::TextureHandle Material::*texture : MATERIAL_TEXTURES)
             {
-                bgfx::destroy(mat.baseColorTexture);
-                mat.baseColorTexture = BGFX_INVALID_HANDLE;
-            }
-            if(bgfx::isValid(mat.metallicRoughnessTexture))
-            {
-                bgfx::destroy(mat.metallicRoughnessTexture);
-                mat.metallicRoughnessTexture = BGFX_INVALID_HANDLE;
-            }
-            if(bgfx::isValid(mat.normalTexture))
-            {
-                bgfx::destroy(mat.normalTexture);
-                mat.normalTexture = BGFX_INVALID_HANDLE;
-            }
-            if(bgfx::isValid(mat.occlusionTexture))
-            {
-                bgfx::destroy(mat.occlusionTexture);
-                mat.occlusionTexture = BGFX_INVALID_HANDLE;
-            }
-            if(bgfx::isValid(mat.emissiveTexture))
-            {
-                bgfx::destroy(mat.emissiveTexture);
-                mat.emissiveTexture = BGFX_INVALID_HANDLE;
+                if(bgfx::isValid(material.*texture))
+                    textureCache.release(material.*texture);
             }
         }
+        textureCache.clear();
+        streamer.clear();
 
         meshes.clear();
+        chunks.clear();
+        chunkBounds.clear();
         materials.clear();
         pointLights.shutdown();
         pointLights.lights.clear();
@@ -80,134 +177,912 @@ void Scene::clear()
     diagonal = 0.0f;
     camera = Camera();
     loaded = false;
+    loadedFromCache = false;
+    geometryRevision++;
+    materialRevision++;
 }
 
 bool Scene::load(const char* file)
+{
+    if(beginLoad(file, false))
+    {
+        import();
+        update();
+    }
+    return loaded;
+}
+
+void Scene::loadAsync(const char* file)
+{
+    if(beginLoad(file, true))
+        loadThread = std::thread(&Scene::import, this);
+}
+
+bool Scene::beginLoad(const char* file, bool async)
 {
     clear();
 
     pointLights.init();
 
-    Assimp::Importer importer;
-
-    // Settings for aiProcess_SortByPType
-    // only take triangles or higher (polygons are triangulated during import)
-    importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_LINE | aiPrimitiveType_POINT);
-    // Settings for aiProcess_SplitLargeMeshes
-    // Limit vertices to 65k (we use 16-bit indices)
-    importer.SetPropertyInteger(AI_CONFIG_PP_SLM_VERTEX_LIMIT, std::numeric_limits<uint16_t>::max());
+    buffersMerged = mergeBuffers && (bgfx::getCaps()->supported & BGFX_CAPS_INDEX32) != 0;
+    verticesQuantized = quantizeVertices && (bgfx::getCaps()->supported & BGFX_CAPS_VERTEX_ATTRIB_HALF) != 0;
+    meshesInstanced = instanceMeshes && (bgfx::getCaps()->supported & BGFX_CAPS_INSTANCING) != 0;
+    texturesInArrays = textureArrays && (bgfx::getCaps()->supported & BGFX_CAPS_TEXTURE_2D_ARRAY) != 0;
+    // color textures are sampled as sRGB
+    auto formatSupported = [](bgfx::TextureFormat::Enum format, bool sRGB) {
+        const uint16_t caps = BGFX_CAPS_FORMAT_TEXTURE_2D | (sRGB ? BGFX_CAPS_FORMAT_TEXTURE_2D_SRGB : 0);
+        return (bgfx::getCaps()->formats[format] & caps) == caps;
+    };
+    const bool bc7 = highQualityCompression && formatSupported(bgfx::TextureFormat::BC7, true);
+    texturesCompressed = compressTextures && formatSupported(bgfx::TextureFormat::BC5, false) &&
+                         (bc7 || (formatSupported(bgfx::TextureFormat::BC1, true) &&
+                                  formatSupported(bgfx::TextureFormat::BC3, true)));
+    texturesStreamed = streamTextures && !texturesInArrays;
 
     unsigned int flags =
         aiProcessPreset_TargetRealtime_Quality |                     // some optimizations and safety checks
         aiProcess_OptimizeMeshes |                                   // minimize number of meshes
-        aiProcess_PreTransformVertices |                             // apply node matrices
         aiProcess_FixInfacingNormals | aiProcess_TransformUVCoords | // apply UV transformations
         //aiProcess_FlipWindingOrder   | // we cull clock-wise, keep the default CCW winding order
         aiProcess_MakeLeftHanded | // we set GLM_FORCE_LEFT_HANDED and use left-handed bx matrix functions
         aiProcess_FlipUVs;         // bimg loads textures with flipped Y (top left is 0,0)
+    // apply node matrices, this duplicates meshes used by several nodes
+    // with instancing the node graph is resolved after loading
+    if(!meshesInstanced)
+        flags |= aiProcess_PreTransformVertices;
+
+    const int64_t start = bx::getHPCounter();
+
+    if(useCache)
+    {
+        SceneCache::Key key;
+        key.importFlags = flags;
+        // the loader isn't part of the key, it's only known after the import and both produce an equivalent scene
+        key.options = (buffersMerged ? 1 : 0) | (verticesQuantized ? 2 : 0) | (meshesInstanced ? 4 : 0) |
+                      (generateLods ? 8 : 0) | (texturesInArrays ? 16 : 0) | (texturesCompressed ? 32 : 0) |
+                      (texturesCompressed && bc7 ? 64 : 0);
+        const std::string cacheFile = SceneCache::path(file);
+        if(loadCache(cacheFile.c_str(), key))
+        {
+            geometryRevision++;
+            materialRevision++;
+            Log->info("Loaded scene from cache in {:.0f} ms", millisecondsSince(start));
+            return false;
+        }
+
+        cacheWriter.reset(new SceneCache::Writer());
+        if(cacheWriter->open(cacheFile.c_str(), key))
+            cacheWriter->addDependency(file);
+        else
+            cacheWriter.reset();
+    }
+
+    if(texturesCompressed)
+        compressor.reset(new TextureCompressor(&allocator, bc7));
+
+    loadState.reset(new LoadState());
+    loadState->file = file;
+    loadState->importFlags = flags;
+    loadState->async = async;
+    loadState->start = start;
+    return true;
+}
+
+void Scene::import()
+{
+    LoadState& state = *loadState;
+    state.total = 100;
 
     const aiScene* scene = nullptr;
+    std::unique_ptr<aiScene> ownedScene;
+    const int64_t importStart = bx::getHPCounter();
+    if(nativeGltf && GltfLoader::handles(state.file.c_str()))
+    {
+        try
+        {
+            GltfLoader loader;
+            // without instancing the nodes are baked like aiProcess_PreTransformVertices
+            // unmerged meshes need 16-bit indices, see convertMesh, assimp splits larger meshes instead
+            const uint32_t maxVertices = buffersMerged ? UINT32_MAX : std::numeric_limits<uint16_t>::max() + 1u;
+            ownedScene.reset(loader.load(state.file.c_str(), !meshesInstanced, maxVertices));
+            scene = ownedScene.get();
+            state.nativeGltf = true;
+            state.completed = 100;
+            Log->info("Read glTF file in {:.0f} ms", millisecondsSince(importStart));
+        }
+        catch(const std::exception& e)
+        {
+            Log->info("Importing with assimp, glTF loader can't read the file: {}", e.what());
+        }
+    }
+
+    Assimp::Importer importer;
+
+    // Settings for aiProcess_SortByPType
+    // only take triangles or higher (polygons are triangulated during import)
+    importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_LINE | aiPrimitiveType_POINT);
+    // Settings for aiProcess_SplitLargeMeshes
+    // Limit vertices to 65k if we use 16-bit indices
+    if(!buffersMerged)
+        importer.SetPropertyInteger(AI_CONFIG_PP_SLM_VERTEX_LIMIT, std::numeric_limits<uint16_t>::max());
+    // the importer deletes the handlers
+    importer.SetProgressHandler(new ImportProgressHandler(state.cancel, state.completed));
+    importer.SetIOHandler(new MappedIOSystem());
+
+    if(!scene)
+    {
+        try
+        {
+            scene = importer.ReadFile(state.file.c_str(), state.importFlags);
+            Log->info("Imported scene with assimp in {:.0f} ms", millisecondsSince(importStart));
+        }
+        catch(const std::exception& e)
+        {
+            Log->error("{}", e.what());
+        }
+    }
+
+    if(!scene || (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) || state.cancel)
+    {
+        if(scene && !state.cancel)
+            Log->error("Scene is incomplete or invalid");
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.failed = true;
+        state.imported = true;
+        return;
+    }
+
+    std::vector<std::vector<glm::mat4>> meshInstances(scene->mNumMeshes);
+    if(meshesInstanced)
+    {
+        // the importer would otherwise only give us a const scene
+        if(!ownedScene)
+            ownedScene.reset(importer.GetOrphanedScene());
+        meshInstances = bakeInstances(ownedScene.get());
+    }
+
+    // meshes (and their chunks) with the same material end up next to each other
+    // this allows batching consecutive draws when the buffers are merged
+    std::vector<unsigned int> meshOrder(scene->mNumMeshes);
+    for(unsigned int i = 0; i < scene->mNumMeshes; i++)
+    {
+        meshOrder[i] = i;
+    }
+    std::stable_sort(meshOrder.begin(), meshOrder.end(), [scene](unsigned int a, unsigned int b) {
+        return scene->mMeshes[a]->mMaterialIndex < scene->mMeshes[b]->mMaterialIndex;
+    });
+
+    // materials come first so meshes can be drawn as soon as they're added
+    // update doesn't touch them until materialsReady is set
+    char dir[bx::kMaxFilePath] = "";
+    bx::strCopy(dir, BX_COUNTOF(dir), bx::FilePath(state.file.c_str()).getPath());
+    for(unsigned int i = 0; i < scene->mNumMaterials; i++)
+    {
+        try
+        {
+            materials.push_back(loadMaterial(scene->mMaterials[i], scene, dir, i));
+        }
+        catch(std::exception& e)
+        {
+            // material not loaded, use default
+            // really only happens if there is no diffuse color
+            materials.push_back(Material());
+            Log->warn("{}", e.what());
+            // textures queued before the error
+            for(PendingTexture& pending : pendingTextures)
+            {
+                pending.users.erase(std::remove_if(pending.users.begin(),
+                                                   pending.users.end(),
+                                                   [i](const PendingTexture::User& user) {
+                                                       return user.material == i;
+                                                   }),
+                                    pending.users.end());
+            }
+        }
+    }
+
+    if(scene->HasCameras())
+    {
+        const aiCamera* cam = scene->mCameras[0];
+        // without instancing, aiProcess_PreTransformVertices already applied the node transformation
+        const aiNode* node = meshesInstanced ? scene->mRootNode->FindNode(cam->mName) : nullptr;
+        state.camera = loadCamera(cam, node ? nodeTransform(node) : glm::mat4(1.0f));
+        state.hasCamera = true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.converted.resize(meshOrder.size());
+        state.meshReady.assign(meshOrder.size(), 0);
+        state.materialsReady = true;
+    }
+
+    // all meshes in a merged buffer are quantized to the scene bounds
+    if(buffersMerged && verticesQuantized)
+    {
+        // per-mesh boxes in parallel, reduced on this thread
+        // instanced meshes use their own bounds
+        quantizationBounds.min = glm::vec3(std::numeric_limits<float>::max());
+        quantizationBounds.max = glm::vec3(-std::numeric_limits<float>::max());
+        std::vector<AABB> meshBounds(scene->mNumMeshes, quantizationBounds);
+        auto bound = [&](uint32_t i, uint32_t) {
+            const aiMesh* mesh = scene->mMeshes[i];
+            if(meshInstances[i].empty())
+                meshBounds[i] = AABB::around((const float*)mesh->mVertices, mesh->mNumVertices);
+        };
+        if(threads)
+            threads->parallelFor(scene->mNumMeshes, bound);
+        else
+        {
+            for(uint32_t i = 0; i < scene->mNumMeshes; i++)
+            {
+                bound(i, 0);
+            }
+        }
+        for(const AABB& box : meshBounds)
+        {
+            quantizationBounds.min = glm::min(quantizationBounds.min, box.min);
+            quantizationBounds.max = glm::max(quantizationBounds.max, box.max);
+        }
+    }
+
+    // meshes are converted on all threads, update adds them in order
+    state.step = LoadState::Converting;
+    state.completed = 0;
+    state.total = uint32_t(meshOrder.size());
+    auto convert = [&](uint32_t task, uint32_t worker) {
+        if(state.cancel)
+            return;
+        unsigned int i = meshOrder[task];
+        ConvertedMesh& converted = state.converted[task];
+        try
+        {
+            converted = convertMesh(scene->mMeshes[i], meshInstances[i]);
+        }
+        catch(std::exception& e)
+        {
+            converted.error = e.what();
+        }
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.meshReady[task] = 1;
+            state.meshesConverted++;
+        }
+        state.completed++;
+
+        // worker 0 is the calling thread for synchronous loads, add whatever is done between conversions
+        if(!state.async && worker == 0)
+            update();
+    };
+    if(threads)
+        threads->parallelFor(uint32_t(meshOrder.size()), convert);
+    else
+    {
+        for(uint32_t task = 0; task < meshOrder.size(); task++)
+        {
+            convert(task, 0);
+        }
+    }
+
+    loadTextures();
+
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.imported = true;
+}
+
+void Scene::update()
+{
+    if(!loadState)
+        return;
+    LoadState& state = *loadState;
+
+    // synchronous loads finish everything right away
+    const int64_t start = bx::getHPCounter();
+    auto hasTime = [&state, start]() {
+        return !state.async || millisecondsSince(start) < UPDATE_BUDGET;
+    };
+
+    bool materialsReady, imported, failed, allConverted;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        materialsReady = state.materialsReady;
+        imported = state.imported;
+        failed = state.failed;
+        allConverted = state.meshesConverted == state.converted.size();
+    }
+
+    if(failed)
+    {
+        clear();
+        return;
+    }
+    if(!materialsReady)
+        return;
+
+    if(!loaded)
+    {
+        // materials use the default textures until theirs are created
+        if(state.hasCamera)
+            camera = state.camera;
+        loaded = true;
+        materialRevision++;
+    }
+
+    // meshes are added in order to keep the material sorting
+    // merged buffers can only be created once all meshes are converted, that's not worth spreading out
+    const uint32_t firstMesh = state.nextMesh;
+    if(!buffersMerged || allConverted)
+    {
+        while(state.nextMesh < state.converted.size() && (buffersMerged || hasTime()))
+        {
+            {
+                std::lock_guard<std::mutex> lock(state.mutex);
+                if(!state.meshReady[state.nextMesh])
+                    break;
+            }
+            ConvertedMesh& mesh = state.converted[state.nextMesh++];
+            if(mesh.error.empty())
+                addMesh(mesh);
+            else
+                Log->warn("{}", mesh.error);
+            // free the vertex data early, it's copied by now
+            mesh = ConvertedMesh();
+        }
+    }
+    if(!state.geometryDone && state.nextMesh == state.converted.size())
+        finishGeometry();
+    else if(state.nextMesh != firstMesh)
+        geometryRevision++;
+
+    // texture arrays need all of their layers, they're created by finishLoad
+    if(!texturesInArrays)
+    {
+        std::vector<uint32_t> decoded;
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            decoded.swap(state.decoded);
+        }
+        size_t created = 0;
+        for(; created < decoded.size() && (created == 0 || hasTime()); created++)
+        {
+            createPendingTexture(pendingTextures[decoded[created]]);
+        }
+        if(created > 0)
+            materialRevision++;
+        state.texturesCreated += uint32_t(created);
+        // the rest waits for the next update
+        if(created < decoded.size())
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.decoded.insert(state.decoded.begin(), decoded.begin() + created, decoded.end());
+        }
+    }
+
+    if(imported)
+    {
+        // pendingTextures isn't touched by the importing thread anymore
+        state.step = LoadState::Uploading;
+        state.completed = state.nextMesh + state.texturesCreated;
+        state.total = uint32_t(state.converted.size() + (texturesInArrays ? 0 : pendingTextures.size()));
+
+        bool texturesDone;
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            texturesDone = state.decoded.empty();
+        }
+        if(state.geometryDone && texturesDone)
+            finishLoad();
+    }
+}
+
+void Scene::updateStreaming(const std::vector<float>& materialDemand, uint64_t budget)
+{
+    if(!texturesStreamed || loading())
+        return;
+
+    for(size_t i = 0; i < materials.size() && i < materialDemand.size(); i++)
+    {
+        for(bgfx::TextureHandle Material::*texture : MATERIAL_TEXTURES)
+        {
+            if(bgfx::isValid(materials[i].*texture))
+                streamer.request(materials[i].*texture, materialDemand[i]);
+        }
+    }
+
+    streamSwaps.clear();
+    streamer.update(budget, streamSwaps);
+    if(streamSwaps.empty())
+        return;
+
+    // material slots sharing a texture switch together, the cache moves their references over
+    std::unordered_map<uint16_t, bgfx::TextureHandle> replacements;
+    for(const TextureStreamer::Swap& swap : streamSwaps)
+    {
+        replacements[swap.from.idx] = swap.to;
+    }
+    for(Material& material : materials)
+    {
+        for(bgfx::TextureHandle Material::*texture : MATERIAL_TEXTURES)
+        {
+            auto replacement = replacements.find((material.*texture).idx);
+            if(bgfx::isValid(material.*texture) && replacement != replacements.end())
+                material.*texture = replacement->second;
+        }
+    }
+    for(const TextureStreamer::Swap& swap : streamSwaps)
+    {
+        textureCache.replace(swap.from, swap.to, swap.bytes);
+    }
+    materialRevision++;
+}
+
+const char* Scene::loadProgress(float& progress) const
+{
+    static const char* const STEPS[] = { "Importing", "Converting meshes", "Decoding textures", "Uploading" };
+
+    progress = 0.0f;
+    if(!loadState)
+        return "";
+    const uint32_t total = loadState->total;
+    if(total > 0)
+        progress = std::min(float(loadState->completed) / float(total), 1.0f);
+    return STEPS[loadState->step];
+}
+
+void Scene::finishGeometry()
+{
+    if(buffersMerged && !mergedVertexData.empty())
+    {
+        if(cacheWriter)
+        {
+            CacheBuffers buffers;
+            buffers.vertices = cacheWriter->add(mergedVertexData.data(), mergedVertexData.size());
+            buffers.indices = cacheWriter->add(mergedIndices.data(), mergedIndices.size() * sizeof(uint32_t));
+            cacheBuffers.push_back(buffers);
+        }
+        vertexBuffer = bgfx::createVertexBuffer(
+            bgfx::copy(mergedVertexData.data(), uint32_t(mergedVertexData.size())), vertexLayout());
+        indexBuffer = bgfx::createIndexBuffer(
+            bgfx::copy(mergedIndices.data(), uint32_t(mergedIndices.size() * sizeof(uint32_t))), BGFX_BUFFER_INDEX32);
+        for(Mesh& mesh : meshes)
+        {
+            mesh.vertexBuffer = vertexBuffer;
+            mesh.indexBuffer = indexBuffer;
+        }
+    }
+    // only needed during loading
+    mergedVertexData = std::vector<uint8_t>();
+    mergedIndices = std::vector<uint32_t>();
+
+    center = minBounds + (maxBounds - minBounds) / 2.0f;
+    glm::vec3 extent = glm::abs(maxBounds - minBounds);
+    diagonal = glm::sqrt(glm::dot(extent, extent));
+
+    if(!loadState->hasCamera)
+    {
+        Log->info("No camera");
+        camera.lookAt(center - glm::vec3(0.0f, 0.0f, diagonal / 2.0f), center, glm::vec3(0.0f, 1.0f, 0.0f));
+        camera.zFar = diagonal;
+        camera.zNear = camera.zFar / 50.0f;
+    }
+
+    loadState->geometryDone = true;
+    geometryRevision++;
+}
+
+void Scene::finishLoad()
+{
+    if(texturesInArrays)
+    {
+        buildTextureArrays();
+        materialRevision++;
+    }
+    logTextureSharing();
+
+    if(cacheWriter)
+        writeCache();
+    Log->info("Loaded scene with {} in {:.0f} ms",
+              loadState->nativeGltf ? "glTF loader" : "assimp",
+              millisecondsSince(loadState->start));
+
+    endLoad();
+}
+
+void Scene::endLoad()
+{
+    if(!loadState)
+        return;
+
+    loadState->cancel = true;
+    if(loadThread.joinable())
+        loadThread.join();
+
+    // decoded images that never became a texture
+    for(PendingTexture& pending : pendingTextures)
+    {
+        if(pending.image)
+            freeImage(pending.image, pending.mapped);
+    }
+    pendingTextures.clear();
+    pendingTextureFiles.clear();
+    mergedVertexData = std::vector<uint8_t>();
+    mergedIndices = std::vector<uint32_t>();
+
+    if(cacheWriter)
+        cacheWriter->abort();
+    cacheWriter.reset();
+    cacheBuffers.clear();
+    compressor.reset();
+    cacheTextures.clear();
+
+    loadState.reset();
+}
+
+bool Scene::loadCache(const char* file, const SceneCache::Key& key)
+{
+    SceneCache cache;
+    if(!cache.open(file, key))
+        return false;
+
+    struct Blob
+    {
+        const uint8_t* data;
+        size_t size;
+    };
+    std::vector<Blob> vertexBlobs, indexBlobs, textureBlobs;
+    std::vector<CacheTexture> textures;
+
+    // read and check everything before creating GPU resources
     try
     {
-        scene = importer.ReadFile(file, flags);
+        size_t size;
+        const uint8_t* data = cache.blob(cache.root(), size);
+        SceneCache::InStream in(data, size);
+
+        minBounds = in.read<glm::vec3>();
+        maxBounds = in.read<glm::vec3>();
+        center = in.read<glm::vec3>();
+        diagonal = in.read<float>();
+        camera = in.read<Camera>();
+
+        std::vector<CacheBuffers> buffers;
+        in.read(buffers);
+        meshes.resize(size_t(in.read<uint64_t>()));
+        if(buffers.size() != (buffersMerged ? std::min(meshes.size(), size_t(1)) : meshes.size()))
+            throw std::runtime_error("Scene cache has the wrong number of buffers");
+        for(const CacheBuffers& entry : buffers)
+        {
+            vertexBlobs.push_back({ cache.blob(entry.vertices, size), 0 });
+            vertexBlobs.back().size = size;
+            indexBlobs.push_back({ cache.blob(entry.indices, size), 0 });
+            indexBlobs.back().size = size;
+        }
+
+        for(Mesh& mesh : meshes)
+        {
+            mesh.material = in.read<unsigned int>();
+            mesh.firstIndex = in.read<uint32_t>();
+            mesh.positionScale = in.read<glm::vec3>();
+            mesh.positionOffset = in.read<glm::vec3>();
+            mesh.aabb = in.read<AABB>();
+            mesh.sphere = in.read<Sphere>();
+            mesh.uvDensity = in.read<float>();
+            mesh.firstChunk = in.read<uint32_t>();
+            mesh.numChunks = in.read<uint32_t>();
+            in.read(mesh.instances);
+            mesh.instanceBounds.resize(mesh.instances.size());
+            for(size_t i = 0; i < mesh.instances.size(); i++)
+            {
+                AABB box = in.read<AABB>();
+                mesh.instanceBounds.set(i, box, in.read<float>());
+            }
+            in.read(mesh.positions);
+            in.read(mesh.indices);
+        }
+        in.read(chunks);
+
+        materials.resize(size_t(in.read<uint64_t>()));
+        for(Material& material : materials)
+        {
+            material = in.read<Material>();
+        }
+        in.read(textures);
+        for(const CacheTexture& texture : textures)
+        {
+            textureBlobs.push_back({ cache.blob(texture.blob, size), 0 });
+            textureBlobs.back().size = size;
+        }
+        for(const Material& material : materials)
+        {
+            for(bgfx::TextureHandle Material::*texture : MATERIAL_TEXTURES)
+            {
+                if(bgfx::isValid(material.*texture) && (material.*texture).idx >= textures.size())
+                    throw std::runtime_error("Invalid scene cache texture");
+            }
+        }
     }
     catch(const std::exception& e)
     {
-        Log->error("{}", e.what());
+        Log->warn("Scene cache {}: {}", file, e.what());
+        meshes.clear();
+        chunks.clear();
+        materials.clear();
+        clear();
+        return false;
+    }
+
+    // vertex, index and texture data is passed to bgfx straight from the mapped file
+    // bgfx references keep the file mapped until the uploads are done
+    MappedFile* mapping = cache.mapping();
+    auto makeRef = [mapping](const Blob& blob) {
+        return mapping->makeRef(blob.data, uint32_t(blob.size));
+    };
+
+    if(buffersMerged && !vertexBlobs.empty())
+    {
+        vertexBuffer = bgfx::createVertexBuffer(makeRef(vertexBlobs[0]), vertexLayout());
+        indexBuffer = bgfx::createIndexBuffer(makeRef(indexBlobs[0]), BGFX_BUFFER_INDEX32);
+    }
+    for(size_t i = 0; i < meshes.size(); i++)
+    {
+        if(buffersMerged)
+        {
+            meshes[i].vertexBuffer = vertexBuffer;
+            meshes[i].indexBuffer = indexBuffer;
+        }
+        else
+        {
+            meshes[i].vertexBuffer = bgfx::createVertexBuffer(makeRef(vertexBlobs[i]), vertexLayout());
+            meshes[i].indexBuffer = bgfx::createIndexBuffer(makeRef(indexBlobs[i]));
+        }
     }
 
-    if(scene)
+    std::vector<bgfx::TextureHandle> handles(textures.size(), BGFX_INVALID_HANDLE);
+    for(size_t i = 0; i < textures.size(); i++)
     {
-        if(!(scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE))
+        const CacheTexture& texture = textures[i];
+        const bgfx::TextureFormat::Enum format = (bgfx::TextureFormat::Enum)texture.format;
+        if(!bgfx::isTextureValid(0, false, texture.numLayers, format, texture.flags))
         {
-            for(unsigned int i = 0; i < scene->mNumMeshes; i++)
+            Log->warn("Unsupported image format");
+            continue;
+        }
+
+        TextureStreamer::Desc desc;
+        desc.width = texture.width;
+        desc.height = texture.height;
+        desc.numMips = texture.hasMips != 0 ? bimg::imageGetNumMips((bimg::TextureFormat::Enum)format,
+                                                                    texture.width,
+                                                                    texture.height)
+                                            : 1;
+        desc.format = format;
+        desc.flags = texture.flags;
+        if(texturesStreamed && textureBlobs[i].size <= UINT32_MAX &&
+           TextureStreamer::streamable(desc, texture.numLayers, uint32_t(textureBlobs[i].size)))
+        {
+            TextureStreamer::Source* source =
+                TextureStreamer::Source::fromMapping(mapping, textureBlobs[i].data, uint32_t(textureBlobs[i].size));
+            handles[i] = streamer.add(source, desc);
+            textureCache.add(handles[i], streamer.residentBytes(handles[i]));
+        }
+        else
+        {
+            handles[i] = bgfx::createTexture2D(texture.width,
+                                               texture.height,
+                                               texture.hasMips != 0,
+                                               texture.numLayers,
+                                               format,
+                                               texture.flags,
+                                               makeRef(textureBlobs[i]));
+            textureCache.add(handles[i], textureBlobs[i].size, texture.numLayers);
+        }
+    }
+    for(Material& material : materials)
+    {
+        for(bgfx::TextureHandle Material::*texture : MATERIAL_TEXTURES)
+        {
+            if(bgfx::isValid(material.*texture))
             {
-                try
-                {
-                    meshes.push_back(loadMesh(scene->mMeshes[i]));
-                }
-                catch(std::exception& e)
-                {
-                    Log->warn("{}", e.what());
-                }
+                material.*texture = handles[(material.*texture).idx];
+                if(bgfx::isValid(material.*texture))
+                    textureCache.acquire(material.*texture);
             }
+        }
+    }
+    logTextureSharing();
 
-            center = minBounds + (maxBounds - minBounds) / 2.0f;
-            glm::vec3 extent = glm::abs(maxBounds - minBounds);
-            diagonal = glm::sqrt(glm::dot(extent, extent));
+    cache.close();
 
-            char dir[bx::kMaxFilePath] = "";
-            bx::strCopy(dir, BX_COUNTOF(dir), bx::FilePath(file).getPath());
-            for(unsigned int i = 0; i < scene->mNumMaterials; i++)
+    chunkBounds.resize(chunks.size());
+    for(size_t i = 0; i < chunks.size(); i++)
+    {
+        chunkBounds.set(i, chunks[i].aabb, chunks[i].sphere.radius);
+    }
+
+    loaded = true;
+    loadedFromCache = true;
+    return true;
+}
+
+void Scene::writeCache()
+{
+    SceneCache::OutStream out;
+
+    out.write(minBounds);
+    out.write(maxBounds);
+    out.write(center);
+    out.write(diagonal);
+    out.write(camera);
+
+    out.write(cacheBuffers);
+    out.write(uint64_t(meshes.size()));
+    for(const Mesh& mesh : meshes)
+    {
+        out.write(mesh.material);
+        out.write(mesh.firstIndex);
+        out.write(mesh.positionScale);
+        out.write(mesh.positionOffset);
+        out.write(mesh.aabb);
+        out.write(mesh.sphere);
+        out.write(mesh.uvDensity);
+        out.write(mesh.firstChunk);
+        out.write(mesh.numChunks);
+        out.write(mesh.instances);
+        // BoundsSoA only takes them one at a time
+        for(size_t i = 0; i < mesh.instanceBounds.size(); i++)
+        {
+            const BoundsSoA::Block& block = mesh.instanceBounds.data()[i / BoundsSoA::LANES];
+            const size_t lane = i % BoundsSoA::LANES;
+            const glm::vec3 boxCenter = { block.centerX[lane], block.centerY[lane], block.centerZ[lane] };
+            const glm::vec3 boxExtents = { block.extentX[lane], block.extentY[lane], block.extentZ[lane] };
+            AABB box;
+            box.min = boxCenter - boxExtents;
+            box.max = boxCenter + boxExtents;
+            out.write(box);
+            out.write(block.radius[lane]);
+        }
+        out.write(mesh.positions);
+        out.write(mesh.indices);
+    }
+    out.write(chunks);
+
+    // texture handles are stored as indices into the texture list
+    std::vector<CacheTexture> textures;
+    std::unordered_map<uint16_t, uint16_t> textureIndices;
+    out.write(uint64_t(materials.size()));
+    for(Material material : materials)
+    {
+        for(bgfx::TextureHandle Material::*texture : MATERIAL_TEXTURES)
+        {
+            bgfx::TextureHandle& handle = material.*texture;
+            if(!bgfx::isValid(handle))
+                continue;
+            auto inserted = textureIndices.emplace(handle.idx, uint16_t(textures.size()));
+            if(inserted.second)
             {
-                try
-                {
-                    materials.push_back(loadMaterial(scene->mMaterials[i], dir));
-                }
-                catch(std::exception& e)
+                auto cached = cacheTextures.find(handle.idx);
+                if(cached == cacheTextures.end())
                 {
-                    // material not loaded, use default
-                    // really only happens if there is no diffuse color
-                    materials.push_back(Material());
-                    Log->warn("{}", e.what());
+                    Log->warn("Texture missing from the scene cache");
+                    return;
                 }
+                textures.push_back(cached->second);
             }
+            handle.idx = inserted.first->second;
+        }
+        out.write(material);
+    }
+    out.write(textures);
+
+    cacheWriter->commit(cacheWriter->add(out.data().data(), out.data().size()));
+}
+
+std::vector<std::vector<glm::mat4>> Scene::bakeInstances(aiScene* scene)
+{
+    std::vector<std::vector<glm::mat4>> instances(scene->mNumMeshes);
+
+    struct NodeTransform
+    {
+        const aiNode* node;
+        glm::mat4 parent;
+    };
+    std::vector<NodeTransform> stack = { { scene->mRootNode, glm::mat4(1.0f) } };
+    while(!stack.empty())
+    {
+        NodeTransform entry = stack.back();
+        stack.pop_back();
 
-            // bring opaque meshes to the front so alpha blending works
-            // still need depth sorting for scenes with overlapping transparent meshes
-            std::partition(
-                meshes.begin(), meshes.end(), [this](const Mesh& mesh) { return !materials[mesh.material].blend; });
+        // aiMatrix4x4 is row-major
+        glm::mat4 world = entry.parent * glm::transpose(glm::make_mat4(&entry.node->mTransformation.a1));
+        for(unsigned int i = 0; i < entry.node->mNumMeshes; i++)
+        {
+            instances[entry.node->mMeshes[i]].push_back(world);
+        }
+        for(unsigned int i = 0; i < entry.node->mNumChildren; i++)
+        {
+            stack.push_back({ entry.node->mChildren[i], world });
+        }
+    }
 
-            if(scene->HasCameras())
+    // meshes used once don't need instancing, move them to world space
+    // unused meshes stay untransformed
+    for(unsigned int i = 0; i < scene->mNumMeshes; i++)
+    {
+        if(instances[i].size() != 1)
+            continue;
+
+        aiMesh* mesh = scene->mMeshes[i];
+        const glm::mat4& model = instances[i][0];
+        // cofactor matrix, see Renderer::setNormalMatrix
+        const glm::mat3 normalMat = glm::transpose(glm::adjugate(glm::mat3(model)));
+        for(unsigned int v = 0; v < mesh->mNumVertices; v++)
+        {
+            aiVector3D& pos = mesh->mVertices[v];
+            glm::vec3 p = glm::vec3(model * glm::vec4(pos.x, pos.y, pos.z, 1.0f));
+            pos = aiVector3D(p.x, p.y, p.z);
+            if(mesh->mNormals)
             {
-                camera = loadCamera(scene->mCameras[0]);
+                aiVector3D& nrm = mesh->mNormals[v];
+                glm::vec3 n = glm::normalize(normalMat * glm::vec3(nrm.x, nrm.y, nrm.z));
+                nrm = aiVector3D(n.x, n.y, n.z);
             }
-            else
+            if(mesh->mTangents)
             {
-                Log->info("No camera");
-                camera.lookAt(center - glm::vec3(0.0f, 0.0f, diagonal / 2.0f), center, glm::vec3(0.0f, 1.0f, 0.0f));
-                camera.zFar = diagonal;
-                camera.zNear = camera.zFar / 50.0f;
+                aiVector3D& tan = mesh->mTangents[v];
+                glm::vec3 t = glm::normalize(glm::mat3(model) * glm::vec3(tan.x, tan.y, tan.z));
+                tan = aiVector3D(t.x, t.y, t.z);
+            }
+            if(mesh->mBitangents)
+            {
+                aiVector3D& bit = mesh->mBitangents[v];
+                glm::vec3 b = glm::normalize(glm::mat3(model) * glm::vec3(bit.x, bit.y, bit.z));
+                bit = aiVector3D(b.x, b.y, b.z);
             }
-
-            loaded = true;
         }
-        else
-            Log->error("Scene is incomplete or invalid");
+        instances[i].clear();
     }
 
-    return loaded;
+    return instances;
+}
+
+glm::mat4 Scene::nodeTransform(const aiNode* node)
+{
+    glm::mat4 world = glm::mat4(1.0f);
+    for(; node; node = node->mParent)
+    {
+        world = glm::transpose(glm::make_mat4(&node->mTransformation.a1)) * world;
+    }
+    return world;
 }
 
-Mesh Scene::loadMesh(const aiMesh* mesh)
+Scene::ConvertedMesh Scene::convertMesh(const aiMesh* mesh, const std::vector<glm::mat4>& instances) const
 {
     if(mesh->mPrimitiveTypes != aiPrimitiveType_TRIANGLE)
         throw std::runtime_error("Mesh has incompatible primitive type");
 
-    if(mesh->mNumVertices > (std::numeric_limits<uint16_t>::max() + 1u))
+    if(!buffersMerged && mesh->mNumVertices > (std::numeric_limits<uint16_t>::max() + 1u))
         throw std::runtime_error("Mesh has too many vertices (> uint16_t::max + 1)");
 
     constexpr size_t coords = 0;
     bool hasTexture = mesh->mNumUVComponents[coords] == 2 && mesh->mTextureCoords[coords] != nullptr;
 
-    // vertices
+    ConvertedMesh converted;
+    Mesh& out = converted.mesh;
 
-    uint32_t stride = Mesh::PosNormalTangentTex0Vertex::layout.getStride();
+    // vertices
 
-    const bgfx::Memory* vertexMem = bgfx::alloc(mesh->mNumVertices * stride);
+    std::vector<Mesh::PosNormalTangentTex0Vertex> vertices(mesh->mNumVertices);
+    out.positions.resize(mesh->mNumVertices);
 
     for(unsigned int i = 0; i < mesh->mNumVertices; i++)
     {
-        unsigned int offset = i * stride;
-        Mesh::PosNormalTangentTex0Vertex& vertex = *(Mesh::PosNormalTangentTex0Vertex*)(vertexMem->data + offset);
+        Mesh::PosNormalTangentTex0Vertex& vertex = vertices[i];
 
         aiVector3D pos = mesh->mVertices[i];
         vertex.x = pos.x;
         vertex.y = pos.y;
         vertex.z = pos.z;
-
-        minBounds = glm::min(minBounds, { pos.x, pos.y, pos.z });
-        maxBounds = glm::max(maxBounds, { pos.x, pos.y, pos.z });
+        out.positions[i] = { pos.x, pos.y, pos.z };
 
         aiVector3D nrm = mesh->mNormals[i];
         vertex.nx = nrm.x;
@@ -219,6 +1094,15 @@ Mesh Scene::loadMesh(const aiMesh* mesh)
         vertex.ty = tan.y;
         vertex.tz = tan.z;
 
+        // the shaders calculate the bitangent as cross(N, T) * sign, mirrored UVs flip it
+        vertex.tw = 1.0f;
+        if(mesh->mBitangents)
+        {
+            aiVector3D bit = mesh->mBitangents[i];
+            glm::vec3 cross = glm::cross(glm::vec3(nrm.x, nrm.y, nrm.z), glm::vec3(tan.x, tan.y, tan.z));
+            vertex.tw = glm::dot(cross, glm::vec3(bit.x, bit.y, bit.z)) < 0.0f ? -1.0f : 1.0f;
+        }
+
         if(hasTexture)
         {
             aiVector3D uv = mesh->mTextureCoords[coords][i];
@@ -227,27 +1111,359 @@ Mesh Scene::loadMesh(const aiMesh* mesh)
         }
     }
 
-    bgfx::VertexBufferHandle vbh = bgfx::createVertexBuffer(vertexMem, Mesh::PosNormalTangentTex0Vertex::layout);
+    // bounding sphere around the box center
+    // usually tighter than the sphere around the box
+    out.aabb = AABB::around((const float*)out.positions.data(), out.positions.size());
+    out.sphere = Sphere::around(out.aabb.center(), (const float*)out.positions.data(), out.positions.size());
+
+    // square root of the UV area over the surface area, both summed over all triangles
+    if(hasTexture)
+    {
+        double uvArea = 0.0;
+        double area = 0.0;
+        for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+        {
+            const aiFace& face = mesh->mFaces[i];
+            const glm::vec3 a = out.positions[face.mIndices[0]];
+            const glm::vec3 b = out.positions[face.mIndices[1]];
+            const glm::vec3 c = out.positions[face.mIndices[2]];
+            area += glm::length(glm::cross(b - a, c - a));
+            const glm::vec2 uvA = { vertices[face.mIndices[0]].u, vertices[face.mIndices[0]].v };
+            const glm::vec2 uvB = { vertices[face.mIndices[1]].u, vertices[face.mIndices[1]].v };
+            const glm::vec2 uvC = { vertices[face.mIndices[2]].u, vertices[face.mIndices[2]].v };
+            const glm::vec2 e0 = uvB - uvA;
+            const glm::vec2 e1 = uvC - uvA;
+            uvArea += glm::abs(e0.x * e1.y - e0.y * e1.x);
+        }
+        if(area > 0.0 && uvArea > 0.0)
+            out.uvDensity = float(glm::sqrt(uvArea / area));
+    }
+
+    if(instances.empty())
+    {
+        converted.bounds = out.aabb;
+    }
+    else
+    {
+        converted.bounds.min = glm::vec3(std::numeric_limits<float>::max());
+        converted.bounds.max = glm::vec3(-std::numeric_limits<float>::max());
+        out.instances = instances;
+        out.instanceBounds.resize(instances.size());
+        const glm::vec3 extents = out.aabb.extents();
+        for(size_t i = 0; i < instances.size(); i++)
+        {
+            // box around the transformed box, sphere scaled by the largest axis scale
+            const glm::mat4& model = instances[i];
+            glm::mat3 absolute = glm::mat3(glm::abs(glm::vec3(model[0])),
+                                           glm::abs(glm::vec3(model[1])),
+                                           glm::abs(glm::vec3(model[2])));
+            glm::vec3 center = glm::vec3(model * glm::vec4(out.sphere.center, 1.0f));
+            glm::vec3 worldExtents = absolute * extents;
+            float scale = glm::max(glm::length(glm::vec3(model[0])),
+                                   glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+            AABB box;
+            box.min = center - worldExtents;
+            box.max = center + worldExtents;
+            out.instanceBounds.set(i, box, out.sphere.radius * scale);
+            converted.bounds.min = glm::min(converted.bounds.min, box.min);
+            converted.bounds.max = glm::max(converted.bounds.max, box.max);
+        }
+    }
+
+    // encode in the scene's vertex format
+
+    const bgfx::VertexLayout& layout = vertexLayout();
+    converted.vertexData.resize(vertices.size() * layout.getStride());
+    if(verticesQuantized)
+    {
+        // merged buffers share one dequantization, otherwise use the tighter mesh bounds
+        // instanced meshes are in object space and drawn on their own
+        const AABB& box = buffersMerged && instances.empty() ? quantizationBounds : out.aabb;
+        out.positionOffset = box.center();
+        out.positionScale = box.extents();
+
+        Mesh::QuantizedVertex::quantize((Mesh::QuantizedVertex*)converted.vertexData.data(),
+                                        vertices.data(),
+                                        vertices.size(),
+                                        out.positionOffset,
+                                        out.positionScale);
+    }
+    else
+    {
+        std::memcpy(converted.vertexData.data(), vertices.data(), converted.vertexData.size());
+    }
 
     // indices (triangles)
 
-    const bgfx::Memory* iMem = bgfx::alloc(mesh->mNumFaces * 3 * sizeof(uint16_t));
-    uint16_t* indices = (uint16_t*)iMem->data;
+    out.indices.resize(mesh->mNumFaces * 3);
+    uint32_t* indices = out.indices.data();
+
+    if(instances.empty())
+    {
+        converted.chunks = buildChunks(mesh, indices);
+        for(MeshChunk& chunk : converted.chunks)
+        {
+            chunk.lods[0].firstIndex = chunk.firstIndex;
+            chunk.lods[0].numIndices = chunk.numIndices;
+        }
+    }
+    else
+    {
+        // culled and drawn per instance, chunk bounds would have to be transformed
+        for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+        {
+            const aiFace& face = mesh->mFaces[i];
+            for(unsigned int v = 0; v < 3; v++)
+            {
+                indices[i * 3 + v] = face.mIndices[v];
+            }
+        }
+    }
+
+    // LOD indices go after the full resolution indices, chunks stay contiguous at level 0
+    if(generateLods)
+    {
+        for(MeshChunk& chunk : converted.chunks)
+        {
+            buildLods(chunk, out.positions, out.indices);
+        }
+    }
+
+    out.material = mesh->mMaterialIndex;
+    return converted;
+}
+
+void Scene::addMesh(ConvertedMesh& converted)
+{
+    Mesh& out = converted.mesh;
+
+    minBounds = glm::min(minBounds, converted.bounds.min);
+    maxBounds = glm::max(maxBounds, converted.bounds.max);
+
+    uint32_t meshIndex = uint32_t(meshes.size());
+    out.firstChunk = uint32_t(chunks.size());
+    out.numChunks = uint32_t(converted.chunks.size());
+    // backface culling is disabled for double-sided materials
+    const bool doubleSided = materials[out.material].doubleSided;
+    for(MeshChunk& chunk : converted.chunks)
+    {
+        chunk.mesh = meshIndex;
+        if(doubleSided)
+            chunk.cone = NormalCone();
+        chunks.push_back(chunk);
+    }
+    chunkBounds.resize(chunks.size());
+    for(size_t i = out.firstChunk; i < chunks.size(); i++)
+    {
+        chunkBounds.set(i, chunks[i].aabb, chunks[i].sphere.radius);
+    }
+
+    const std::vector<uint8_t>& vertexData = converted.vertexData;
+    const bgfx::VertexLayout& layout = vertexLayout();
+
+    if(buffersMerged)
+    {
+        // indices are absolute in the shared vertex buffer
+        // the handles get assigned once all meshes are loaded
+        uint32_t baseVertex = uint32_t(mergedVertexData.size() / layout.getStride());
+        out.firstIndex = uint32_t(mergedIndices.size());
+        mergedVertexData.insert(mergedVertexData.end(), vertexData.begin(), vertexData.end());
+        for(uint32_t index : out.indices)
+        {
+            mergedIndices.push_back(baseVertex + index);
+        }
+    }
+    else
+    {
+        const bgfx::Memory* iMem = bgfx::alloc(uint32_t(out.indices.size() * sizeof(uint16_t)));
+        uint16_t* indices16 = (uint16_t*)iMem->data;
+        for(size_t i = 0; i < out.indices.size(); i++)
+        {
+            indices16[i] = (uint16_t)out.indices[i];
+        }
+
+        // nothing throws after this, the mesh gets added
+        if(cacheWriter)
+        {
+            CacheBuffers buffers;
+            buffers.vertices = cacheWriter->add(vertexData.data(), vertexData.size());
+            buffers.indices = cacheWriter->add(iMem->data, iMem->size);
+            cacheBuffers.push_back(buffers);
+        }
+
+        out.vertexBuffer = bgfx::createVertexBuffer(bgfx::copy(vertexData.data(), uint32_t(vertexData.size())), layout);
+        out.indexBuffer = bgfx::createIndexBuffer(iMem);
+    }
+
+    meshes.push_back(std::move(out));
+}
+
+std::vector<MeshChunk> Scene::buildChunks(const aiMesh* mesh, uint32_t* indices)
+{
+    auto position = [mesh](unsigned int index) {
+        aiVector3D pos = mesh->mVertices[index];
+        return glm::vec3(pos.x, pos.y, pos.z);
+    };
 
+    std::vector<uint32_t> triangles(mesh->mNumFaces);
+    std::vector<glm::vec3> centroids(mesh->mNumFaces);
     for(unsigned int i = 0; i < mesh->mNumFaces; i++)
     {
-        assert(mesh->mFaces[i].mNumIndices == 3);
-        indices[(3 * i) + 0] = (uint16_t)mesh->mFaces[i].mIndices[0];
-        indices[(3 * i) + 1] = (uint16_t)mesh->mFaces[i].mIndices[1];
-        indices[(3 * i) + 2] = (uint16_t)mesh->mFaces[i].mIndices[2];
+        const aiFace& face = mesh->mFaces[i];
+        assert(face.mNumIndices == 3);
+        triangles[i] = i;
+        centroids[i] = (position(face.mIndices[0]) + position(face.mIndices[1]) + position(face.mIndices[2])) / 3.0f;
+    }
+
+    // recursive median split along the longest axis of the triangle centroids
+    // depth-first so neighbouring leaves end up next to each other in the index buffer
+
+    struct Range
+    {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    std::vector<Range> leaves;
+    std::vector<Range> stack = { { 0, mesh->mNumFaces } };
+    while(!stack.empty())
+    {
+        Range range = stack.back();
+        stack.pop_back();
+
+        if(range.count <= MAX_CHUNK_TRIANGLES)
+        {
+            leaves.push_back(range);
+            continue;
+        }
+
+        glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+        for(uint32_t i = range.first; i < range.first + range.count; i++)
+        {
+            min = glm::min(min, centroids[triangles[i]]);
+            max = glm::max(max, centroids[triangles[i]]);
+        }
+        glm::vec3 extent = max - min;
+        int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+        uint32_t half = range.count / 2;
+        std::vector<uint32_t>::iterator first = triangles.begin() + range.first;
+        std::nth_element(first, first + half, first + range.count, [&centroids, axis](uint32_t a, uint32_t b) {
+            return centroids[a][axis] < centroids[b][axis];
+        });
+
+        // second half first so the first half gets popped next
+        stack.push_back({ range.first + half, range.count - half });
+        stack.push_back({ range.first, half });
+    }
+
+    std::vector<MeshChunk> chunks;
+    chunks.reserve(leaves.size());
+
+    uint32_t offset = 0;
+    for(const Range& leaf : leaves)
+    {
+        MeshChunk chunk;
+        chunk.firstIndex = offset * 3;
+        chunk.numIndices = leaf.count * 3;
+
+        glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+        glm::vec3 normalSum = glm::vec3(0.0f);
+
+        // per triangle normals, needed twice for the cone
+        std::vector<glm::vec3> normals;
+        normals.reserve(leaf.count);
+
+        for(uint32_t i = leaf.first; i < leaf.first + leaf.count; i++)
+        {
+            const aiFace& face = mesh->mFaces[triangles[i]];
+            glm::vec3 p[3];
+            for(unsigned int v = 0; v < 3; v++)
+            {
+                indices[offset * 3 + v] = face.mIndices[v];
+                p[v] = position(face.mIndices[v]);
+                min = glm::min(min, p[v]);
+                max = glm::max(max, p[v]);
+            }
+            offset++;
+
+            // front face normal from the winding, the same test the rasterizer culls with
+            // front faces are CCW, mirroring z for the left-handed coordinates flipped the cross product
+            // vertex normals can disagree on the native glTF path since it has no aiProcess_FixInfacingNormals
+            glm::vec3 normal = glm::cross(p[2] - p[0], p[1] - p[0]);
+            float area = glm::length(normal);
+            // degenerate triangles don't restrict the cone
+            if(area <= std::numeric_limits<float>::epsilon())
+                continue;
+            normal /= area;
+
+            normals.push_back(normal);
+            normalSum += normal;
+        }
+
+        chunk.aabb.min = min;
+        chunk.aabb.max = max;
+        chunk.sphere.center = chunk.aabb.center();
+        float radius2 = 0.0f;
+        for(uint32_t i = chunk.firstIndex; i < chunk.firstIndex + chunk.numIndices; i++)
+        {
+            glm::vec3 d = position(indices[i]) - chunk.sphere.center;
+            radius2 = glm::max(radius2, glm::dot(d, d));
+        }
+        chunk.sphere.radius = glm::sqrt(radius2);
+
+        // normal cone around the average normal
+        // if the normals spread too far, the cone is useless and stays disabled
+        float sumLength = glm::length(normalSum);
+        if(sumLength > std::numeric_limits<float>::epsilon())
+        {
+            glm::vec3 axis = normalSum / sumLength;
+            float minDot = 1.0f;
+            for(const glm::vec3& normal : normals)
+            {
+                minDot = glm::min(minDot, glm::dot(axis, normal));
+            }
+            if(minDot > 0.1f)
+            {
+                chunk.cone.axis = axis;
+                chunk.cone.cutoff = glm::sqrt(1.0f - minDot * minDot);
+            }
+        }
+
+        chunks.push_back(chunk);
     }
 
-    bgfx::IndexBufferHandle ibh = bgfx::createIndexBuffer(iMem);
+    return chunks;
+}
+
+void Scene::buildLods(MeshChunk& chunk, const std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices)
+{
+    // chunk borders are locked, neighbouring chunks at different levels don't crack
+    MeshSimplifier simplifier(positions.data(), &indices[chunk.firstIndex], chunk.numIndices);
 
-    return { vbh, ibh, mesh->mMaterialIndex };
+    while(chunk.numLods < MeshChunk::MAX_LODS)
+    {
+        const MeshChunk::Lod& previous = chunk.lods[chunk.numLods - 1];
+        size_t target = previous.numIndices / 6 * 3; // half the triangles
+        if(target == 0 || !simplifier.simplify(target))
+            break;
+
+        std::vector<uint32_t> lodIndices = simplifier.getIndices();
+        if(lodIndices.size() > size_t(previous.numIndices * (1.0f - MIN_LOD_REDUCTION)))
+            break;
+
+        MeshChunk::Lod& lod = chunk.lods[chunk.numLods++];
+        lod.firstIndex = uint32_t(indices.size());
+        lod.numIndices = uint32_t(lodIndices.size());
+        lod.error = simplifier.getError();
+        indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+    }
 }
 
-Material Scene::loadMaterial(const aiMaterial* material, const char* dir)
+Material Scene::loadMaterial(const aiMaterial* material, const aiScene* scene, const char* dir, uint32_t index)
 {
     Material out;
 
@@ -276,10 +1492,14 @@ Material Scene::loadMaterial(const aiMaterial* material, const char* dir)
 
     if(fileBaseColor.length > 0)
     {
-        aiString pathBaseColor;
-        pathBaseColor.Set(dir);
-        pathBaseColor.Append(fileBaseColor.C_Str());
-        out.baseColorTexture = loadTexture(pathBaseColor.C_Str(), true /* sRGB */);
+        loadMaterialTexture(scene,
+                            dir,
+                            fileBaseColor,
+                            TextureCompressor::Role::Color,
+                            index,
+                            out,
+                            &Material::baseColorTexture,
+                            &Material::baseColorLayer);
     }
 
     aiColor4D baseColorFactor;
@@ -291,10 +1511,14 @@ Material Scene::loadMaterial(const aiMaterial* material, const char* dir)
 
     if(fileMetallicRoughness.length > 0)
     {
-        aiString pathMetallicRoughness;
-        pathMetallicRoughness.Set(dir);
-        pathMetallicRoughness.Append(fileMetallicRoughness.C_Str());
-        out.metallicRoughnessTexture = loadTexture(pathMetallicRoughness.C_Str());
+        loadMaterialTexture(scene,
+                            dir,
+                            fileMetallicRoughness,
+                            TextureCompressor::Role::Data,
+                            index,
+                            out,
+                            &Material::metallicRoughnessTexture,
+                            &Material::metallicRoughnessLayer);
     }
 
     ai_real metallicFactor;
@@ -308,10 +1532,14 @@ Material Scene::loadMaterial(const aiMaterial* material, const char* dir)
 
     if(fileNormals.length > 0)
     {
-        aiString pathNormals;
-        pathNormals.Set(dir);
-        pathNormals.Append(fileNormals.C_Str());
-        out.normalTexture = loadTexture(pathNormals.C_Str());
+        loadMaterialTexture(scene,
+                            dir,
+                            fileNormals,
+                            TextureCompressor::Role::Normal,
+                            index,
+                            out,
+                            &Material::normalTexture,
+                            &Material::normalLayer);
     }
 
     ai_real normalScale;
@@ -320,18 +1548,18 @@ Material Scene::loadMaterial(const aiMaterial* material, const char* dir)
 
     // occlusion texture
 
-    if(fileOcclusion == fileMetallicRoughness)
+    // some GLTF files combine metallic/roughness and occlusion values into one texture
+    // pending textures are shared by file path so it's only loaded once
+    if(fileOcclusion.length > 0)
     {
-        // some GLTF files combine metallic/roughness and occlusion values into one texture
-        // don't load it twice
-        out.occlusionTexture = out.metallicRoughnessTexture;
-    }
-    else if(fileOcclusion.length > 0)
-    {
-        aiString pathOcclusion;
-        pathOcclusion.Set(dir);
-        pathOcclusion.Append(fileOcclusion.C_Str());
-        out.occlusionTexture = loadTexture(pathOcclusion.C_Str());
+        loadMaterialTexture(scene,
+                            dir,
+                            fileOcclusion,
+                            TextureCompressor::Role::Data,
+                            index,
+                            out,
+                            &Material::occlusionTexture,
+                            &Material::occlusionLayer);
     }
 
     ai_real occlusionStrength;
@@ -342,10 +1570,14 @@ Material Scene::loadMaterial(const aiMaterial* material, const char* dir)
 
     if(fileEmissive.length > 0)
     {
-        aiString pathEmissive;
-        pathEmissive.Set(dir);
-        pathEmissive.Append(fileEmissive.C_Str());
-        out.emissiveTexture = loadTexture(pathEmissive.C_Str(), true /* sRGB */);
+        loadMaterialTexture(scene,
+                            dir,
+                            fileEmissive,
+                            TextureCompressor::Role::Color,
+                            index,
+                            out,
+                            &Material::emissiveTexture,
+                            &Material::emissiveLayer);
     }
 
     aiColor3D emissiveFactor;
@@ -356,12 +1588,14 @@ Material Scene::loadMaterial(const aiMaterial* material, const char* dir)
     return out;
 }
 
-Camera Scene::loadCamera(const aiCamera* camera)
+Camera Scene::loadCamera(const aiCamera* camera, const glm::mat4& transform)
 {
     float aspect = camera->mAspect == 0.0f ? 16.0f / 9.0f : camera->mAspect;
-    glm::vec3 pos(camera->mPosition.x, camera->mPosition.y, camera->mPosition.z);
-    glm::vec3 target(camera->mLookAt.x, camera->mLookAt.y, camera->mLookAt.z);
-    glm::vec3 up(camera->mUp.x, camera->mUp.y, camera->mUp.z);
+    // same as aiProcess_PreTransformVertices
+    glm::vec4 position = glm::vec4(camera->mPosition.x, camera->mPosition.y, camera->mPosition.z, 1.0f);
+    glm::vec3 pos = glm::vec3(transform * position);
+    glm::vec3 target = glm::mat3(transform) * glm::vec3(camera->mLookAt.x, camera->mLookAt.y, camera->mLookAt.z);
+    glm::vec3 up = glm::mat3(transform) * glm::vec3(camera->mUp.x, camera->mUp.y, camera->mUp.z);
 
     Camera cam;
     cam.lookAt(pos, target, up);
@@ -373,29 +1607,371 @@ Camera Scene::loadCamera(const aiCamera* camera)
     return cam;
 }
 
-bgfx::TextureHandle Scene::loadTexture(const char* file, bool sRGB)
+void Scene::loadMaterialTexture(const aiScene* scene,
+                                const char* dir,
+                                const aiString& file,
+                                TextureCompressor::Role role,
+                                uint32_t index,
+                                Material& material,
+                                bgfx::TextureHandle Material::*texture,
+                                uint16_t Material::*layer)
+{
+    // *index or the file name of an image inside the scene file
+    const aiTexture* embedded = scene->GetEmbeddedTexture(file.C_Str());
+    std::string path;
+    if(embedded)
+    {
+        const aiTexture* const* textures = scene->mTextures;
+        const size_t embeddedIndex = std::find(textures, textures + scene->mNumTextures, embedded) - textures;
+        path = loadState->file + "#" + std::to_string(embeddedIndex);
+    }
+    else
+    {
+        path = std::string(dir) + file.C_Str();
+        // the scene file is already a dependency
+        if(cacheWriter)
+            cacheWriter->addDependency(TextureCache::resolve(path.c_str()).c_str());
+    }
+
+    const std::string key = TextureCache::key(path.c_str(), role);
+    // reuse a texture that already exists, files queued by this load are deduplicated by pendingTextureFiles
+    uint16_t cachedLayer = 0;
+    const bgfx::TextureHandle cached = textureCache.find(key, &cachedLayer);
+    if(bgfx::isValid(cached))
+    {
+        material.*texture = cached;
+        material.*layer = cachedLayer;
+        textureCache.acquire(cached);
+        return;
+    }
+
+    auto inserted = pendingTextureFiles.emplace(key, uint32_t(pendingTextures.size()));
+    if(inserted.second)
+    {
+        PendingTexture pending;
+        pending.file = path;
+        pending.key = key;
+        pending.embedded = embedded;
+        pending.role = role;
+        pending.sRGB = role == TextureCompressor::Role::Color;
+        pendingTextures.push_back(pending);
+    }
+    pendingTextures[inserted.first->second].users.push_back({ index, texture, layer });
+}
+
+void Scene::loadTextures()
+{
+    LoadState& state = *loadState;
+    state.step = LoadState::Decoding;
+    state.completed = 0;
+    state.total = uint32_t(pendingTextures.size());
+    if(pendingTextures.empty())
+        return;
+
+    const int64_t start = bx::getHPCounter();
+    size_t references = 0;
+    for(const PendingTexture& pending : pendingTextures)
+    {
+        references += pending.users.size();
+    }
+
+    // GPU memory of the compressed textures and of the same textures as RGBA8
+    std::atomic<uint64_t> compressedBytes = { 0 };
+    std::atomic<uint64_t> uncompressedBytes = { 0 };
+
+    ThreadPool::TaskFunction decode = [this, &state, &compressedBytes, &uncompressedBytes](uint32_t task,
+                                                                                           uint32_t worker) {
+        if(state.cancel)
+            return;
+        PendingTexture& pending = pendingTextures[task];
+        try
+        {
+            if(compressor)
+                pending.image = loadCompressedImage(pending, pending.mapped);
+            else
+            {
+                bimg::ImageContainer* image = pending.embedded ? loadEmbeddedImage(pending.embedded)
+                                                               : loadImage(pending.file.c_str(), pending.mapped);
+                // DDS and KTX files are uploaded as they are
+                if(!pending.mapped)
+                    image = MipGenerator::generate(
+                        &allocator, image, pending.sRGB, pending.role == TextureCompressor::Role::Normal);
+                pending.image = image;
+            }
+        }
+        catch(const std::exception& e)
+        {
+            pending.error = e.what();
+        }
+        // before the image is handed to the main thread
+        if(compressor && pending.image)
+        {
+            const bimg::ImageContainer& image = *pending.image;
+            compressedBytes += image.m_size;
+            uncompressedBytes += bimg::imageGetSize(nullptr,
+                                                    uint16_t(image.m_width),
+                                                    uint16_t(image.m_height),
+                                                    uint16_t(image.m_depth),
+                                                    image.m_cubeMap,
+                                                    image.m_numMips > 1,
+                                                    image.m_numLayers,
+                                                    bimg::TextureFormat::RGBA8);
+        }
+        state.completed++;
+
+        // texture arrays need all of their layers
+        if(!texturesInArrays)
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.decoded.push_back(task);
+        }
+        // worker 0 is the calling thread for synchronous loads, upload whatever is done between decodes
+        if(!state.async && worker == 0)
+            update();
+    };
+
+    if(threads)
+        threads->parallelFor(uint32_t(pendingTextures.size()), decode);
+    else
+    {
+        for(uint32_t i = 0; i < pendingTextures.size(); i++)
+        {
+            decode(i, 0);
+        }
+    }
+
+    Log->info("Decoded {} textures in {:.0f} ms, skipped {} decodes of files used by several material slots",
+              pendingTextures.size(),
+              millisecondsSince(start),
+              references - pendingTextures.size());
+    if(compressedBytes > 0)
+    {
+        constexpr double MB = 1024.0 * 1024.0;
+        Log->info("Block compressed textures use {:.1f} MB instead of {:.1f} MB as RGBA8, {:.1f}x less",
+                  double(compressedBytes) / MB,
+                  double(uncompressedBytes) / MB,
+                  double(uncompressedBytes) / double(compressedBytes));
+    }
+}
+
+void Scene::createPendingTexture(PendingTexture& pending)
+{
+    if(!pending.image)
+    {
+        // decoding failed, the materials use the default textures
+        Log->warn("{}: {}", pending.file, pending.error);
+        return;
+    }
+
+    try
+    {
+        const uint32_t bytes = pending.image->m_size;
+        bgfx::TextureHandle texture = createTexture(pending.image, pending.mapped, pending.sRGB);
+        const uint64_t resident = streamer.residentBytes(texture);
+        textureCache.add(texture, resident > 0 ? resident : bytes);
+        textureCache.addKey(pending.key, texture);
+        for(const PendingTexture::User& user : pending.users)
+        {
+            materials[user.material].*user.texture = texture;
+            materials[user.material].*user.layer = 0;
+            textureCache.acquire(texture);
+        }
+    }
+    catch(const std::exception& e)
+    {
+        Log->warn("{}: {}", pending.file, e.what());
+    }
+    pending.image = nullptr;
+    pending.mapped = nullptr;
+}
+
+void Scene::buildTextureArrays()
 {
-    void* data = nullptr;
-    uint32_t size = 0;
+    const uint32_t maxLayers = std::min(bgfx::getCaps()->limits.maxTextureLayers, uint32_t(UINT16_MAX));
+
+    // textures must match in everything but their content
+    auto compatible = [](const PendingTexture& a, const PendingTexture& b) {
+        return a.sRGB == b.sRGB && a.image->m_format == b.image->m_format && a.image->m_width == b.image->m_width &&
+               a.image->m_height == b.image->m_height && a.image->m_numMips == b.image->m_numMips &&
+               a.image->m_numLayers == 1 && b.image->m_numLayers == 1 && !a.image->m_cubeMap && !b.image->m_cubeMap;
+    };
+
+    // a material samples all of its textures from arrays or none, and bgfx only creates an array texture for more
+    // than one layer, textures without a match stay 2D and so do all other textures of their materials
+    // that can leave groups with a single texture, repeat until nothing changes
+    std::vector<bool> plain(pendingTextures.size(), false);
+    std::vector<bool> plainMaterials(materials.size(), false);
+    std::vector<std::vector<size_t>> groups;
+    for(bool changed = true; changed;)
+    {
+        changed = false;
+        groups.clear();
+        std::vector<bool> grouped(pendingTextures.size(), false);
+        for(size_t i = 0; i < pendingTextures.size(); i++)
+        {
+            if(grouped[i] || plain[i] || !pendingTextures[i].image)
+                continue;
+
+            std::vector<size_t> group;
+            for(size_t j = i; j < pendingTextures.size() && group.size() < maxLayers; j++)
+            {
+                if(!grouped[j] && !plain[j] && pendingTextures[j].image &&
+                   (j == i || compatible(pendingTextures[i], pendingTextures[j])))
+                {
+                    group.push_back(j);
+                    grouped[j] = true;
+                }
+            }
+            if(group.size() > 1)
+                groups.push_back(std::move(group));
+            else
+                plain[i] = changed = true;
+        }
+
+        for(size_t i = 0; i < pendingTextures.size(); i++)
+        {
+            for(const PendingTexture::User& user : pendingTextures[i].users)
+            {
+                if(plain[i])
+                    plainMaterials[user.material] = true;
+            }
+        }
+        for(size_t i = 0; i < pendingTextures.size(); i++)
+        {
+            for(const PendingTexture::User& user : pendingTextures[i].users)
+            {
+                if(!plain[i] && plainMaterials[user.material])
+                    plain[i] = changed = true;
+            }
+        }
+    }
+
+    for(size_t m = 0; m < materials.size(); m++)
+    {
+        materials[m].textureArrays = !plainMaterials[m];
+    }
+
+    size_t plainTextures = 0;
+    for(size_t i = 0; i < pendingTextures.size(); i++)
+    {
+        if(plain[i] || !pendingTextures[i].image)
+        {
+            // logs failed decodes
+            createPendingTexture(pendingTextures[i]);
+            plainTextures += plain[i] ? 1 : 0;
+        }
+    }
 
-    bx::FileReader reader;
-    bx::Error err;
-    if(bx::open(&reader, file, &err))
+    size_t arrays = 0;
+    size_t packed = 0;
+    for(const std::vector<size_t>& group : groups)
     {
-        size = (uint32_t)bx::getSize(&reader);
-        data = BX_ALLOC(&allocator, size);
-        bx::read(&reader, data, size, &err);
-        bx::close(&reader);
+        const bimg::ImageContainer* first = pendingTextures[group[0]].image;
+        const bgfx::TextureFormat::Enum format = (bgfx::TextureFormat::Enum)first->m_format;
+        const uint64_t flags = textureFlags(pendingTextures[group[0]].sRGB);
+        const uint16_t layers = uint16_t(group.size());
+        if(!bgfx::isTextureValid(0, false, layers, format, flags))
+        {
+            // materials keep their invalid handles and use the default textures
+            Log->warn("Unsupported image format for texture arrays");
+            for(size_t index : group)
+            {
+                freeImage(pendingTextures[index].image, pendingTextures[index].mapped);
+            }
+            continue;
+        }
+
+        // layers one after the other, each with its whole mip chain like the single images
+        const uint16_t width = (uint16_t)first->m_width;
+        const uint16_t height = (uint16_t)first->m_height;
+        const bool hasMips = first->m_numMips > 1;
+        const uint32_t layerSize = first->m_size;
+        const bgfx::Memory* mem = bgfx::alloc(layerSize * layers);
+        for(uint16_t layer = 0; layer < layers; layer++)
+        {
+            PendingTexture& pending = pendingTextures[group[layer]];
+            copyImageData(*pending.image, pending.mapped, mem->data + layer * layerSize);
+            freeImage(pending.image, pending.mapped);
+        }
+
+        bgfx::TextureHandle array = bgfx::createTexture2D(width, height, hasMips, layers, format, flags, mem);
+        cacheTexture(array, width, height, hasMips, layers, format, flags, mem->data, mem->size);
+        textureCache.add(array, mem->size, layers);
+        arrays++;
+        packed += layers;
+
+        for(uint16_t layer = 0; layer < layers; layer++)
+        {
+            textureCache.addKey(pendingTextures[group[layer]].key, array, layer);
+            for(const PendingTexture::User& user : pendingTextures[group[layer]].users)
+            {
+                materials[user.material].*user.texture = array;
+                materials[user.material].*user.layer = layer;
+                textureCache.acquire(array);
+            }
+        }
     }
 
-    if(!err.isOk())
+    Log->info("Packed {} material textures into {} texture arrays, {} stay 2D textures",
+              packed,
+              arrays,
+              plainTextures);
+}
+
+void Scene::logTextureSharing() const
+{
+    const TextureCache::Stats stats = textureCache.stats();
+    if(stats.textures == 0)
+        return;
+    constexpr double MB = 1024.0 * 1024.0;
+    Log->info("{} material slots share {} textures using {:.1f} MB, {:.1f} MB less than a texture per slot",
+              stats.references,
+              stats.textures,
+              double(stats.bytes) / MB,
+              double(stats.unsharedBytes - std::min(stats.unsharedBytes, stats.bytes)) / MB);
+}
+
+uint64_t Scene::textureFlags(bool sRGB)
+{
+    // default wrap mode is repeat, there's no flag for it
+    uint64_t flags = BGFX_TEXTURE_NONE | BGFX_SAMPLER_MIN_ANISOTROPIC | BGFX_SAMPLER_MAG_ANISOTROPIC;
+    if(sRGB)
+        flags |= BGFX_TEXTURE_SRGB;
+    return flags;
+}
+
+bgfx::TextureHandle Scene::createTexture(bimg::ImageContainer* image, MappedFile* mapped, bool sRGB)
+{
+    const uint64_t flags = textureFlags(sRGB);
+    if(!bgfx::isTextureValid(0, false, image->m_numLayers, (bgfx::TextureFormat::Enum)image->m_format, flags))
     {
-        BX_FREE(&allocator, data);
-        throw std::runtime_error(err.getMessage().getPtr());
+        freeImage(image, mapped);
+        throw std::runtime_error("Unsupported image format");
     }
 
-    bimg::ImageContainer* image = bimg::imageParse(&allocator, data, size);
-    if(image)
+    const uint16_t width = (uint16_t)image->m_width;
+    const uint16_t height = (uint16_t)image->m_height;
+    const bool hasMips = image->m_numMips > 1;
+    const bgfx::TextureFormat::Enum format = (bgfx::TextureFormat::Enum)image->m_format;
+
+    TextureStreamer::Desc desc;
+    desc.width = width;
+    desc.height = height;
+    desc.numMips = image->m_numMips;
+    desc.format = format;
+    desc.flags = flags;
+
+    bgfx::TextureHandle tex;
+    if(texturesStreamed && !(mapped && image->m_ktx) &&
+       TextureStreamer::streamable(desc, image->m_numLayers, image->m_size))
+    {
+        // the streamer keeps the whole mip chain and only uploads a small level for now
+        TextureStreamer::Source* source =
+            mapped ? TextureStreamer::Source::fromMapping(mapped, (const uint8_t*)image->m_data, image->m_size)
+                   : TextureStreamer::Source::fromImage(image);
+        tex = streamer.add(source, desc);
+    }
+    else if(!mapped)
     {
         // the callback gets called when bgfx is done using the data (after 2 frames)
         const bgfx::Memory* mem = bgfx::makeRef(
@@ -403,29 +1979,192 @@ bgfx::TextureHandle Scene::loadTexture(const char* file, bool sRGB)
             image->m_size,
             [](void*, void* data) { bimg::imageFree((bimg::ImageContainer*)data); },
             image);
-        BX_FREE(&allocator, data);
+        tex = bgfx::createTexture2D(width, height, hasMips, image->m_numLayers, format, flags, mem);
+    }
+    else if(image->m_ktx)
+    {
+        // bgfx parses KTX files itself, the whole file goes in
+        tex = bgfx::createTexture(mapped->makeRef(mapped->data(), uint32_t(mapped->size())), flags);
+    }
+    else
+    {
+        tex = bgfx::createTexture2D(width,
+                                    height,
+                                    hasMips,
+                                    image->m_numLayers,
+                                    format,
+                                    flags,
+                                    mapped->makeRef(image->m_data, image->m_size));
+    }
+    //bgfx::setName(tex, file); // causes debug errors with DirectX SetPrivateProperty duplicate
+
+    // bgfx or the streamer only release the image later
+    // KTX files have mip sizes in between the image data, the cache wants the layout of createTexture2D
+    const void* data = image->m_data;
+    std::vector<uint8_t> packed;
+    if(cacheWriter && mapped && image->m_ktx)
+    {
+        packed.resize(image->m_size);
+        copyImageData(*image, mapped, packed.data());
+        data = packed.data();
+    }
+    cacheTexture(tex, width, height, hasMips, image->m_numLayers, format, flags, data, image->m_size);
+
+    // bgfx holds its own reference to the mapping, the header isn't needed anymore
+    if(mapped)
+        freeImage(image, mapped);
+    return tex;
+}
 
-        // default wrap mode is repeat, there's no flag for it
-        uint64_t textureFlags = BGFX_TEXTURE_NONE | BGFX_SAMPLER_MIN_ANISOTROPIC | BGFX_SAMPLER_MAG_ANISOTROPIC;
-        if(sRGB)
-            textureFlags |= BGFX_TEXTURE_SRGB;
+void Scene::cacheTexture(bgfx::TextureHandle handle,
+                         uint16_t width,
+                         uint16_t height,
+                         bool hasMips,
+                         uint16_t numLayers,
+                         bgfx::TextureFormat::Enum format,
+                         uint64_t flags,
+                         const void* data,
+                         uint32_t size)
+{
+    if(!cacheWriter)
+        return;
+
+    CacheTexture texture;
+    texture.width = width;
+    texture.height = height;
+    texture.numLayers = numLayers;
+    texture.hasMips = hasMips ? 1 : 0;
+    texture.format = uint32_t(format);
+    texture.blob = cacheWriter->add(data, size);
+    texture.flags = flags;
+    cacheTextures[handle.idx] = texture;
+}
 
-        if(bgfx::isTextureValid(0, false, image->m_numLayers, (bgfx::TextureFormat::Enum)image->m_format, textureFlags))
+bimg::ImageContainer* Scene::loadImage(const char* file, MappedFile*& mapped)
+{
+    mapped = nullptr;
+    MappedFile* source = MappedFile::open(file);
+    if(!source)
+        throw std::runtime_error("Can't open file or file is empty");
+    if(source->size() > UINT32_MAX)
+    {
+        source->release();
+        throw std::runtime_error("Image file is too large");
+    }
+    const uint32_t size = uint32_t(source->size());
+
+    // DDS and KTX files are already in a GPU format, only parse their header
+    // 2D only, createTexture2D and texture arrays can't take cube maps or volumes
+    bimg::ImageContainer header;
+    const bool dds = size >= 4 && std::memcmp(source->data(), "DDS ", 4) == 0;
+    if(bimg::imageParse(header, source->data(), size) && (dds || header.m_ktx) && !header.m_cubeMap &&
+       header.m_depth == 1)
+    {
+        const bool complete = header.m_ktx ? ktxComplete(header, source->data(), size)
+                                           : header.m_offset <= size && header.m_size <= size - header.m_offset;
+        if(!complete)
         {
-            bgfx::TextureHandle tex = bgfx::createTexture2D((uint16_t)image->m_width,
-                                                            (uint16_t)image->m_height,
-                                                            image->m_numMips > 1,
-                                                            image->m_numLayers,
-                                                            (bgfx::TextureFormat::Enum)image->m_format,
-                                                            textureFlags,
-                                                            mem);
-            //bgfx::setName(tex, file); // causes debug errors with DirectX SetPrivateProperty duplicate
-            return tex;
+            source->release();
+            throw std::runtime_error("Image file is truncated");
+        }
+
+        // header-only container, bimg::imageFree just frees the allocation
+        bimg::ImageContainer* image = (bimg::ImageContainer*)BX_ALLOC(&allocator, sizeof(bimg::ImageContainer));
+        *image = header;
+        image->m_allocator = &allocator;
+        // DDS stores layers and mips in the order createTexture2D expects, KTX has to go through copyImageData
+        image->m_data = header.m_ktx ? nullptr : (void*)(source->data() + header.m_offset);
+        mapped = source;
+        return image;
+    }
+
+    // everything else gets decoded straight from the mapped pages
+    bimg::ImageContainer* image = bimg::imageParse(&allocator, source->data(), size);
+    source->release();
+    if(!image)
+        throw std::runtime_error("Unsupported image file");
+    return image;
+}
+
+bimg::ImageContainer* Scene::loadEmbeddedImage(const aiTexture* texture)
+{
+    // compressed file data with its size in mWidth
+    if(texture->mHeight == 0)
+    {
+        bimg::ImageContainer* image = bimg::imageParse(&allocator, texture->pcData, texture->mWidth);
+        if(!image)
+            throw std::runtime_error("Unsupported embedded image");
+        return image;
+    }
+
+    // uncompressed BGRA texels
+    bimg::ImageContainer* image = bimg::imageAlloc(&allocator,
+                                                   bimg::TextureFormat::RGBA8,
+                                                   uint16_t(texture->mWidth),
+                                                   uint16_t(texture->mHeight),
+                                                   1,
+                                                   1,
+                                                   false,
+                                                   false);
+    uint8_t* out = (uint8_t*)image->m_data;
+    const size_t texels = size_t(texture->mWidth) * texture->mHeight;
+    for(size_t i = 0; i < texels; i++)
+    {
+        const aiTexel& texel = texture->pcData[i];
+        out[i * 4 + 0] = texel.r;
+        out[i * 4 + 1] = texel.g;
+        out[i * 4 + 2] = texel.b;
+        out[i * 4 + 3] = texel.a;
+    }
+    return image;
+}
+
+bimg::ImageContainer* Scene::loadCompressedImage(const PendingTexture& pending, MappedFile*& mapped) const
+{
+    const char* file = pending.file.c_str();
+    const TextureCompressor::Role role = pending.role;
+    // the copy of an embedded texture is next to the scene file
+    const std::string cacheFile = compressor->cachePath(file, role);
+    const char* source = pending.embedded ? loadState->file.c_str() : file;
+    if(TextureCompressor::upToDate(cacheFile.c_str(), source))
+    {
+        try
+        {
+            bimg::ImageContainer* image = loadImage(cacheFile.c_str(), mapped);
+            // written before mips were generated
+            if(image->m_numMips > 1 || (image->m_width == 1 && image->m_height == 1))
+                return image;
+            freeImage(image, mapped);
+        }
+        catch(const std::exception& e)
+        {
+            Log->warn("{}: {}", cacheFile, e.what());
         }
-        else
-            throw std::runtime_error("Unsupported image format");
     }
 
-    BX_FREE(&allocator, data);
-    throw std::runtime_error(err.getMessage().getPtr());
+    bimg::ImageContainer* image = pending.embedded ? loadEmbeddedImage(pending.embedded) : loadImage(file, mapped);
+    // DDS and KTX files are uploaded in the format they come in
+    if(mapped)
+        return image;
+
+    image = MipGenerator::generate(
+        &allocator, image, role == TextureCompressor::Role::Color, role == TextureCompressor::Role::Normal);
+    image = compressor->compress(image, role);
+    if(!TextureCompressor::write(cacheFile.c_str(), *image))
+        Log->warn("Can't write compressed texture {}", cacheFile);
+    return image;
+}
+
+void Scene::freeImage(bimg::ImageContainer*& image, MappedFile*& mapped)
+{
+    bimg::imageFree(image);
+    image = nullptr;
+    if(mapped)
+        mapped->release();
+    mapped = nullptr;
+}
+
+const bgfx::VertexLayout& Scene::vertexLayout() const
+{
+    return verticesQuantized ? Mesh::QuantizedVertex::layout : Mesh::PosNormalTangentTex0Vertex::layout;
 }
@@ -2,30 +2,129 @@
 
 #include "Scene/Camera.h"
 #include "Scene/Mesh.h"
+#include "Scene/Bounds.h"
 #include "Scene/Material.h"
 #include "Scene/Light.h"
 #include "Scene/LightList.h"
+#include "Scene/SceneCache.h"
+#include "Scene/TextureCache.h"
+#include "Scene/TextureCompressor.h"
+#include "Scene/TextureStreamer.h"
 #include "Log/AssimpSource.h"
 #include <glm/matrix.hpp>
 #include <bgfx/bgfx.h>
 #include <bx/allocator.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <string>
 
+struct aiScene;
+struct aiNode;
 struct aiMesh;
 struct aiMaterial;
 struct aiCamera;
+struct aiString;
+struct aiTexture;
+class ThreadPool;
+class MappedFile;
+
+namespace bimg
+{
+struct ImageContainer;
+}
 
 class Scene
 {
 public:
     Scene();
+    ~Scene();
 
     static void init();
 
     // load meshes, materials, camera from .gltf file
     bool load(const char* file);
+    // same as load, but the import, mesh conversion and texture decoding run on a background thread
+    // the scene is loaded once materials exist, meshes and textures appear as update creates them
+    // a valid scene cache is still loaded right away
+    // a running load is cancelled, failed loads leave the scene empty
+    void loadAsync(const char* file);
+    // create GPU resources for everything the background thread finished since the last call
+    // call once per frame on the thread that calls bgfx::frame while loading() is true
+    void update();
     void clear();
 
+    // asynchronous load in progress
+    bool loading() const
+    {
+        return loadState != nullptr;
+    }
+    // meshes are still being added by update()
+    bool loadingGeometry() const
+    {
+        return loadState && !loadState->geometryDone;
+    }
+    // description of the current loading step and its progress in [0, 1]
+    const char* loadProgress(float& progress) const;
+
+    // recreate streamed textures at the levels the renderer needs, call once per frame after rendering
+    // materialDemand holds screen pixels per unit of texture coordinates for each material, 0 if it's not visible
+    // budget is the GPU memory in bytes all streamed textures may use
+    // does nothing while loading
+    void updateStreaming(const std::vector<float>& materialDemand, uint64_t budget);
+    TextureStreamer::Stats streamingStats() const
+    {
+        return streamer.stats();
+    }
+
+    // pack all meshes into one vertex buffer and one 32-bit index buffer
+    // set before load, ignored if 32-bit indices aren't supported
+    bool mergeBuffers = true;
+    // compress vertices to Mesh::QuantizedVertex
+    // set before load, ignored if half float vertex attributes aren't supported
+    bool quantizeVertices = true;
+    // keep meshes used by several nodes once and draw them instanced with their node transformations
+    // set before load, ignored if instancing isn't supported
+    bool instanceMeshes = false;
+    // simplify every chunk into a chain of MeshChunk::Lod
+    // set before load
+    bool generateLods = true;
+    // pack material textures with the same size, format and mip count into texture arrays
+    // materials then share texture bindings and only differ in their table entry
+    // materials with a texture that has no match keep plain 2D textures (Material::textureArrays)
+    // set before load, ignored if 2D texture arrays aren't supported
+    bool textureArrays = false;
+    // block compress material textures according to their role (TextureCompressor)
+    // compressed copies are kept next to the source images for later imports
+    // set before load, ignored if BC1, BC3 and BC5 aren't supported
+    bool compressTextures = true;
+    // BC7 instead of BC1/BC3 for color and data textures, much slower to encode
+    // set before load, ignored if BC7 isn't supported
+    bool highQualityCompression = false;
+    // create single-layer material textures at a small mip and let updateStreaming load finer levels on demand
+    // set before load, ignored with texture arrays
+    bool streamTextures = true;
+    // read .gltf and .glb files with GltfLoader instead of assimp, files it doesn't support still go through assimp
+    // set before load
+    bool nativeGltf = true;
+    // load from a binary cache next to the scene file (SceneCache) if it's up to date,
+    // otherwise import the scene and write the cache
+    // set before load
+    bool useCache = true;
+    // convert meshes and decode textures in parallel, nullptr does everything on the importing thread
+    // set before load
+    ThreadPool* threads = nullptr;
+
     bool loaded = false;
+    // skipped the import, everything came from the scene cache
+    bool loadedFromCache = false;
+    // incremented whenever meshes or chunks are added or removed
+    // renderers rebuild their draw data when this changes
+    uint32_t geometryRevision = 0;
+    // incremented whenever materials or their textures change
+    uint32_t materialRevision = 0;
     glm::vec3 minBounds;
     glm::vec3 maxBounds;
     glm::vec3 center;
@@ -33,6 +132,22 @@ public:
     Camera camera;
     std::vector<Mesh> meshes;
     std::vector<Material> materials;
+    std::vector<MeshChunk> chunks;
+    // chunk bounds for culling, same order as chunks
+    BoundsSoA chunkBounds;
+
+    // shared by all meshes if the buffers are merged, invalid otherwise
+    bool buffersMerged = false;
+    bool verticesQuantized = false;
+    bool meshesInstanced = false;
+    // material textures are texture arrays if Material::textureArrays is set, shaders need MATERIAL_TEXTURE_ARRAYS
+    bool texturesInArrays = false;
+    // material textures were block compressed during the import
+    bool texturesCompressed = false;
+    // material textures with a full mip chain are streamed (TextureStreamer)
+    bool texturesStreamed = false;
+    bgfx::VertexBufferHandle vertexBuffer = BGFX_INVALID_HANDLE;
+    bgfx::IndexBufferHandle indexBuffer = BGFX_INVALID_HANDLE;
 
     // these are not populated by load
     glm::vec3 skyColor;
@@ -43,9 +158,228 @@ private:
     static bx::DefaultAllocator allocator;
     AssimpLogSource logSource;
 
-    Mesh loadMesh(const aiMesh* mesh); // not static because it changes minBounds and maxBounds
-    static Material loadMaterial(const aiMaterial* material, const char* dir);
-    static Camera loadCamera(const aiCamera* camera);
+    // time per update spent creating GPU resources while loading asynchronously, in ms
+    static constexpr float UPDATE_BUDGET = 4.0f;
+
+    // triangles per chunk are between MAX_CHUNK_TRIANGLES / 2 and MAX_CHUNK_TRIANGLES
+    // unless the whole mesh is smaller
+    static constexpr uint32_t MAX_CHUNK_TRIANGLES = 2048;
+    // stop the LOD chain once a level removes less than this fraction of the previous level's triangles
+    static constexpr float MIN_LOD_REDUCTION = 0.2f;
+
+    // encoded vertices and indices of all meshes while loading with merged buffers
+    std::vector<uint8_t> mergedVertexData;
+    std::vector<uint32_t> mergedIndices;
+    // quantized positions in merged buffers are relative to this
+    AABB quantizationBounds;
+
+    // mesh converted on a worker thread, added to the scene in order once all are done
+    struct ConvertedMesh
+    {
+        Mesh mesh;
+        // encoded in the scene's vertex format
+        std::vector<uint8_t> vertexData;
+        // chunk index ranges are relative to the mesh, chunk.mesh gets set when adding
+        std::vector<MeshChunk> chunks;
+        // world space, includes all instances
+        AABB bounds;
+        // empty if the conversion succeeded
+        std::string error;
+    };
+
+    // progress of a load, shared by the importing thread and update
+    // the importing thread is the calling thread for load and loadThread for loadAsync
+    struct LoadState
+    {
+        std::string file;
+        unsigned int importFlags = 0;
+        // GltfLoader read the file, set by the importing thread before materialsReady
+        bool nativeGltf = false;
+        bool async = false;
+        int64_t start = 0;
+        std::atomic<bool> cancel = { false };
+
+        std::mutex mutex;
+        // protected by mutex
+        // materials are loaded, meshes and textures can be added
+        bool materialsReady = false;
+        // converted holds a result
+        std::vector<uint8_t> meshReady;
+        uint32_t meshesConverted = 0;
+        // indices into pendingTextures waiting to be created
+        std::vector<uint32_t> decoded;
+        bool imported = false;
+        bool failed = false;
+
+        // written by the importing thread before materialsReady, by index afterwards
+        std::vector<ConvertedMesh> converted;
+        bool hasCamera = false;
+        Camera camera;
+
+        // only touched by update
+        uint32_t nextMesh = 0;
+        uint32_t texturesCreated = 0;
+        bool geometryDone = false;
+
+        // for loadProgress, read without locking
+        enum Step : uint32_t
+        {
+            Importing,
+            Converting,
+            Decoding,
+            Uploading
+        };
+        std::atomic<uint32_t> step = { Importing };
+        std::atomic<uint32_t> completed = { 0 };
+        std::atomic<uint32_t> total = { 0 };
+    };
+    std::unique_ptr<LoadState> loadState;
+    std::thread loadThread;
+
+    // material textures gathered while loading materials, decoded and created afterwards
+    struct PendingTexture
+    {
+        // embedded textures get a virtual path of scene file#index
+        std::string file;
+        // TextureCache::key of the file and role
+        std::string key;
+        // image inside the scene file, owned by the imported scene
+        const aiTexture* embedded = nullptr;
+        TextureCompressor::Role role = TextureCompressor::Role::Color;
+        bool sRGB = false;
+        // set by the decoding threads
+        bimg::ImageContainer* image = nullptr;
+        // DDS and KTX files aren't decoded, image only holds their header and the data stays in the mapping
+        MappedFile* mapped = nullptr;
+        std::string error;
+
+        // material members to fill in once the array exists
+        struct User
+        {
+            uint32_t material;
+            bgfx::TextureHandle Material::*texture;
+            uint16_t Material::*layer;
+        };
+        std::vector<User> users;
+    };
+    std::vector<PendingTexture> pendingTextures;
+    // role + file path -> index into pendingTextures
+    // files used by several materials are only decoded once and share a texture or layer
+    std::unordered_map<std::string, uint32_t> pendingTextureFiles;
+    // nullptr if textures keep the format of their source image
+    std::unique_ptr<TextureCompressor> compressor;
+    // owns all material textures, clear releases the references of every material slot
+    TextureCache textureCache;
+    // resident levels of streamed textures, their handles are owned by textureCache
+    TextureStreamer streamer;
+    std::vector<TextureStreamer::Swap> streamSwaps;
+
+    // records the GPU data of an import for the scene cache, nullptr if there's no cache to write
+    std::unique_ptr<SceneCache::Writer> cacheWriter;
+    // blobs of the vertex and index data
+    // merged buffers use the first entry, otherwise there's one per mesh
+    struct CacheBuffers
+    {
+        uint32_t vertices = SceneCache::NO_BLOB;
+        uint32_t indices = SceneCache::NO_BLOB;
+    };
+    std::vector<CacheBuffers> cacheBuffers;
+    // creation parameters and data blob of a texture
+    struct CacheTexture
+    {
+        uint16_t width;
+        uint16_t height;
+        uint16_t numLayers;
+        uint16_t hasMips;
+        uint32_t format;
+        uint32_t blob;
+        uint64_t flags;
+    };
+    // by texture handle
+    std::unordered_map<uint16_t, CacheTexture> cacheTextures;
+
+    const bgfx::VertexLayout& vertexLayout() const;
+
+    // clears the scene and loads the cache or sets up loadState
+    // returns true if the import has to run
+    bool beginLoad(const char* file, bool async);
+    // import with GltfLoader or assimp, convert meshes and decode textures
+    // runs on the importing thread, everything else is done by update
+    void import();
+    // all meshes are added, create the merged buffers and set the scene bounds
+    void finishGeometry();
+    // build texture arrays, write the cache and end the load
+    void finishLoad();
+    // wait for the importing thread and free all loading state, cancels a running import
+    void endLoad();
+
+    // create everything from the cache file, false if it's missing, outdated or invalid
+    bool loadCache(const char* file, const SceneCache::Key& key);
+    // serialize the scene with the blobs recorded during the import
+    void writeCache();
+    // GPU data of textures created during the import
+    void cacheTexture(bgfx::TextureHandle handle,
+                      uint16_t width,
+                      uint16_t height,
+                      bool hasMips,
+                      uint16_t numLayers,
+                      bgfx::TextureFormat::Enum format,
+                      uint64_t flags,
+                      const void* data,
+                      uint32_t size);
+
+    // world transformations of all nodes using each mesh
+    // meshes with a single node get it applied to their vertices and an empty list
+    static std::vector<std::vector<glm::mat4>> bakeInstances(aiScene* scene);
+    static glm::mat4 nodeTransform(const aiNode* node);
+
+    // convert to the scene's vertex format and build chunks, thread-safe
+    // instanced meshes are not split into chunks
+    ConvertedMesh convertMesh(const aiMesh* mesh, const std::vector<glm::mat4>& instances) const;
+    // changes minBounds and maxBounds, adds to meshes, chunks and the merged buffers
+    // unmerged meshes get their buffers created
+    void addMesh(ConvertedMesh& converted);
+    // reorder triangles into spatially coherent chunks, writes the new indices
+    static std::vector<MeshChunk> buildChunks(const aiMesh* mesh, uint32_t* indices);
+    // simplify a chunk's triangles, appends the LOD indices
+    static void buildLods(MeshChunk& chunk, const std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices);
+    // not static because textures are only collected, index is the material's index
+    Material loadMaterial(const aiMaterial* material, const aiScene* scene, const char* dir, uint32_t index);
+    // queue a texture for loadTextures, the material members get filled in once it's created
+    // file is relative to dir or names a texture embedded in the scene
+    void loadMaterialTexture(const aiScene* scene,
+                             const char* dir,
+                             const aiString& file,
+                             TextureCompressor::Role role,
+                             uint32_t index,
+                             Material& material,
+                             bgfx::TextureHandle Material::*texture,
+                             uint16_t Material::*layer);
+    // decode all pending textures in parallel, runs on the importing thread
+    // update creates single textures as soon as they're decoded, texture arrays once all of them are done
+    void loadTextures();
+    // create the texture for a decoded pending texture and patch the materials
+    void createPendingTexture(PendingTexture& pending);
+    // create the texture arrays for all pending textures and patch the materials
+    void buildTextureArrays();
+    // memory saved by textures shared between material slots
+    void logTextureSharing() const;
+    // transform is the camera node's world transformation
+    static Camera loadCamera(const aiCamera* camera, const glm::mat4& transform);
 
-    static bgfx::TextureHandle loadTexture(const char* file, bool sRGB = false);
+    // takes ownership of the image and the mapping reference
+    // not static because the texture data gets added to the scene cache and streamed textures to the streamer
+    bgfx::TextureHandle createTexture(bimg::ImageContainer* image, MappedFile* mapped, bool sRGB);
+    // thread-safe
+    // mapped is set for files bgfx can upload straight from the mapped pages
+    static bimg::ImageContainer* loadImage(const char* file, MappedFile*& mapped);
+    // thread-safe
+    static bimg::ImageContainer* loadEmbeddedImage(const aiTexture* texture);
+    // thread-safe
+    // loads the compressed copy if it's up to date, otherwise compresses the image and writes the copy
+    // embedded textures are compared against the scene file
+    bimg::ImageContainer* loadCompressedImage(const PendingTexture& pending, MappedFile*& mapped) const;
+    // frees the image and releases the mapping
+    static void freeImage(bimg::ImageContainer*& image, MappedFile*& mapped);
+    static uint64_t textureFlags(bool sRGB);
 };
@@ -0,0 +1,247 @@
+#include "SceneCache.h"
+
+#include "Log/Log.h"
+#include "Util/MappedFile.h"
+#include <bx/bx.h>
+#include <algorithm>
+#include <cstdio>
+#include <sys/stat.h>
+
+constexpr uint32_t SceneCache::NO_BLOB;
+constexpr uint32_t SceneCache::VERSION;
+constexpr uint32_t SceneCache::MAGIC;
+constexpr uint64_t SceneCache::BLOB_ALIGNMENT;
+
+std::string SceneCache::path(const char* sceneFile)
+{
+    return std::string(sceneFile) + ".cache";
+}
+
+bool SceneCache::open(const char* file, const Key& key)
+{
+    close();
+
+    mapped = MappedFile::open(file);
+    if(!mapped)
+        return false;
+
+    Header header;
+    bool valid = mapped->size() >= sizeof(Header);
+    if(valid)
+    {
+        std::memcpy(&header, mapped->data(), sizeof(Header));
+        valid = header.magic == MAGIC && header.version == VERSION && header.key.importFlags == key.importFlags &&
+                header.key.options == key.options && header.blobTable % sizeof(uint64_t) == 0 &&
+                header.blobTable <= mapped->size() &&
+                uint64_t(header.numBlobs) * 2 * sizeof(uint64_t) <= mapped->size() - header.blobTable;
+    }
+    if(!valid)
+    {
+        Log->info("Scene cache {} was written by a different version or with different settings", file);
+        close();
+        return false;
+    }
+
+    blobTable = (const uint64_t*)(mapped->data() + header.blobTable);
+    numBlobs = header.numBlobs;
+    rootBlob = header.root;
+
+    try
+    {
+        size_t size;
+        const uint8_t* data = blob(header.dependencies, size);
+        InStream in(data, size);
+        uint64_t count = in.read<uint64_t>();
+        for(uint64_t i = 0; i < count; i++)
+        {
+            std::string dependency = in.readString();
+            uint64_t cachedSize = in.read<uint64_t>();
+            int64_t cachedTime = in.read<int64_t>();
+            uint64_t fileSize;
+            int64_t fileTime;
+            if(!stamp(dependency.c_str(), fileSize, fileTime) || fileSize != cachedSize || fileTime != cachedTime)
+            {
+                Log->info("Scene cache {} is outdated, {} changed", file, dependency);
+                close();
+                return false;
+            }
+        }
+    }
+    catch(const std::exception& e)
+    {
+        Log->warn("Scene cache {}: {}", file, e.what());
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void SceneCache::close()
+{
+    if(mapped)
+        mapped->release();
+    mapped = nullptr;
+    blobTable = nullptr;
+    numBlobs = 0;
+    rootBlob = NO_BLOB;
+}
+
+const uint8_t* SceneCache::blob(uint32_t index, size_t& size) const
+{
+    if(index >= numBlobs)
+        throw std::runtime_error("Invalid scene cache blob");
+
+    uint64_t offset = blobTable[index * 2 + 0];
+    uint64_t blobSize = blobTable[index * 2 + 1];
+    if(offset > mapped->size() || blobSize > mapped->size() - offset)
+        throw std::runtime_error("Scene cache is truncated");
+
+    size = size_t(blobSize);
+    return mapped->data() + offset;
+}
+
+bool SceneCache::stamp(const char* file, uint64_t& size, int64_t& time)
+{
+#if BX_PLATFORM_WINDOWS
+    struct _stat64 info;
+    if(_stat64(file, &info) != 0)
+        return false;
+#else
+    struct stat info;
+    if(stat(file, &info) != 0)
+        return false;
+#endif
+    size = uint64_t(info.st_size);
+    time = int64_t(info.st_mtime);
+    return true;
+}
+
+bool SceneCache::Writer::open(const char* file, const Key& key)
+{
+    this->file = file;
+    tempFile = this->file + ".tmp";
+    this->key = key;
+    offset = 0;
+    blobs.clear();
+    dependencies.clear();
+
+    bx::Error err;
+    opened = writer.open(tempFile.c_str(), false, &err);
+    failed = !opened;
+    if(!opened)
+    {
+        Log->warn("Can't write scene cache {}", tempFile);
+        return false;
+    }
+
+    // filled in by commit
+    Header header = {};
+    return write(&header, sizeof(header));
+}
+
+void SceneCache::Writer::addDependency(const char* file)
+{
+    if(std::find(dependencies.begin(), dependencies.end(), file) == dependencies.end())
+        dependencies.push_back(file);
+}
+
+uint32_t SceneCache::Writer::add(const void* data, size_t size)
+{
+    static const uint8_t zeros[BLOB_ALIGNMENT] = {};
+    write(zeros, size_t((BLOB_ALIGNMENT - offset % BLOB_ALIGNMENT) % BLOB_ALIGNMENT));
+
+    blobs.push_back(offset);
+    blobs.push_back(size);
+    write(data, size);
+    return uint32_t(blobs.size() / 2 - 1);
+}
+
+bool SceneCache::Writer::commit(uint32_t root)
+{
+    if(!opened || failed)
+    {
+        abort();
+        return false;
+    }
+
+    OutStream out;
+    out.write(uint64_t(dependencies.size()));
+    for(const std::string& dependency : dependencies)
+    {
+        uint64_t size = 0;
+        int64_t time = 0;
+        stamp(dependency.c_str(), size, time);
+        out.write(dependency);
+        out.write(size);
+        out.write(time);
+    }
+    uint32_t dependencyBlob = add(out.data().data(), out.data().size());
+
+    // blob table is read as uint64_t
+    static const uint8_t zeros[sizeof(uint64_t)] = {};
+    write(zeros, size_t((sizeof(uint64_t) - offset % sizeof(uint64_t)) % sizeof(uint64_t)));
+
+    Header header = {};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.key = key;
+    header.numBlobs = uint32_t(blobs.size() / 2);
+    header.root = root;
+    header.dependencies = dependencyBlob;
+    header.blobTable = offset;
+    write(blobs.data(), blobs.size() * sizeof(uint64_t));
+    const uint64_t size = offset;
+
+    bx::seek(&writer, 0, bx::Whence::Begin);
+    write(&header, sizeof(header));
+    if(failed)
+    {
+        Log->warn("Can't write scene cache {}", tempFile);
+        abort();
+        return false;
+    }
+    writer.close();
+    opened = false;
+
+    // rename replaces the file atomically on POSIX, Windows doesn't overwrite existing files
+#if BX_PLATFORM_WINDOWS
+    std::remove(file.c_str());
+#endif
+    if(std::rename(tempFile.c_str(), file.c_str()) != 0)
+    {
+        Log->warn("Can't write scene cache {}", file);
+        std::remove(tempFile.c_str());
+        return false;
+    }
+
+    Log->info("Wrote scene cache {} ({} MB)", file, size / (1024 * 1024));
+    return true;
+}
+
+void SceneCache::Writer::abort()
+{
+    if(opened)
+    {
+        writer.close();
+        std::remove(tempFile.c_str());
+    }
+    opened = false;
+}
+
+bool SceneCache::Writer::write(const void* data, size_t size)
+{
+    // bx writers take 32-bit sizes
+    constexpr size_t MAX_WRITE = 1 << 30;
+    const uint8_t* bytes = (const uint8_t*)data;
+    while(!failed && size > 0)
+    {
+        int32_t chunk = int32_t(std::min(size, MAX_WRITE));
+        bx::Error err;
+        failed = bx::write(&writer, bytes, chunk, &err) != chunk || !err.isOk();
+        bytes += chunk;
+        size -= size_t(chunk);
+        offset += uint64_t(chunk);
+    }
+    return !failed;
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <bx/file.h>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+class MappedFile;
+
+// binary snapshot of an imported scene, later loads skip assimp, mesh processing and texture decoding
+// the file is a header, a sequence of blobs and a blob table at the end
+// blobs hold vertex, index and texture data in their upload format, bgfx gets them straight from a
+// memory mapping of the file without copying
+// the root blob describes the scene, it's written and read by Scene
+// a cache is only used if the key matches and none of its source files changed (size and modification time)
+class SceneCache
+{
+public:
+    // import settings the cached data depends on
+    struct Key
+    {
+        uint32_t importFlags = 0; // assimp post-processing steps
+        uint32_t options = 0;     // Scene options after checking the caps
+    };
+
+    static constexpr uint32_t NO_BLOB = UINT32_MAX;
+
+    // cache file of a scene file
+    static std::string path(const char* sceneFile);
+    // size and modification time, false if the file doesn't exist
+    static bool stamp(const char* file, uint64_t& size, int64_t& time);
+
+    // maps the file if it was written with the same key and its source files are unchanged
+    bool open(const char* file, const Key& key);
+    void close();
+
+    // bgfx references into the mapping keep it alive after close
+    MappedFile* mapping() const
+    {
+        return mapped;
+    }
+
+    uint32_t root() const
+    {
+        return rootBlob;
+    }
+
+    // throws std::runtime_error for invalid indices
+    const uint8_t* blob(uint32_t index, size_t& size) const;
+
+    // streams blobs to a temporary file that replaces the cache file once the import succeeded
+    class Writer
+    {
+    public:
+        bool open(const char* file, const Key& key);
+        // files the imported data was created from, the scene file and its textures
+        void addDependency(const char* file);
+        // returns the blob index
+        uint32_t add(const void* data, size_t size);
+        // writes the dependencies and blob table, then replaces the old cache file
+        bool commit(uint32_t root);
+        // deletes the temporary file
+        void abort();
+
+    private:
+        bool write(const void* data, size_t size);
+
+        std::string file;
+        std::string tempFile;
+        bx::FileWriter writer;
+        bool opened = false;
+        bool failed = false;
+        Key key;
+        uint64_t offset = 0;
+        std::vector<uint64_t> blobs; // offset and size
+        std::vector<std::string> dependencies;
+    };
+
+    // append-only buffer for serializing the root blob
+    class OutStream
+    {
+    public:
+        template<typename T> void write(const T& value)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "Type can't be serialized");
+            append(&value, sizeof(T));
+        }
+
+        template<typename T> void write(const std::vector<T>& values)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "Type can't be serialized");
+            write(uint64_t(values.size()));
+            append(values.data(), values.size() * sizeof(T));
+        }
+
+        void write(const std::string& value)
+        {
+            write(uint64_t(value.size()));
+            append(value.data(), value.size());
+        }
+
+        const std::vector<uint8_t>& data() const
+        {
+            return bytes;
+        }
+
+    private:
+        void append(const void* data, size_t size)
+        {
+            const uint8_t* begin = (const uint8_t*)data;
+            bytes.insert(bytes.end(), begin, begin + size);
+        }
+
+        std::vector<uint8_t> bytes;
+    };
+
+    // bounds-checked counterpart of OutStream, throws std::runtime_error on truncated data
+    class InStream
+    {
+    public:
+        InStream(const uint8_t* data, size_t size) : cursor(data), end(data + size) { }
+
+        template<typename T> T read()
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "Type can't be serialized");
+            T value;
+            std::memcpy(&value, take(sizeof(T)), sizeof(T));
+            return value;
+        }
+
+        template<typename T> void read(std::vector<T>& values)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "Type can't be serialized");
+            uint64_t count = read<uint64_t>();
+            if(count > size_t(end - cursor) / sizeof(T))
+                throw std::runtime_error("Scene cache is truncated");
+            values.resize(size_t(count));
+            std::memcpy(values.data(), take(values.size() * sizeof(T)), values.size() * sizeof(T));
+        }
+
+        std::string readString()
+        {
+            uint64_t size = read<uint64_t>();
+            if(size > size_t(end - cursor))
+                throw std::runtime_error("Scene cache is truncated");
+            return std::string((const char*)take(size_t(size)), size_t(size));
+        }
+
+    private:
+        const uint8_t* take(size_t size)
+        {
+            if(size > size_t(end - cursor))
+                throw std::runtime_error("Scene cache is truncated");
+            const uint8_t* data = cursor;
+            cursor += size;
+            return data;
+        }
+
+        const uint8_t* cursor;
+        const uint8_t* end;
+    };
+
+private:
+    // bump whenever the layout of the file, the root blob or any serialized struct changes
+    // or the import produces different data for the same key
+    static constexpr uint32_t VERSION = 5;
+    static constexpr uint32_t MAGIC = 0x43534C43; // CLSC
+    static constexpr uint64_t BLOB_ALIGNMENT = 16;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        Key key;
+        uint32_t numBlobs;
+        uint32_t root;
+        uint32_t dependencies;
+        uint32_t padding;
+        uint64_t blobTable; // file offset, offset and size per blob
+    };
+
+    MappedFile* mapped = nullptr;
+    const uint64_t* blobTable = nullptr;
+    uint32_t numBlobs = 0;
+    uint32_t rootBlob = NO_BLOB;
+};
@@ -0,0 +1,110 @@
+#include "TextureCache.h"
+
+#include <bx/filepath.h>
+#include <cassert>
+
+std::string TextureCache::key(const char* file, TextureCompressor::Role role)
+{
+    return std::to_string(int(role)) + ":" + resolve(file);
+}
+
+std::string TextureCache::resolve(const char* file)
+{
+    // bx normalizes separators and removes . and .. components
+    return bx::FilePath(file).getCPtr();
+}
+
+void TextureCache::add(bgfx::TextureHandle texture, uint64_t bytes, uint16_t layers)
+{
+    assert(bgfx::isValid(texture));
+    Entry& entry = entries[texture.idx];
+    entry.references = 0;
+    entry.bytes = bytes;
+    entry.layers = layers;
+}
+
+void TextureCache::addKey(const std::string& key, bgfx::TextureHandle texture, uint16_t layer)
+{
+    auto entry = entries.find(texture.idx);
+    assert(entry != entries.end() && keys.find(key) == keys.end());
+    if(entry == entries.end())
+        return;
+    entry->second.keys.push_back(key);
+    keys[key] = { texture, layer };
+}
+
+bgfx::TextureHandle TextureCache::find(const std::string& key, uint16_t* layer) const
+{
+    auto found = keys.find(key);
+    if(found == keys.end())
+        return BGFX_INVALID_HANDLE;
+    if(layer)
+        *layer = found->second.layer;
+    return found->second.texture;
+}
+
+void TextureCache::acquire(bgfx::TextureHandle texture)
+{
+    auto entry = entries.find(texture.idx);
+    assert(entry != entries.end());
+    if(entry != entries.end())
+        entry->second.references++;
+}
+
+void TextureCache::release(bgfx::TextureHandle texture)
+{
+    auto entry = entries.find(texture.idx);
+    assert(entry != entries.end() && entry->second.references > 0);
+    if(entry != entries.end() && --entry->second.references == 0)
+        destroy(entry);
+}
+
+void TextureCache::replace(bgfx::TextureHandle from, bgfx::TextureHandle to, uint64_t bytes)
+{
+    auto entry = entries.find(from.idx);
+    assert(entry != entries.end() && entries.find(to.idx) == entries.end());
+    if(entry == entries.end())
+        return;
+    Entry replacement = entry->second;
+    replacement.bytes = bytes;
+    for(const std::string& key : replacement.keys)
+    {
+        keys[key].texture = to;
+    }
+    entries.erase(entry);
+    entries[to.idx] = replacement;
+    bgfx::destroy(from);
+}
+
+void TextureCache::clear()
+{
+    for(const auto& entry : entries)
+    {
+        bgfx::destroy(bgfx::TextureHandle { entry.first });
+    }
+    entries.clear();
+    keys.clear();
+}
+
+TextureCache::Stats TextureCache::stats() const
+{
+    Stats stats;
+    for(const auto& entry : entries)
+    {
+        stats.textures++;
+        stats.references += entry.second.references;
+        stats.bytes += entry.second.bytes;
+        stats.unsharedBytes += entry.second.bytes / entry.second.layers * entry.second.references;
+    }
+    return stats;
+}
+
+void TextureCache::destroy(std::unordered_map<uint16_t, Entry>::iterator entry)
+{
+    for(const std::string& key : entry->second.keys)
+    {
+        keys.erase(key);
+    }
+    bgfx::destroy(bgfx::TextureHandle { entry->first });
+    entries.erase(entry);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Scene/TextureCompressor.h"
+#include <bgfx/bgfx.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// reference counted material textures
+// every material slot holding a texture owns one reference, the texture is destroyed with the last one
+// textures get shared by files used in several slots or materials and by texture arrays
+// textures created from a file are found by its key, the cache is emptied when the scene is cleared
+// scene cache imports only have texture indices and can't be looked up
+class TextureCache
+{
+public:
+    // normalized path and role, different spellings of the same file get the same key
+    // a file used as color and data texture needs different formats so the role is part of the key
+    static std::string key(const char* file, TextureCompressor::Role role);
+    // normalized path
+    static std::string resolve(const char* file);
+
+    // takes ownership of a texture, it starts without references
+    // references to texture arrays use one of its layers
+    void add(bgfx::TextureHandle texture, uint64_t bytes, uint16_t layers = 1);
+    // lets find() return the texture, or one of its layers, for a file's key
+    // the key is removed again when the texture is destroyed
+    void addKey(const std::string& key, bgfx::TextureHandle texture, uint16_t layer = 0);
+    // texture added with addKey(), invalid if there's none
+    // the caller has to acquire a reference if it keeps the texture
+    bgfx::TextureHandle find(const std::string& key, uint16_t* layer = nullptr) const;
+    void acquire(bgfx::TextureHandle texture);
+    // destroys the texture once the last reference is gone
+    void release(bgfx::TextureHandle texture);
+    // moves the references of a texture to its replacement and destroys it
+    // the replacement must not be in the cache yet
+    void replace(bgfx::TextureHandle from, bgfx::TextureHandle to, uint64_t bytes);
+    // destroys all textures, referenced or not
+    void clear();
+
+    struct Stats
+    {
+        uint32_t textures = 0;
+        uint32_t references = 0;
+        uint64_t bytes = 0;         // GPU memory of all textures
+        uint64_t unsharedBytes = 0; // GPU memory if every reference had its own texture (or layer)
+    };
+    Stats stats() const;
+
+private:
+    struct Entry
+    {
+        uint32_t references = 0;
+        uint64_t bytes = 0;
+        uint16_t layers = 1;
+        std::vector<std::string> keys;
+    };
+    struct Layer
+    {
+        bgfx::TextureHandle texture;
+        uint16_t layer;
+    };
+    // texture handle -> entry
+    std::unordered_map<uint16_t, Entry> entries;
+    // key -> texture and layer
+    std::unordered_map<std::string, Layer> keys;
+
+    void destroy(std::unordered_map<uint16_t, Entry>::iterator entry);
+};
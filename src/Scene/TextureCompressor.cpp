@@ -0,0 +1,130 @@
+#include "TextureCompressor.h"
+
+#include "Scene/SceneCache.h"
+#include <bimg/bimg.h>
+#include <bimg/encode.h>
+#include <bx/file.h>
+#include <cstdio>
+#include <stdexcept>
+
+// any pixel in the top level of an RGBA8 image that isn't fully opaque
+static bool hasTransparency(const bimg::ImageContainer& image)
+{
+    for(uint16_t layer = 0; layer < image.m_numLayers; layer++)
+    {
+        bimg::ImageMip mip;
+        bimg::imageGetRawData(image, layer, 0, image.m_data, image.m_size, mip);
+        const uint32_t pixels = mip.m_width * mip.m_height;
+        for(uint32_t i = 0; i < pixels; i++)
+        {
+            if(mip.m_data[i * 4 + 3] != 255)
+                return true;
+        }
+    }
+    return false;
+}
+
+std::string TextureCompressor::cachePath(const char* file, Role role) const
+{
+    // normal maps always use BC5
+    const char* suffix = role == Role::Normal ? ".normal.dds"
+                         : role == Role::Color ? (highQuality ? ".color.bc7.dds" : ".color.dds")
+                                               : (highQuality ? ".data.bc7.dds" : ".data.dds");
+    return std::string(file) + suffix;
+}
+
+bool TextureCompressor::upToDate(const char* cacheFile, const char* file)
+{
+    uint64_t cacheSize, size;
+    int64_t cacheTime, time;
+    return SceneCache::stamp(cacheFile, cacheSize, cacheTime) && SceneCache::stamp(file, size, time) &&
+           cacheSize > 0 && cacheTime >= time;
+}
+
+bimg::ImageContainer* TextureCompressor::compress(bimg::ImageContainer* image, Role role) const
+{
+    if(bimg::isCompressed(image->m_format) || image->m_cubeMap || image->m_depth > 1)
+        return image;
+
+    // the encoders take RGBA8
+    if(image->m_format != bimg::TextureFormat::RGBA8)
+    {
+        bimg::ImageContainer* converted = bimg::imageConvert(allocator, bimg::TextureFormat::RGBA8, *image);
+        bimg::imageFree(image);
+        if(!converted)
+            throw std::runtime_error("Can't convert image to RGBA8");
+        image = converted;
+    }
+
+    bimg::TextureFormat::Enum format;
+    switch(role)
+    {
+        case Role::Color:
+            format = highQuality ? bimg::TextureFormat::BC7
+                                 : (hasTransparency(*image) ? bimg::TextureFormat::BC3 : bimg::TextureFormat::BC1);
+            break;
+        case Role::Normal:
+            format = bimg::TextureFormat::BC5;
+            break;
+        case Role::Data:
+        default:
+            format = highQuality ? bimg::TextureFormat::BC7 : bimg::TextureFormat::BC1;
+            break;
+    }
+    const bimg::Quality::Enum quality =
+        role == Role::Normal ? bimg::Quality::NormalMapDefault : bimg::Quality::Default;
+
+    bimg::ImageContainer* output = bimg::imageAlloc(allocator,
+                                                    format,
+                                                    uint16_t(image->m_width),
+                                                    uint16_t(image->m_height),
+                                                    1,
+                                                    image->m_numLayers,
+                                                    false,
+                                                    image->m_numMips > 1);
+    // every mip is encoded on its own, block compression doesn't care about its neighbours
+    bx::Error err;
+    for(uint16_t layer = 0; layer < image->m_numLayers && err.isOk(); layer++)
+    {
+        for(uint8_t lod = 0; lod < image->m_numMips && err.isOk(); lod++)
+        {
+            bimg::ImageMip src, dst;
+            bimg::imageGetRawData(*image, layer, lod, image->m_data, image->m_size, src);
+            bimg::imageGetRawData(*output, layer, lod, output->m_data, output->m_size, dst);
+            bimg::imageEncodeFromRgba8(
+                allocator, (void*)dst.m_data, src.m_data, src.m_width, src.m_height, 1, format, quality, &err);
+        }
+    }
+    bimg::imageFree(image);
+
+    if(!err.isOk())
+    {
+        bimg::imageFree(output);
+        throw std::runtime_error(err.getMessage().getPtr());
+    }
+    return output;
+}
+
+bool TextureCompressor::write(const char* file, bimg::ImageContainer& image)
+{
+    // other loads never see a partially written file
+    const std::string tempFile = std::string(file) + ".tmp";
+
+    bx::FileWriter writer;
+    bx::Error err;
+    if(!writer.open(tempFile.c_str(), false, &err))
+        return false;
+    bimg::imageWriteDds(&writer, image, image.m_data, image.m_size, &err);
+    writer.close();
+
+    // rename replaces the file atomically on POSIX, Windows doesn't overwrite existing files
+#if BX_PLATFORM_WINDOWS
+    std::remove(file);
+#endif
+    if(!err.isOk() || std::rename(tempFile.c_str(), file) != 0)
+    {
+        std::remove(tempFile.c_str());
+        return false;
+    }
+    return true;
+}
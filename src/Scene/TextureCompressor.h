@@ -0,0 +1,45 @@
+#pragma once
+
+#include <bx/allocator.h>
+#include <string>
+
+namespace bimg
+{
+struct ImageContainer;
+}
+
+// import-time block compression of material textures
+// the format depends on what the texture is used for:
+// color textures get BC1, or BC3 if they have transparent pixels, normal maps BC5 (x and y only)
+// and data textures (metallic/roughness, occlusion) BC1
+// in high quality mode color and data textures use BC7 instead, which is a lot slower to encode
+// results are written as DDS next to the source image and reused as long as they're newer than the source
+// thread-safe
+class TextureCompressor
+{
+public:
+    enum class Role
+    {
+        Color, // sRGB
+        Normal,
+        Data
+    };
+
+    TextureCompressor(bx::AllocatorI* allocator, bool highQuality) : allocator(allocator), highQuality(highQuality) { }
+
+    // compressed copy of a source image, the name depends on the role and quality
+    std::string cachePath(const char* file, Role role) const;
+    // the compressed copy exists and the source image didn't change since it was written
+    static bool upToDate(const char* cacheFile, const char* file);
+
+    // takes ownership of the image and returns the compressed image
+    // cube maps, volumes and already compressed images are returned as they are
+    // throws std::runtime_error if the image can't be converted or encoded
+    bimg::ImageContainer* compress(bimg::ImageContainer* image, Role role) const;
+    // writes a DDS file, false on failure
+    static bool write(const char* file, bimg::ImageContainer& image);
+
+private:
+    bx::AllocatorI* allocator;
+    bool highQuality;
+};
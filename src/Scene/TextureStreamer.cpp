@@ -0,0 +1,286 @@
+#include "TextureStreamer.h"
+
+#include "Util/MappedFile.h"
+#include <bimg/bimg.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+constexpr uint16_t TextureStreamer::START_SIZE;
+constexpr uint64_t TextureStreamer::MAX_UPLOAD_BYTES;
+constexpr uint8_t TextureStreamer::MAX_MIPS;
+
+TextureStreamer::Source* TextureStreamer::Source::fromImage(bimg::ImageContainer* image)
+{
+    Source* source = new Source();
+    source->image = image;
+    source->bytes = (const uint8_t*)image->m_data;
+    source->length = image->m_size;
+    return source;
+}
+
+TextureStreamer::Source* TextureStreamer::Source::fromMapping(MappedFile* mapped, const uint8_t* data, uint32_t size)
+{
+    Source* source = new Source();
+    mapped->acquire();
+    source->mapped = mapped;
+    source->bytes = data;
+    source->length = size;
+    return source;
+}
+
+TextureStreamer::Source::~Source()
+{
+    if(image)
+        bimg::imageFree(image);
+    if(mapped)
+        mapped->release();
+}
+
+void TextureStreamer::Source::acquire()
+{
+    refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void TextureStreamer::Source::release()
+{
+    // bgfx calls the release function on the render thread
+    if(refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete this;
+}
+
+const bgfx::Memory* TextureStreamer::Source::makeRef(uint32_t offset, uint32_t size)
+{
+    assert(offset <= length && size <= length - offset);
+    acquire();
+    return bgfx::makeRef(bytes + offset, size, [](void*, void* userData) { ((Source*)userData)->release(); }, this);
+}
+
+bool TextureStreamer::streamable(const Desc& desc, uint16_t numLayers, uint32_t size)
+{
+    const bimg::TextureFormat::Enum format = (bimg::TextureFormat::Enum)desc.format;
+    uint32_t offsets[MAX_MIPS + 1];
+    return numLayers == 1 && desc.numMips > 1 && std::max(desc.width, desc.height) > START_SIZE &&
+           desc.numMips == bimg::imageGetNumMips(format, desc.width, desc.height) &&
+           levelOffsets(desc, size, offsets) && validStart(desc, offsets, 1);
+}
+
+bgfx::TextureHandle TextureStreamer::add(Source* source, const Desc& desc)
+{
+    Entry entry;
+    entry.source = source;
+    entry.desc = desc;
+    const bool valid = levelOffsets(desc, source->size(), entry.offsets);
+    assert(valid);
+    (void)valid;
+
+    // every level up to the start has to be valid, the texture can go back and forth between them
+    uint8_t startMip = 0;
+    while(startMip + 1 < desc.numMips && std::max(desc.width, desc.height) >> startMip > START_SIZE &&
+          validStart(desc, entry.offsets, startMip + 1))
+    {
+        startMip++;
+    }
+    entry.startMip = startMip;
+    entry.mip = startMip;
+    entry.lastVisible = frame;
+    entry.handle = create(entry, startMip);
+
+    indices[entry.handle.idx] = uint32_t(entries.size());
+    entries.push_back(entry);
+    return entry.handle;
+}
+
+uint64_t TextureStreamer::residentBytes(bgfx::TextureHandle texture) const
+{
+    auto index = indices.find(texture.idx);
+    if(index == indices.end())
+        return 0;
+    const Entry& entry = entries[index->second];
+    return bytes(entry, entry.mip);
+}
+
+void TextureStreamer::clear()
+{
+    for(Entry& entry : entries)
+    {
+        entry.source->release();
+    }
+    entries.clear();
+    indices.clear();
+}
+
+void TextureStreamer::request(bgfx::TextureHandle texture, float pixelsPerUv)
+{
+    auto index = indices.find(texture.idx);
+    if(index != indices.end())
+    {
+        Entry& entry = entries[index->second];
+        entry.pixelsPerUv = std::max(entry.pixelsPerUv, pixelsPerUv);
+    }
+}
+
+void TextureStreamer::update(uint64_t budget, std::vector<Swap>& swaps)
+{
+    frame++;
+
+    // visible textures get the level they need, finer levels are kept until the budget runs out
+    std::vector<uint8_t> wanted(entries.size());
+    std::vector<uint8_t> targets(entries.size());
+    uint64_t total = 0;
+    for(size_t i = 0; i < entries.size(); i++)
+    {
+        Entry& entry = entries[i];
+        if(entry.pixelsPerUv > 0.0f)
+            entry.lastVisible = frame;
+        wanted[i] = wantedMip(entry);
+        targets[i] = std::min(entry.mip, wanted[i]);
+        total += bytes(entry, targets[i]);
+    }
+
+    // least recently visible first, then the ones covering the fewest pixels
+    std::vector<uint32_t> order(entries.size());
+    for(uint32_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        if(entries[a].lastVisible != entries[b].lastVisible)
+            return entries[a].lastVisible < entries[b].lastVisible;
+        return entries[a].pixelsPerUv < entries[b].pixelsPerUv;
+    });
+
+    // over budget: drop levels nobody needs anymore
+    for(size_t i = 0; i < order.size() && total > budget; i++)
+    {
+        const uint32_t index = order[i];
+        if(targets[index] < wanted[index])
+        {
+            total -= bytes(entries[index], targets[index]) - bytes(entries[index], wanted[index]);
+            targets[index] = wanted[index];
+        }
+    }
+    // still over budget: coarsen everything one level at a time
+    bool coarsened = true;
+    while(total > budget && coarsened)
+    {
+        coarsened = false;
+        for(size_t i = 0; i < order.size() && total > budget; i++)
+        {
+            const uint32_t index = order[i];
+            if(targets[index] < entries[index].startMip)
+            {
+                total -= bytes(entries[index], targets[index]) - bytes(entries[index], targets[index] + 1);
+                targets[index]++;
+                coarsened = true;
+            }
+        }
+    }
+
+    // largest jumps in resolution first, the rest waits for the next updates
+    std::vector<uint32_t> changed;
+    for(uint32_t i = 0; i < entries.size(); i++)
+    {
+        if(targets[i] != entries[i].mip)
+            changed.push_back(i);
+    }
+    std::sort(changed.begin(), changed.end(), [this, &targets](uint32_t a, uint32_t b) {
+        return int(entries[a].mip) - int(targets[a]) > int(entries[b].mip) - int(targets[b]);
+    });
+
+    uint64_t uploaded = 0;
+    for(uint32_t index : changed)
+    {
+        Entry& entry = entries[index];
+        const uint8_t mip = targets[index];
+        const uint64_t size = bytes(entry, mip);
+        // at least one texture per update gets finer, no matter its size
+        if(mip < entry.mip && uploaded > 0 && uploaded + size > MAX_UPLOAD_BYTES)
+            continue;
+        if(mip < entry.mip)
+            uploaded += size;
+
+        const bgfx::TextureHandle from = entry.handle;
+        entry.handle = create(entry, mip);
+        entry.mip = mip;
+        indices.erase(from.idx);
+        indices[entry.handle.idx] = index;
+        swaps.push_back({ from, entry.handle, size });
+    }
+
+    for(Entry& entry : entries)
+    {
+        entry.pixelsPerUv = 0.0f;
+    }
+}
+
+TextureStreamer::Stats TextureStreamer::stats() const
+{
+    Stats stats;
+    for(const Entry& entry : entries)
+    {
+        stats.textures++;
+        stats.residentBytes += bytes(entry, entry.mip);
+        stats.fullBytes += bytes(entry, 0);
+    }
+    return stats;
+}
+
+uint8_t TextureStreamer::wantedMip(const Entry& entry)
+{
+    if(entry.pixelsPerUv <= 0.0f)
+        return entry.startMip;
+
+    // one texel per pixel, the top level of mip n has size >> n texels per UV unit
+    const float size = float(std::max(entry.desc.width, entry.desc.height));
+    if(entry.pixelsPerUv >= size)
+        return 0;
+    const float mip = std::floor(std::log2(size / entry.pixelsPerUv));
+    return uint8_t(std::min(mip, float(entry.startMip)));
+}
+
+bool TextureStreamer::levelOffsets(const Desc& desc, uint32_t size, uint32_t* offsets)
+{
+    if(desc.numMips == 0 || desc.numMips > MAX_MIPS)
+        return false;
+
+    const bimg::TextureFormat::Enum format = (bimg::TextureFormat::Enum)desc.format;
+    uint64_t offset = 0;
+    for(uint8_t mip = 0; mip < desc.numMips; mip++)
+    {
+        offsets[mip] = uint32_t(std::min(offset, uint64_t(UINT32_MAX)));
+        const uint16_t width = uint16_t(std::max(desc.width >> mip, 1));
+        const uint16_t height = uint16_t(std::max(desc.height >> mip, 1));
+        offset += bimg::imageGetSize(nullptr, width, height, 1, false, false, 1, format);
+    }
+    offsets[desc.numMips] = uint32_t(std::min(offset, uint64_t(UINT32_MAX)));
+    return offset == size;
+}
+
+bool TextureStreamer::validStart(const Desc& desc, const uint32_t* offsets, uint8_t mip)
+{
+    // block compressed levels are padded to whole blocks, bgfx's chain from a small level can differ from
+    // the levels of the full chain
+    const bimg::TextureFormat::Enum format = (bimg::TextureFormat::Enum)desc.format;
+    const uint16_t width = uint16_t(std::max(desc.width >> mip, 1));
+    const uint16_t height = uint16_t(std::max(desc.height >> mip, 1));
+    const bool hasMips = mip + 1 < desc.numMips;
+    return mip < desc.numMips && bimg::imageGetNumMips(format, width, height) == desc.numMips - mip &&
+           bimg::imageGetSize(nullptr, width, height, 1, false, hasMips, 1, format) ==
+               offsets[desc.numMips] - offsets[mip];
+}
+
+bgfx::TextureHandle TextureStreamer::create(Entry& entry, uint8_t mip)
+{
+    const Desc& desc = entry.desc;
+    const uint16_t width = uint16_t(std::max(desc.width >> mip, 1));
+    const uint16_t height = uint16_t(std::max(desc.height >> mip, 1));
+    const uint32_t offset = entry.offsets[mip];
+    return bgfx::createTexture2D(width,
+                                 height,
+                                 mip + 1 < desc.numMips,
+                                 1,
+                                 desc.format,
+                                 desc.flags,
+                                 entry.source->makeRef(offset, entry.offsets[desc.numMips] - offset));
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <bgfx/bgfx.h>
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class MappedFile;
+
+namespace bimg
+{
+struct ImageContainer;
+}
+
+// keeps material textures at the mip level their size on screen needs
+// textures start at a small mip, update recreates them with more or fewer levels as the demand changes
+// the full mip chain stays in CPU memory (decoded image or file mapping), bgfx uploads the recreated
+// textures on its render thread so the frame never waits for the data
+// the streamer doesn't own the textures, TextureCache destroys them
+class TextureStreamer
+{
+public:
+    // CPU copy of a texture's whole mip chain in the layout createTexture2D expects
+    // reference counted so uploads still in flight keep it alive after the streamer let go of it
+    class Source
+    {
+    public:
+        // takes ownership of the image
+        static Source* fromImage(bimg::ImageContainer* image);
+        // acquires a reference to the mapping, data points into it
+        static Source* fromMapping(MappedFile* mapped, const uint8_t* data, uint32_t size);
+
+        void acquire();
+        // frees the image or releases the mapping once the last reference is gone
+        void release();
+
+        const uint8_t* data() const
+        {
+            return bytes;
+        }
+
+        uint32_t size() const
+        {
+            return length;
+        }
+
+        // bgfx memory pointing into the source without a copy
+        // holds a reference until bgfx is done with the memory
+        const bgfx::Memory* makeRef(uint32_t offset, uint32_t size);
+
+    private:
+        Source() = default;
+        ~Source();
+
+        std::atomic<uint32_t> refs = { 1 };
+        bimg::ImageContainer* image = nullptr;
+        MappedFile* mapped = nullptr;
+        const uint8_t* bytes = nullptr;
+        uint32_t length = 0;
+    };
+
+    struct Desc
+    {
+        uint16_t width = 0;
+        uint16_t height = 0;
+        uint8_t numMips = 1;
+        bgfx::TextureFormat::Enum format = bgfx::TextureFormat::Unknown;
+        uint64_t flags = 0;
+    };
+
+    // single layer with a full mip chain that can be uploaded starting at a smaller level
+    // size is the size of the mip chain
+    static bool streamable(const Desc& desc, uint16_t numLayers, uint32_t size);
+
+    // takes ownership of the source and creates the texture at a level no bigger than START_SIZE
+    bgfx::TextureHandle add(Source* source, const Desc& desc);
+    // GPU memory of the resident levels, 0 for unknown textures
+    uint64_t residentBytes(bgfx::TextureHandle texture) const;
+    // releases all sources, the textures stay
+    void clear();
+
+    // screen pixels one unit of texture coordinates covers this frame
+    // the largest request since the last update counts, 0 means the texture isn't visible
+    void request(bgfx::TextureHandle texture, float pixelsPerUv);
+
+    // texture recreated with a different number of levels
+    // from is no longer used by the streamer, users have to switch to the new texture and destroy the old one
+    struct Swap
+    {
+        bgfx::TextureHandle from;
+        bgfx::TextureHandle to;
+        uint64_t bytes; // GPU memory of the new texture
+    };
+    // pick the levels for this frame's requests and recreate textures whose level changed
+    // budget is the GPU memory all streamed textures can use, textures beyond it are dropped to coarser levels,
+    // the ones needed least recently first
+    void update(uint64_t budget, std::vector<Swap>& swaps);
+
+    struct Stats
+    {
+        uint32_t textures = 0;
+        uint64_t residentBytes = 0;
+        uint64_t fullBytes = 0; // GPU memory with every texture at full resolution
+    };
+    Stats stats() const;
+
+    // largest initial level
+    static constexpr uint16_t START_SIZE = 64;
+    // bytes of finer levels uploaded per update, keeps the upload cost of a frame bounded
+    // dropping levels is not limited
+    static constexpr uint64_t MAX_UPLOAD_BYTES = 16 * 1024 * 1024;
+
+private:
+    static constexpr uint8_t MAX_MIPS = 16;
+
+    struct Entry
+    {
+        bgfx::TextureHandle handle = BGFX_INVALID_HANDLE;
+        Source* source = nullptr;
+        Desc desc;
+        // start of each level in the source, offsets[numMips] is the size of the whole chain
+        uint32_t offsets[MAX_MIPS + 1] = {};
+        // finest resident level
+        uint8_t mip = 0;
+        // coarsest level, the texture never drops below it
+        uint8_t startMip = 0;
+        float pixelsPerUv = 0.0f;
+        // last update the texture was visible
+        uint32_t lastVisible = 0;
+    };
+    std::vector<Entry> entries;
+    // texture handle -> index into entries
+    std::unordered_map<uint16_t, uint32_t> indices;
+    uint32_t frame = 0;
+
+    static uint64_t bytes(const Entry& entry, uint8_t mip)
+    {
+        return entry.offsets[entry.desc.numMips] - entry.offsets[mip];
+    }
+    // level whose texel density matches the request
+    static uint8_t wantedMip(const Entry& entry);
+    // offsets of all levels, false if the layout doesn't match a full chain
+    static bool levelOffsets(const Desc& desc, uint32_t size, uint32_t* offsets);
+    // bgfx computes the same layout for a texture starting at this level
+    static bool validStart(const Desc& desc, const uint32_t* offsets, uint8_t mip);
+    static bgfx::TextureHandle create(Entry& entry, uint8_t mip);
+};
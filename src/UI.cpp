@@ -91,6 +91,8 @@ void ClusterUI::initialize()
                                         0,
                                         bgfx::copy(tex_data, tex_w * tex_h * bytes));
     io.Fonts->SetTexID((ImTextureID)(uintptr_t)fontTexture.idx);
+
+    bx::strCopy(sceneFile, BX_COUNTOF(sceneFile), app.config->sceneFile);
 }
 
 void ClusterUI::update(float dt)
@@ -108,6 +110,18 @@ void ClusterUI::update(float dt)
     {
         ImGui::Begin("Settings", &app.config->showConfigWindow, ImGuiWindowFlags_AlwaysAutoResize);
 
+        ImGui::InputText("##Scene", sceneFile, BX_COUNTOF(sceneFile));
+        ImGui::SameLine();
+        if(ImGui::Button(ICON_FK_FOLDER_OPEN "  Load scene"))
+        {
+            // no Sponza debug lights and camera
+            app.config->customScene = true;
+            if(!app.loadScene(sceneFile))
+                Log->error("Loading scene model failed");
+        }
+
+        ImGui::Separator();
+
         if(ImGui::SliderInt("No. of lights", &app.config->lights, 0, app.config->maxLights))
             app.generateLights(app.config->lights);
         ImGui::Checkbox("Moving lights", &app.config->movingLights);
@@ -131,6 +145,26 @@ void ClusterUI::update(float dt)
 
         ImGui::Separator();
 
+        const char* occlusionModes[] = { "None", "Occlusion queries", "Hi-Z (depth pyramid)", "Software rasterizer" };
+        int occlusionCulling = (int)app.config->occlusionCulling;
+        ImGui::Combo("Occlusion culling", &occlusionCulling, occlusionModes, IM_ARRAYSIZE(occlusionModes));
+        app.config->occlusionCulling = (Renderer::OcclusionCullingMode)occlusionCulling;
+        app.renderer->setOcclusionCullingMode(app.config->occlusionCulling);
+
+        ImGui::Checkbox("GPU culling", &app.config->gpuCulling);
+        app.renderer->setGpuCulling(app.config->gpuCulling);
+
+        ImGui::Checkbox("Mesh LOD", &app.config->lod);
+        app.renderer->setLod(app.config->lod);
+
+        ImGui::Checkbox("Multithreaded submission", &app.config->multithreadedSubmission);
+        app.renderer->setMultithreadedSubmission(app.config->multithreadedSubmission);
+
+        if(app.scene->texturesStreamed)
+            ImGui::SliderInt("Texture budget (MB)", &app.config->textureBudget, 16, 4096);
+
+        ImGui::Separator();
+
         ImGui::Checkbox("Multiple scattering", &app.config->multipleScattering);
         app.renderer->setMultipleScattering(app.config->multipleScattering);
 
@@ -205,6 +239,27 @@ void ClusterUI::update(float dt)
         ImGui::End();
     }
 
+    // loading progress, bottom center
+    if(app.scene->loading())
+    {
+        float progress = 0.0f;
+        const char* step = app.scene->loadProgress(progress);
+        char overlay[64];
+        bx::snprintf(overlay, BX_COUNTOF(overlay), "%s (%.0f%%)", step, progress * 100.0f);
+
+        const ImVec2 displaySize = ImGui::GetIO().DisplaySize;
+        ImGui::SetNextWindowPos(
+            ImVec2(displaySize.x / 2.0f, displaySize.y - padding.y), ImGuiCond_Always, ImVec2(0.5f, 1.0f));
+        ImGui::SetNextWindowBgAlpha(0.5f);
+        ImGui::Begin("Loading",
+                     nullptr,
+                     ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize |
+                         ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav);
+        ImGui::Text(ICON_FK_SPINNER " Loading scene");
+        ImGui::ProgressBar(progress, ImVec2(250.0f, 0.0f), overlay);
+        ImGui::End();
+    }
+
     // performance overlay
     if(app.config->showStatsOverlay)
     {
@@ -231,9 +286,40 @@ void ClusterUI::update(float dt)
 
         ImGui::Text("Backend: %s", bgfx::getRendererName(bgfx::getRendererType()));
         ImGui::Text("Buffer size: %u x %u px", stats->width, stats->height);
+        const Renderer::CullingStats& culling = app.renderer->cullingStats;
         ImGui::Text("Triangles: %u", stats->numPrims[bgfx::Topology::TriList]);
+        // GPU culling selects the LOD in the compute shader
+        if(app.config->lod && !culling.gpu)
+            ImGui::Text("Triangles saved by LOD: %u", culling.lodTrianglesSaved);
         ImGui::Text("Draw calls: %u", stats->numDraw);
         ImGui::Text("Compute calls: %u", stats->numCompute);
+        const Renderer::SubmitStats& submit = app.renderer->submitStats;
+        ImGui::Text("Scene submission: %.2f ms (%u draws)", submit.time, submit.draws);
+        for(size_t i = 0; i < submit.workers.size(); i++)
+        {
+            const Renderer::SubmitStats::Worker& worker = submit.workers[i];
+            if(worker.draws > 0)
+                ImGui::Text("  Thread %u: %.2f ms (%u draws)", uint32_t(i), worker.time, worker.draws);
+        }
+
+        // culling
+        ImGui::Text("Chunks: %u", culling.total);
+        if(culling.gpu)
+        {
+            ImGui::Text("Culled on the GPU");
+        }
+        else
+        {
+            ImGui::Text("Frustum culled: %u", culling.frustumCulled);
+            ImGui::Text("Backface culled: %u", culling.backfaceCulled);
+            ImGui::Text("Occlusion culled: %u", culling.occlusionCulled);
+        }
+        if(!culling.gpu && app.config->occlusionCulling == Renderer::OcclusionCullingMode::SOFTWARE)
+        {
+            ImGui::Text("Occluders: %u (%u triangles)", culling.occluders, culling.occluderTriangles);
+            ImGui::Text("Occludees: %u", culling.occludees);
+            ImGui::Text("Occlusion time: %.2f ms", culling.occlusionTime);
+        }
 
         // plots
         static float fpsValues[GRAPH_HISTORY] = { 0 };
@@ -356,6 +442,20 @@ void ClusterUI::update(float dt)
             {
                 ImGui::TextWrapped(ICON_FK_EXCLAMATION_TRIANGLE " GPU memory data unavailable");
             }
+
+            // streamed material textures against their budget
+            if(app.scene->texturesStreamed)
+            {
+                const TextureStreamer::Stats streaming = app.scene->streamingStats();
+                char strResident[64];
+                bx::prettify(strResident, BX_COUNTOF(strResident), streaming.residentBytes);
+                char strBudget[64];
+                bx::prettify(strBudget, BX_COUNTOF(strBudget), uint64_t(app.config->textureBudget) * 1024 * 1024);
+                char strFull[64];
+                bx::prettify(strFull, BX_COUNTOF(strFull), streaming.fullBytes);
+                ImGui::Text("Textures: %s / %s", strResident, strBudget);
+                ImGui::Text("  full resolution: %s", strFull);
+            }
         }
 
         // update after drawing so offset is the current value
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <bgfx/bgfx.h>
+#include <bx/filepath.h>
 #include <imgui.h>
 #include <spdlog/spdlog.h>
 
@@ -39,5 +40,8 @@ private:
     Cluster& app;
     float mTime = 0.0f;
 
+    // scene file text field
+    char sceneFile[bx::kMaxFilePath] = "";
+
     bgfx::TextureHandle fontTexture = BGFX_INVALID_HANDLE;
 };
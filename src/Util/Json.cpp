@@ -0,0 +1,315 @@
+#include "Json.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+// recursive descent over the whole text
+class Json::Parser
+{
+public:
+    Parser(const char* text, size_t size) : cursor(text), end(text + size) { }
+
+    Json document()
+    {
+        Json root = parseValue(0);
+        skipWhitespace();
+        if(cursor != end)
+            fail("Unexpected data after the document");
+        return root;
+    }
+
+private:
+    // deeper documents are rejected instead of overflowing the stack
+    static constexpr uint32_t MAX_DEPTH = 256;
+
+    const char* cursor;
+    const char* end;
+
+    [[noreturn]] void fail(const char* error) const
+    {
+        throw std::runtime_error(std::string("JSON: ") + error);
+    }
+
+    void skipWhitespace()
+    {
+        while(cursor != end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r'))
+            cursor++;
+    }
+
+    void expect(char c)
+    {
+        skipWhitespace();
+        if(cursor == end || *cursor != c)
+            fail("Unexpected character");
+        cursor++;
+    }
+
+    // skips a comma between elements, false at the end of the array or object
+    bool separator()
+    {
+        skipWhitespace();
+        if(cursor == end || *cursor != ',')
+            return false;
+        cursor++;
+        return true;
+    }
+
+    bool consume(const char* literal)
+    {
+        const size_t length = std::strlen(literal);
+        if(size_t(end - cursor) < length || std::memcmp(cursor, literal, length) != 0)
+            return false;
+        cursor += length;
+        return true;
+    }
+
+    Json parseValue(uint32_t depth)
+    {
+        if(depth > MAX_DEPTH)
+            fail("Document is nested too deeply");
+
+        skipWhitespace();
+        if(cursor == end)
+            fail("Unexpected end of document");
+
+        Json json;
+        switch(*cursor)
+        {
+            case '{':
+                json.kind = Type::Object;
+                cursor++;
+                skipWhitespace();
+                if(cursor != end && *cursor == '}')
+                {
+                    cursor++;
+                    break;
+                }
+                while(true)
+                {
+                    json.keys.push_back(parseString());
+                    expect(':');
+                    json.elements.push_back(parseValue(depth + 1));
+                    if(!separator())
+                        break;
+                }
+                expect('}');
+                break;
+            case '[':
+                json.kind = Type::Array;
+                cursor++;
+                skipWhitespace();
+                if(cursor != end && *cursor == ']')
+                {
+                    cursor++;
+                    break;
+                }
+                while(true)
+                {
+                    json.elements.push_back(parseValue(depth + 1));
+                    if(!separator())
+                        break;
+                }
+                expect(']');
+                break;
+            case '"':
+                json.kind = Type::String;
+                json.text = parseString();
+                break;
+            case 't':
+            case 'f':
+                json.kind = Type::Bool;
+                json.flag = *cursor == 't';
+                if(!consume(json.flag ? "true" : "false"))
+                    fail("Invalid literal");
+                break;
+            case 'n':
+                if(!consume("null"))
+                    fail("Invalid literal");
+                break;
+            default:
+                json.kind = Type::Number;
+                json.value = parseNumber();
+                break;
+        }
+        return json;
+    }
+
+    double parseNumber()
+    {
+        // strtod needs a terminated string, numbers are short
+        char buffer[64];
+        size_t length = 0;
+        while(cursor != end && length < sizeof(buffer) - 1 &&
+              ((*cursor != '\0' && std::strchr("+-.eE", *cursor)) || (*cursor >= '0' && *cursor <= '9')))
+        {
+            buffer[length++] = *cursor++;
+        }
+        buffer[length] = '\0';
+        char* parsed = nullptr;
+        const double number = std::strtod(buffer, &parsed);
+        if(length == 0 || parsed != buffer + length)
+            fail("Invalid number");
+        return number;
+    }
+
+    uint32_t parseHex()
+    {
+        if(end - cursor < 4)
+            fail("Invalid escape sequence");
+        uint32_t code = 0;
+        for(int i = 0; i < 4; i++)
+        {
+            const char c = *cursor++;
+            code <<= 4;
+            if(c >= '0' && c <= '9')
+                code |= c - '0';
+            else if(c >= 'a' && c <= 'f')
+                code |= c - 'a' + 10;
+            else if(c >= 'A' && c <= 'F')
+                code |= c - 'A' + 10;
+            else
+                fail("Invalid escape sequence");
+        }
+        return code;
+    }
+
+    static void appendUtf8(std::string& out, uint32_t code)
+    {
+        if(code < 0x80)
+            out += char(code);
+        else if(code < 0x800)
+        {
+            out += char(0xC0 | (code >> 6));
+            out += char(0x80 | (code & 0x3F));
+        }
+        else if(code < 0x10000)
+        {
+            out += char(0xE0 | (code >> 12));
+            out += char(0x80 | ((code >> 6) & 0x3F));
+            out += char(0x80 | (code & 0x3F));
+        }
+        else
+        {
+            out += char(0xF0 | (code >> 18));
+            out += char(0x80 | ((code >> 12) & 0x3F));
+            out += char(0x80 | ((code >> 6) & 0x3F));
+            out += char(0x80 | (code & 0x3F));
+        }
+    }
+
+    std::string parseString()
+    {
+        expect('"');
+        std::string out;
+        while(true)
+        {
+            if(cursor == end)
+                fail("Unterminated string");
+            const char c = *cursor++;
+            if(c == '"')
+                break;
+            if(c != '\\')
+            {
+                out += c;
+                continue;
+            }
+
+            if(cursor == end)
+                fail("Unterminated string");
+            const char escaped = *cursor++;
+            switch(escaped)
+            {
+                case '"':
+                case '\\':
+                case '/':
+                    out += escaped;
+                    break;
+                case 'b':
+                    out += '\b';
+                    break;
+                case 'f':
+                    out += '\f';
+                    break;
+                case 'n':
+                    out += '\n';
+                    break;
+                case 'r':
+                    out += '\r';
+                    break;
+                case 't':
+                    out += '\t';
+                    break;
+                case 'u':
+                {
+                    uint32_t code = parseHex();
+                    // surrogate pair
+                    if(code >= 0xD800 && code <= 0xDBFF && consume("\\u"))
+                    {
+                        const uint32_t low = parseHex();
+                        if(low < 0xDC00 || low > 0xDFFF)
+                            fail("Invalid surrogate pair");
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    appendUtf8(out, code);
+                    break;
+                }
+                default:
+                    fail("Invalid escape sequence");
+            }
+        }
+        return out;
+    }
+};
+
+constexpr uint32_t Json::Parser::MAX_DEPTH;
+
+// returned for missing members and elements
+static const Json NULL_JSON;
+static const std::string EMPTY_STRING;
+
+Json Json::parse(const char* text, size_t size)
+{
+    return Parser(text, size).document();
+}
+
+const Json& Json::operator[](size_t index) const
+{
+    return kind == Type::Array && index < elements.size() ? elements[index] : NULL_JSON;
+}
+
+const Json& Json::operator[](const char* key) const
+{
+    // glTF objects have few members, a linear search is fine
+    for(size_t i = 0; i < keys.size(); i++)
+    {
+        if(keys[i] == key)
+            return elements[i];
+    }
+    return NULL_JSON;
+}
+
+bool Json::has(const char* key) const
+{
+    return !(*this)[key].isNull();
+}
+
+const std::string& Json::key(size_t index) const
+{
+    return index < keys.size() ? keys[index] : EMPTY_STRING;
+}
+
+double Json::number(double def) const
+{
+    return kind == Type::Number ? value : def;
+}
+
+bool Json::boolean(bool def) const
+{
+    return kind == Type::Bool ? flag : def;
+}
+
+const std::string& Json::string() const
+{
+    return kind == Type::String ? text : EMPTY_STRING;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// read-only JSON document, just enough for glTF files
+// lookups of missing members or elements return a null value so they can be chained
+class Json
+{
+public:
+    enum class Type : uint8_t
+    {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object
+    };
+
+    // throws std::runtime_error for malformed documents
+    static Json parse(const char* text, size_t size);
+
+    Type type() const
+    {
+        return kind;
+    }
+
+    bool isNull() const
+    {
+        return kind == Type::Null;
+    }
+
+    bool isNumber() const
+    {
+        return kind == Type::Number;
+    }
+
+    bool isString() const
+    {
+        return kind == Type::String;
+    }
+
+    bool isArray() const
+    {
+        return kind == Type::Array;
+    }
+
+    bool isObject() const
+    {
+        return kind == Type::Object;
+    }
+
+    // elements of an array or members of an object, 0 for everything else
+    size_t size() const
+    {
+        return elements.size();
+    }
+
+    const Json& operator[](size_t index) const;
+    // literal indices would be ambiguous with the key overload
+    const Json& operator[](int index) const
+    {
+        return (*this)[size_t(index)];
+    }
+    const Json& operator[](const char* key) const;
+    bool has(const char* key) const;
+    // name of an object member, same order as the values
+    const std::string& key(size_t index) const;
+
+    // value, or the default for other types
+    double number(double def = 0.0) const;
+    bool boolean(bool def = false) const;
+    // empty for other types
+    const std::string& string() const;
+
+private:
+    class Parser;
+
+    Type kind = Type::Null;
+    bool flag = false;
+    double value = 0.0;
+    std::string text;
+    // array elements or object values
+    std::vector<Json> elements;
+    // object member names
+    std::vector<std::string> keys;
+};
@@ -0,0 +1,105 @@
+#include "MappedFile.h"
+
+#if BX_PLATFORM_WINDOWS
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile* MappedFile::open(const char* file)
+{
+#if BX_PLATFORM_WINDOWS
+    HANDLE handle = CreateFileA(file,
+                                GENERIC_READ,
+                                FILE_SHARE_READ,
+                                nullptr,
+                                OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                                nullptr);
+    if(handle == INVALID_HANDLE_VALUE)
+        return nullptr;
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(handle, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(handle);
+        return nullptr;
+    }
+
+    HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* mapped = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if(!mapped)
+    {
+        if(mapping)
+            CloseHandle(mapping);
+        CloseHandle(handle);
+        return nullptr;
+    }
+
+    MappedFile* out = new MappedFile();
+    out->file = handle;
+    out->mapping = mapping;
+    out->mapped = (const uint8_t*)mapped;
+    out->length = size_t(size.QuadPart);
+    return out;
+#else
+    int fd = ::open(file, O_RDONLY);
+    if(fd < 0)
+        return nullptr;
+
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        ::close(fd);
+        return nullptr;
+    }
+
+    // the mapping stays valid after closing the file descriptor
+    void* mapped = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(mapped == MAP_FAILED)
+        return nullptr;
+    // most of the file gets read front to back right away
+    madvise(mapped, size_t(info.st_size), MADV_WILLNEED);
+
+    MappedFile* out = new MappedFile();
+    out->mapped = (const uint8_t*)mapped;
+    out->length = size_t(info.st_size);
+    return out;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#if BX_PLATFORM_WINDOWS
+    UnmapViewOfFile(mapped);
+    CloseHandle(mapping);
+    CloseHandle(file);
+#else
+    munmap((void*)mapped, length);
+#endif
+}
+
+void MappedFile::acquire()
+{
+    refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MappedFile::release()
+{
+    // bgfx calls the release function on the render thread
+    if(refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete this;
+}
+
+const bgfx::Memory* MappedFile::makeRef(const void* data, uint32_t size)
+{
+    acquire();
+    return bgfx::makeRef(data, size, [](void*, void* userData) { ((MappedFile*)userData)->release(); }, this);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <bgfx/bgfx.h>
+#include <bx/bx.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// read-only memory mapping of a whole file
+// reference counted so bgfx::makeRef memory pointing into the file can outlive its owner
+class MappedFile
+{
+public:
+    // nullptr if the file can't be opened or is empty
+    // the returned mapping has one reference
+    static MappedFile* open(const char* file);
+
+    void acquire();
+    // unmaps and deletes the mapping once the last reference is gone
+    void release();
+
+    const uint8_t* data() const
+    {
+        return mapped;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+    // bgfx memory pointing into the mapping without a copy
+    // holds a reference until bgfx is done with the memory
+    const bgfx::Memory* makeRef(const void* data, uint32_t size);
+
+private:
+    MappedFile() = default;
+    ~MappedFile();
+
+    std::atomic<uint32_t> refs = { 1 };
+    const uint8_t* mapped = nullptr;
+    size_t length = 0;
+#if BX_PLATFORM_WINDOWS
+    void* file = nullptr;
+    void* mapping = nullptr;
+#endif
+};
@@ -0,0 +1,98 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int workers)
+{
+    if(workers == 0)
+        workers = std::max(std::thread::hardware_concurrency(), 1u);
+
+    // the calling thread is worker 0
+    for(uint32_t i = 1; i < workers; i++)
+    {
+        threads.emplace_back(&ThreadPool::work, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for(std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::parallelFor(uint32_t tasks, const TaskFunction& func)
+{
+    if(tasks == 0)
+        return;
+
+    Job job;
+    job.func = &func;
+    job.count = tasks;
+
+    // not worth waking anyone up
+    if(tasks == 1 || threads.empty())
+    {
+        runTasks(job, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(&job);
+    }
+    wake.notify_all();
+
+    uint32_t executed = runTasks(job, 0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    job.finished += executed;
+    // all tasks are taken, don't hand this job to anyone else
+    std::deque<Job*>::iterator it = std::find(jobs.begin(), jobs.end(), &job);
+    if(it != jobs.end())
+        jobs.erase(it);
+    // job lives on this stack, wait for workers still holding a pointer to it
+    done.wait(lock, [&job]() { return job.finished == job.count && job.activeWorkers == 0; });
+}
+
+void ThreadPool::work(uint32_t worker)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true)
+    {
+        wake.wait(lock, [this]() { return quit || !jobs.empty(); });
+        if(quit)
+            return;
+
+        Job* job = jobs.front();
+        job->activeWorkers++;
+        lock.unlock();
+
+        uint32_t executed = runTasks(*job, worker);
+
+        lock.lock();
+        job->finished += executed;
+        job->activeWorkers--;
+        if(!jobs.empty() && jobs.front() == job)
+            jobs.pop_front();
+        if(job->finished == job->count && job->activeWorkers == 0)
+            done.notify_all();
+    }
+}
+
+uint32_t ThreadPool::runTasks(Job& job, uint32_t worker)
+{
+    uint32_t executed = 0;
+    for(uint32_t task = job.next++; task < job.count; task = job.next++)
+    {
+        (*job.func)(task, worker);
+        executed++;
+    }
+    return executed;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads for data-parallel work
+// several threads can run jobs at the same time, workers pick tasks from the oldest job first
+class ThreadPool
+{
+public:
+    // task index, worker index
+    // worker 0 is the calling thread, workers are unique within a job
+    using TaskFunction = std::function<void(uint32_t task, uint32_t worker)>;
+
+    // 0 = one worker per hardware thread, including the calling thread
+    explicit ThreadPool(unsigned int workers = 0);
+    ~ThreadPool();
+
+    // number of workers including the calling thread
+    uint32_t size() const
+    {
+        return uint32_t(threads.size()) + 1;
+    }
+
+    // run func for every task in [0, tasks) and block until all are done
+    // the calling thread works on the job too
+    // func must not call parallelFor on the same pool
+    void parallelFor(uint32_t tasks, const TaskFunction& func);
+
+private:
+    struct Job
+    {
+        const TaskFunction* func = nullptr;
+        uint32_t count = 0;
+        std::atomic<uint32_t> next = { 0 };
+        // protected by mutex
+        uint32_t finished = 0;
+        uint32_t activeWorkers = 0;
+    };
+
+    void work(uint32_t worker);
+    // returns number of executed tasks
+    static uint32_t runTasks(Job& job, uint32_t worker);
+
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::deque<Job*> jobs;
+    bool quit = false;
+};